@@ -47,4 +47,42 @@
  */
 #define ARCH_CALLREGISTERS       6
 
+/*
+ * Constants: Instruction set extensions
+ *
+ *  Extensions to the baseline x86-64 instruction set which code
+ *  generation makes use of when the target has them.
+ *
+ *  ARCH_FEATURE_SSE42      - SSE3 up to SSE4.2
+ *  ARCH_FEATURE_POPCNT     - Population count
+ *  ARCH_FEATURE_AVX        - AVX and AVX2, VEX encoded three operand forms
+ *  ARCH_FEATURE_FMA        - Fused multiply-add
+ *  ARCH_FEATURE_LZCNT      - Leading zero count
+ *  ARCH_FEATURE_BMI1       - Bit manipulation, andn and tzcnt
+ *  ARCH_FEATURE_BMI2       - Bit manipulation, shifts in any register
+ */
+#define ARCH_FEATURE_SSE42       (1 << 0)
+#define ARCH_FEATURE_POPCNT      (1 << 1)
+#define ARCH_FEATURE_AVX         (1 << 2)
+#define ARCH_FEATURE_FMA         (1 << 3)
+#define ARCH_FEATURE_LZCNT       (1 << 4)
+#define ARCH_FEATURE_BMI1        (1 << 5)
+#define ARCH_FEATURE_BMI2        (1 << 6)
+
+/*
+ * Constants: Microarchitecture levels
+ *
+ *  The extensions every processor of an x86-64 microarchitecture level
+ *  has, each level has all of the one before.
+ *
+ *  ARCH_LEVEL_V1           - The baseline, SSE2
+ *  ARCH_LEVEL_V2           - Adds SSE4.2 and POPCNT
+ *  ARCH_LEVEL_V3           - Adds AVX2, FMA, LZCNT, BMI1 and BMI2
+ */
+#define ARCH_LEVEL_V1            0
+#define ARCH_LEVEL_V2            (ARCH_LEVEL_V1 | ARCH_FEATURE_SSE42 | ARCH_FEATURE_POPCNT)
+#define ARCH_LEVEL_V3            (ARCH_LEVEL_V2 | ARCH_FEATURE_AVX   | ARCH_FEATURE_FMA  \
+                                                | ARCH_FEATURE_LZCNT | ARCH_FEATURE_BMI1 \
+                                                | ARCH_FEATURE_BMI2)
+
 #endif
@@ -6,7 +6,7 @@
 #include "ast.h"
 #include "lexer.h"
 
-data_type_t *ast_data_table[AST_DATA_COUNT] = {
+COMPILE_LOCAL data_type_t *ast_data_table[AST_DATA_COUNT] = {
     &(data_type_t) { TYPE_VOID,    0,                      true },   /* void                */
     &(data_type_t) { TYPE_LONG,    ARCH_TYPE_SIZE_LONG,    true },   /* long                */
     &(data_type_t) { TYPE_LLONG,   ARCH_TYPE_SIZE_LLONG,   true },   /* long long           */
@@ -21,18 +21,47 @@ data_type_t *ast_data_table[AST_DATA_COUNT] = {
     NULL                                                             /* function            */
 };
 
-data_type_t *ast_data_function = NULL;
+COMPILE_LOCAL data_type_t *ast_data_function = NULL;
 
-list_t      *ast_locals      = NULL;
-list_t      *ast_gotos       = NULL;
-list_t      *ast_floats      = &SENTINEL_LIST;
-list_t      *ast_strings     = &SENTINEL_LIST;
+COMPILE_LOCAL list_t      *ast_locals      = NULL;
+COMPILE_LOCAL list_t      *ast_gotos       = NULL;
+COMPILE_LOCAL list_t      *ast_floats      = &SENTINEL_LIST;
+COMPILE_LOCAL list_t      *ast_strings     = &SENTINEL_LIST;
 
-table_t     *ast_labels      = NULL;
-table_t     *ast_globalenv   = &SENTINEL_TABLE;
-table_t     *ast_localenv    = &SENTINEL_TABLE;
-table_t     *ast_structures  = &SENTINEL_TABLE;
-table_t     *ast_unions      = &SENTINEL_TABLE;
+COMPILE_LOCAL table_t     *ast_labels      = NULL;
+COMPILE_LOCAL table_t     *ast_globalenv   = &SENTINEL_TABLE;
+COMPILE_LOCAL table_t     *ast_localenv    = &SENTINEL_TABLE;
+COMPILE_LOCAL table_t     *ast_structures  = &SENTINEL_TABLE;
+COMPILE_LOCAL table_t     *ast_unions      = &SENTINEL_TABLE;
+
+COMPILE_LOCAL int          ast_nodes       = 0;
+
+static COMPILE_LOCAL int   ast_label_index = 0;
+static COMPILE_LOCAL char *ast_label_space = NULL;
+static COMPILE_LOCAL int   ast_label_count = 0;
+
+void ast_init(void) {
+    ast_data_table[AST_DATA_FUNCTION] = NULL;
+
+    ast_data_function = NULL;
+    ast_locals        = NULL;
+    ast_gotos         = NULL;
+    ast_labels        = NULL;
+    ast_floats        = list_create();
+    ast_strings       = list_create();
+    ast_globalenv     = table_create(NULL);
+    ast_localenv      = ast_globalenv;
+    ast_structures    = table_create(NULL);
+    ast_unions        = table_create(NULL);
+    ast_label_index   = 0;
+    ast_label_space   = NULL;
+    ast_nodes         = 0;
+}
+
+void ast_label_namespace(char *space) {
+    ast_label_space = space;
+    ast_label_count = 0;
+}
 
 static data_type_t *ast_result_type_impl(jmp_buf *jmpbuf, char op, data_type_t *a, data_type_t *b) {
     if (a->type > b->type) {
@@ -111,6 +140,13 @@ static data_type_t *ast_result_type_impl(jmp_buf *jmpbuf, char op, data_type_t *
             if (b->type != TYPE_ARRAY)
                 goto error;
             return ast_result_type_impl(jmpbuf, op, a->pointer, b->pointer);
+
+        /* only assignment between the same structure */
+        case TYPE_STRUCTURE:
+            if (op != '=' || b->type != TYPE_STRUCTURE || a->fields != b->fields)
+                goto error;
+            return a;
+
         default:
             compile_error("ICE");
     }
@@ -163,6 +199,7 @@ data_type_t *ast_result_type(int op, data_type_t *a, data_type_t *b) {
 ast_t *ast_copy(ast_t *ast) {
     ast_t *copy = memory_allocate(sizeof(ast_t));
     *copy = *ast;
+    ast_nodes++;
     return copy;
 }
 
@@ -219,12 +256,16 @@ ast_t *ast_new_floating(data_type_t *type, double value) {
     return ast;
 }
 
+/* named after the contents so code using it doesn't depend on the order of literals */
 ast_t *ast_new_string(char *value) {
+    string_t *label = string_create();
+    string_catf(label, ".LS%016lx", hash_bytes(HASH_INITIAL, value, strlen(value)));
+
     return ast_copy(&(ast_t) {
         .type         = AST_TYPE_STRING,
         .ctype        = ast_array(ast_data_table[AST_DATA_CHAR], strlen(value) + 1),
         .string.data  = value,
-        .string.label = ast_label()
+        .string.label = string_buffer(label)
     });
 }
 
@@ -258,6 +299,7 @@ ast_t *ast_call(data_type_t *type, char *name, list_t *arguments, list_t *parame
         .ctype                    = type,
         .function.call.paramtypes = parametertypes,
         .function.call.args       = arguments,
+        .function.call.tail       = false,
         .function.name            = name
     });
 }
@@ -361,6 +403,31 @@ ast_t *ast_goto(char *label) {
     });
 }
 
+ast_t *ast_goto_computed(ast_t *target) {
+    return ast_copy(&(ast_t){
+        .type          = AST_TYPE_STATEMENT_GOTO_COMPUTED,
+        .unary.operand = target
+    });
+}
+
+ast_t *ast_label_address(char *label) {
+    return ast_copy(&(ast_t){
+        .type           = AST_TYPE_LABEL_ADDRESS,
+        .ctype          = ast_pointer(ast_data_table[AST_DATA_VOID]),
+        .gotostmt.label = label,
+        .gotostmt.where = NULL
+    });
+}
+
+ast_t *ast_prefetch(ast_t *address, int locality) {
+    return ast_copy(&(ast_t){
+        .type  = AST_TYPE_PREFETCH,
+        .ctype = ast_data_table[AST_DATA_VOID],
+        .left  = address,
+        .right = ast_new_integer(ast_data_table[AST_DATA_INT], locality)
+    });
+}
+
 ast_t *ast_new_label(char *label) {
     return ast_copy(&(ast_t){
         .type           = AST_TYPE_STATEMENT_LABEL,
@@ -385,6 +452,28 @@ ast_t *ast_compound(list_t *statements) {
     });
 }
 
+/*
+ * Both keep the expression they stand for on the right, a reload never
+ * evaluates it but it's needed for comparing expressions.
+ */
+ast_t *ast_save(ast_t *temporary, ast_t *value) {
+    return ast_copy(&(ast_t){
+        .type  = AST_TYPE_EXPRESSION_SAVE,
+        .ctype = value->ctype,
+        .left  = temporary,
+        .right = value
+    });
+}
+
+ast_t *ast_reload(ast_t *temporary, ast_t *value) {
+    return ast_copy(&(ast_t){
+        .type  = AST_TYPE_EXPRESSION_RELOAD,
+        .ctype = value->ctype,
+        .left  = temporary,
+        .right = value
+    });
+}
+
 data_type_t *ast_structure_field(data_type_t *type, int offset) {
     data_type_t *field = ast_type_copy(type);
     field->offset = offset;
@@ -401,9 +490,11 @@ data_type_t *ast_structure_new(table_t *fields, int size, bool isstruct) {
 }
 
 char *ast_label(void) {
-    static int index = 0;
     string_t *string = string_create();
-    string_catf(string, ".L%d", index++);
+    if (!ast_label_space)
+        string_catf(string, ".L%d", ast_label_index++);
+    else
+        string_catf(string, ".L%s.%d", ast_label_space, ast_label_count++);
     return string_buffer(string);
 }
 
@@ -720,6 +811,14 @@ static void ast_string_impl(string_t *string, ast_t *ast) {
             string_catf(string, "(return %s)", ast_string(ast->returnstmt));
             break;
 
+        case AST_TYPE_STATEMENT_GOTO_COMPUTED:
+            string_catf(string, "(goto *%s)", ast_string(ast->unary.operand));
+            break;
+
+        case AST_TYPE_LABEL_ADDRESS:
+            string_catf(string, "&&%s", ast->gotostmt.label);
+            break;
+
         case AST_TYPE_ADDRESS:      ast_string_unary (string, "&",  ast); break;
         case AST_TYPE_DEREFERENCE:  ast_string_unary (string, "*",  ast); break;
         case LEXER_TOKEN_INCREMENT: ast_string_unary (string, "++", ast); break;
@@ -733,6 +832,22 @@ static void ast_string_impl(string_t *string, ast_t *ast) {
         case LEXER_TOKEN_LEQUAL:    ast_string_binary(string, "<=", ast); break;
         case LEXER_TOKEN_NEQUAL:    ast_string_binary(string, "!=", ast); break;
 
+        case AST_TYPE_POPCOUNT:     ast_string_unary (string, "popcount", ast); break;
+        case AST_TYPE_CLZ:          ast_string_unary (string, "clz",      ast); break;
+        case AST_TYPE_CTZ:          ast_string_unary (string, "ctz",      ast); break;
+        case AST_TYPE_BSWAP:        ast_string_unary (string, "bswap",    ast); break;
+        case AST_TYPE_ROTATE_LEFT:  ast_string_binary(string, "rotl",     ast); break;
+        case AST_TYPE_ROTATE_RIGHT: ast_string_binary(string, "rotr",     ast); break;
+        case AST_TYPE_PREFETCH:     ast_string_binary(string, "prefetch", ast); break;
+
+        case AST_TYPE_EXPRESSION_SAVE:
+            string_catf(string, "(save %s)", ast_string(ast->right));
+            break;
+
+        case AST_TYPE_EXPRESSION_RELOAD:
+            string_catf(string, "(reload %s)", ast_string(ast->right));
+            break;
+
         case AST_TYPE_EXPRESSION_CAST:
             string_catf(string, "((%s) -> (%s) %s)",
                 ast_type_string(ast->unary.operand->ctype),
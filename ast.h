@@ -38,7 +38,9 @@ typedef struct ast_s ast_t;
  *  AST_TYPE_STATEMENT_CONTINUE      - Continue statement
  *  AST_TYPE_STATEMENT_COMPOUND      - Compound statement
  *  AST_TYPE_STATEMENT_GOTO          - Goto statement
+ *  AST_TYPE_STATEMENT_GOTO_COMPUTED - Goto statement through a label address
  *  AST_TYPE_STATEMENT_LABEL         - Goto statement label
+ *  AST_TYPE_LABEL_ADDRESS           - Address of a label
  *  AST_TYPE_POST_INCREMENT          - Post increment operation
  *  AST_TYPE_POST_DECREMENT          - Post decrement operation
  *  AST_TYPE_PRE_INCREMENT           - Pre increment operation
@@ -51,6 +53,15 @@ typedef struct ast_s ast_t;
  *  AST_TYPE_NEQUAL                  - Not-equal condition
  *  AST_TYPE_AND                     - Logical-and operation
  *  AST_TYPE_OR                      - Logical-or operation
+ *  AST_TYPE_POPCOUNT                - Count of set bits
+ *  AST_TYPE_CLZ                     - Count of leading zero bits
+ *  AST_TYPE_CTZ                     - Count of trailing zero bits
+ *  AST_TYPE_BSWAP                   - Byte order reversal
+ *  AST_TYPE_ROTATE_LEFT             - Left rotate operation
+ *  AST_TYPE_ROTATE_RIGHT            - Right rotate operation
+ *  AST_TYPE_PREFETCH                - Cache prefetch hint
+ *  AST_TYPE_EXPRESSION_SAVE         - Evaluate and keep in a temporary
+ *  AST_TYPE_EXPRESSION_RELOAD       - Reuse value kept in a temporary
  */
 typedef enum {
     AST_TYPE_LITERAL = 0x100,
@@ -79,7 +90,9 @@ typedef enum {
     AST_TYPE_STATEMENT_CONTINUE,
     AST_TYPE_STATEMENT_COMPOUND,
     AST_TYPE_STATEMENT_GOTO,
+    AST_TYPE_STATEMENT_GOTO_COMPUTED,
     AST_TYPE_STATEMENT_LABEL,
+    AST_TYPE_LABEL_ADDRESS,
     AST_TYPE_POST_INCREMENT,
     AST_TYPE_POST_DECREMENT,
     AST_TYPE_PRE_INCREMENT,
@@ -91,7 +104,16 @@ typedef enum {
     AST_TYPE_LEQUAL,
     AST_TYPE_NEQUAL,
     AST_TYPE_AND,
-    AST_TYPE_OR
+    AST_TYPE_OR,
+    AST_TYPE_POPCOUNT,
+    AST_TYPE_CLZ,
+    AST_TYPE_CTZ,
+    AST_TYPE_BSWAP,
+    AST_TYPE_ROTATE_LEFT,
+    AST_TYPE_ROTATE_RIGHT,
+    AST_TYPE_PREFETCH,
+    AST_TYPE_EXPRESSION_SAVE,
+    AST_TYPE_EXPRESSION_RELOAD
 } ast_type_t;
 
 /*
@@ -204,6 +226,24 @@ typedef enum {
     STORAGE_REGISTER
 } storage_t;
 
+/*
+ * Type: attribute_t
+ *  Describes the attributes a function is declared with, as a set of
+ *  flags
+ *
+ *  Constants:
+ *
+ *  ATTRIBUTE_HOT       - called often, kept with the other hot code
+ *  ATTRIBUTE_COLD      - rarely called, kept away from the rest and
+ *                        calls to it are unlikely to happen
+ *  ATTRIBUTE_NOINLINE  - never to be inlined
+ */
+typedef enum {
+    ATTRIBUTE_HOT      = 1 << 0,
+    ATTRIBUTE_COLD     = 1 << 1,
+    ATTRIBUTE_NOINLINE = 1 << 2
+} attribute_t;
+
 /*
  * Struct: data_type_t
  *  A structure that describes a data type.
@@ -353,6 +393,34 @@ typedef struct {
      *  Compound literal list for initialization
      */
     list_t *init;
+
+    /*
+     * Variable: escapes
+     *  Contains the value `true` when the variable has to live in
+     *  memory: its address is taken, or it's an array, structure
+     *  or compound literal.
+     */
+    bool escapes;
+
+    /*
+     * Variable: uses
+     *  How often the variable is accessed, with accesses inside of
+     *  loops weighted more.
+     */
+    int uses;
+
+    /*
+     * Variable: reg
+     *  When non-zero, the variable is kept in this register (counting
+     *  from one) of the code generator instead of on the stack.
+     */
+    int reg;
+
+    /*
+     * Variable: attributes
+     *  The <attribute_t> flags a function was declared with.
+     */
+    int attributes;
 } ast_variable_t;
 
 /*
@@ -375,6 +443,13 @@ typedef struct {
      *  Pointer to a list of parameter types for the function call.
      */
     list_t *paramtypes;
+
+    /*
+     * Variable: tail
+     *  Contains the value `true` when the call is returned directly
+     *  and may reuse the frame of the calling function.
+     */
+    bool tail;
 } ast_function_call_t;
 
 /*
@@ -418,6 +493,24 @@ typedef struct {
      *  which are the forming of the function body.
      */
     ast_t  *body;
+
+    /*
+     * Variable: digest
+     *  Hash of the tokens of the definition and of every declaration
+     *  before it in the translation unit.
+     *
+     * Remarks:
+     *  Nothing else goes into the code generated for the function, so
+     *  that code can be reused for as long as the digest is the same.
+     */
+    unsigned long digest;
+
+    /*
+     * Variable: attributes
+     *  The <attribute_t> flags of the definition and of every
+     *  declaration before it.
+     */
+    int attributes;
 } ast_function_t;
 
 /*
@@ -479,6 +572,13 @@ typedef struct {
      *  Basic block for false path in branch
      */
     ast_t  *last;
+
+    /*
+     * Variable: expect
+     *  Negative when the truth path is unlikely to be taken, positive
+     *  when it is likely, zero when nothing is known.
+     */
+    int     expect;
 } ast_ifthan_t;
 
 /*
@@ -535,7 +635,8 @@ typedef struct {
 
 /*
  * Struct: ast_goto_t
- *  Represents a goto statement (or label) in the AST tree.
+ *  Represents a goto statement, label or address of a label in the
+ *  AST tree.
  */
 typedef struct {
     /*
@@ -572,6 +673,15 @@ struct ast_s {
     int          type;
     data_type_t *ctype;
 
+    /*
+     * Variable: file, line, column
+     *  Where a statement or function definition starts in the source,
+     *  see <lexer_token_t>. Zero for every other node.
+     */
+    int          file;
+    int          line;
+    int          column;
+
     union {
         int             casevalue;
         long            integer;
@@ -608,17 +718,30 @@ struct ast_s {
     };
 };
 
-extern data_type_t *ast_data_table[AST_DATA_COUNT];
+extern COMPILE_LOCAL data_type_t *ast_data_table[AST_DATA_COUNT];
+
+extern COMPILE_LOCAL list_t      *ast_floats;
+extern COMPILE_LOCAL list_t      *ast_strings;
+extern COMPILE_LOCAL list_t      *ast_locals;
+extern COMPILE_LOCAL list_t      *ast_gotos;
+extern COMPILE_LOCAL table_t     *ast_globalenv;
+extern COMPILE_LOCAL table_t     *ast_localenv;
+extern COMPILE_LOCAL table_t     *ast_structures;
+extern COMPILE_LOCAL table_t     *ast_unions;
+extern COMPILE_LOCAL table_t     *ast_labels;
 
-extern list_t      *ast_floats;
-extern list_t      *ast_strings;
-extern list_t      *ast_locals;
-extern list_t      *ast_gotos;
-extern table_t     *ast_globalenv;
-extern table_t     *ast_localenv;
-extern table_t     *ast_structures;
-extern table_t     *ast_unions;
-extern table_t     *ast_labels;
+/*
+ * Variable: ast_nodes
+ *  Number of nodes created for the translation unit so far.
+ */
+extern COMPILE_LOCAL int          ast_nodes;
+
+/*
+ * Function: ast_init
+ *  Start over with empty environments and literal lists for the
+ *  next translation unit.
+ */
+void ast_init(void);
 
 /*
  * Function: ast_structure_reference
@@ -675,6 +798,22 @@ ast_t *ast_new_label(char *);
 
 char *ast_label(void);
 
+/*
+ * Function: ast_label_namespace
+ *  Give the labels made by the calling thread a namespace of their own
+ *
+ * Parameters:
+ *  space - Name of the namespace, or NULL for the default one
+ *
+ * Remarks:
+ *  Labels in different namespaces never collide, so code for several
+ *  functions can be generated at the same time. Numbering restarts
+ *  within each namespace so the labels don't depend on which thread
+ *  generated them, nor on anything else in the translation unit when
+ *  the namespace is named after the function they belong to.
+ */
+void ast_label_namespace(char *space);
+
 ast_t *ast_declaration(ast_t *var, list_t *init);
 ast_t *ast_variable_local(data_type_t *type, char *name);
 ast_t *ast_variable_global(data_type_t *type, char *name);
@@ -691,7 +830,12 @@ ast_t *ast_ternary(data_type_t *type, ast_t *cond, ast_t *then, ast_t *last);
 ast_t *ast_switch(ast_t *expr, ast_t *body);
 ast_t *ast_case(int value);
 ast_t *ast_goto(char *);
+ast_t *ast_goto_computed(ast_t *target);
+ast_t *ast_label_address(char *label);
+ast_t *ast_prefetch(ast_t *address, int locality);
 ast_t *ast_make(int type);
+ast_t *ast_save(ast_t *temporary, ast_t *value);
+ast_t *ast_reload(ast_t *temporary, ast_t *value);
 
 data_type_t *ast_prototype(data_type_t *returntype, list_t *paramtypes, bool dots);
 data_type_t *ast_pointer(data_type_t *type);
@@ -0,0 +1,127 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/*
+ * Runtime benchmark: runs every program as compiled by LICE and by
+ * the system compiler at -O0 and -O2, and reports the cycles of the
+ * best of a number of runs and how LICE compares. The programs print
+ * a checksum, which has to be the same for all three.
+ */
+static const char *cycles_variants[] = { "lice", "O0", "O2" };
+
+#define CYCLES_VARIANTS (sizeof(cycles_variants) / sizeof(*cycles_variants))
+
+/* the time stamp counter, cycles at the nominal frequency */
+static unsigned long long cycles_now(void) {
+    return __builtin_ia32_rdtsc();
+}
+
+static bool cycles_run(const char *program, char *output, size_t size, unsigned long long *cycles) {
+    int pipes[2];
+    int status;
+
+    if (pipe(pipes) == -1)
+        return false;
+
+    unsigned long long start = cycles_now();
+    pid_t              pid   = fork();
+
+    if (pid == 0) {
+        close(pipes[0]);
+        dup2(pipes[1], 1);
+        execl(program, program, (char*)NULL);
+        _exit(127);
+    }
+    close(pipes[1]);
+
+    size_t  length = 0;
+    ssize_t got;
+    while ((got = read(pipes[0], output + length, size - 1 - length)) > 0)
+        length += got;
+    output[length] = '\0';
+    close(pipes[0]);
+
+    if (pid == -1 || waitpid(pid, &status, 0) == -1)
+        return false;
+
+    *cycles = cycles_now() - start;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char **argv) {
+    const char *results = NULL;
+    const char *label   = "-";
+    int         runs    = 3;
+    int         arg     = 1;
+    bool        ok      = true;
+
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (!strcmp(argv[arg], "-o") && arg + 1 < argc)
+            results = argv[++arg];
+        else if (!strcmp(argv[arg], "-l") && arg + 1 < argc)
+            label = argv[++arg];
+        else if (!strcmp(argv[arg], "-r") && arg + 1 < argc)
+            runs = atoi(argv[++arg]);
+        else
+            break;
+    }
+
+    if (arg == argc || runs < 1) {
+        fprintf(stderr, "usage: %s [-o RESULTS [-l LABEL]] [-r RUNS] PROGRAM...\n"
+                        "runs PROGRAM.lice, PROGRAM.O0 and PROGRAM.O2\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *log = results ? fopen(results, "a") : NULL;
+    if (results && !log) {
+        fprintf(stderr, "%s: cannot open `%s'\n", argv[0], results);
+        return EXIT_FAILURE;
+    }
+
+    printf("%-14s %12s %12s %12s %9s %9s\n", "program", "lice Mcycles", "-O0 Mcycles", "-O2 Mcycles",
+        "lice/-O0", "lice/-O2");
+
+    for (; arg < argc; arg++) {
+        const char        *name   = strrchr(argv[arg], '/') ? strrchr(argv[arg], '/') + 1 : argv[arg];
+        unsigned long long best[CYCLES_VARIANTS] = { 0 };
+        char               expected[256];
+
+        for (size_t variant = 0; variant < CYCLES_VARIANTS; variant++) {
+            char program[4096];
+            char output[256];
+
+            snprintf(program, sizeof(program), "%s.%s", argv[arg], cycles_variants[variant]);
+            for (int run = 0; run < runs; run++) {
+                unsigned long long cycles;
+                if (!cycles_run(program, output, sizeof(output), &cycles)) {
+                    fprintf(stderr, "%s: running `%s' failed\n", argv[0], program);
+                    return EXIT_FAILURE;
+                }
+                if (!best[variant] || cycles < best[variant])
+                    best[variant] = cycles;
+            }
+
+            if (variant == 0)
+                strcpy(expected, output);
+            else if (strcmp(expected, output)) {
+                fprintf(stderr, "%s: `%s' printed a different checksum than LICE's\n", argv[0], program);
+                ok = false;
+            }
+        }
+
+        printf("%-14s %12.1f %12.1f %12.1f %9.2f %9.2f\n", name, best[0] / 1e6, best[1] / 1e6, best[2] / 1e6,
+            (double)best[0] / best[1], (double)best[0] / best[2]);
+        if (log)
+            fprintf(log, "%ld %s %s %llu %llu %llu\n", (long)time(NULL), label, name, best[0], best[1], best[2]);
+    }
+
+    if (log)
+        fclose(log);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,125 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+/*
+ * Generator of large translation units for the throughput benchmark,
+ * each kind stresses a different part of the compiler. Everything
+ * generated is in the subset of C that LICE compiles, and links into
+ * a program which does nothing much.
+ */
+
+/* thousands of small functions calling each other */
+static void generate_functions(int count) {
+    for (int i = 0; i < count; i++) {
+        printf("int function_%d(int a, int b) {\n", i);
+        printf("    int c = a * %d + b;\n", i % 17 + 1);
+        printf("    if (c > %d)\n", i * 3);
+        printf("        c = c - b;\n");
+        printf("    for (int i = 0; i < %d; i++)\n", i % 5 + 1);
+        printf("        c = c + i;\n");
+        if (i)
+            printf("    return c + function_%d(b, a);\n", i - 1);
+        else
+            printf("    return c;\n");
+        printf("}\n\n");
+    }
+    printf("int main() {\n    return function_%d(1, 2) & 0;\n}\n", count - 1);
+}
+
+/* nested expressions as deep as the parser recurses */
+static void generate_expression(int depth, unsigned int seed) {
+    static const char *operators[] = { "+", "-", "*", "&", "|", "^" };
+    if (depth == 0) {
+        printf("%s", (seed % 3 == 0) ? "a" : (seed % 3 == 1) ? "b" : "c");
+        return;
+    }
+    printf("(");
+    generate_expression(depth - 1, seed * 7 + 1);
+    printf(" %s %d)", operators[seed % 6], seed % 97 + 1);
+}
+
+static void generate_expressions(int count) {
+    printf("int expressions(int a, int b, int c) {\n    int x = 0;\n");
+    for (int i = 0; i < count; i++) {
+        printf("    x = x + ");
+        generate_expression(32 + i % 32, i);
+        printf(";\n");
+    }
+    printf("    return x;\n}\n\n");
+    printf("int main() {\n    return expressions(1, 2, 3) & 0;\n}\n");
+}
+
+/* big initialized arrays and aggregates */
+static void generate_initializers(int count) {
+    printf("struct record { int key; long value; char tag; };\n\n");
+    for (int i = 0; i < count / 1024 + 1; i++) {
+        printf("int table_%d[1024] = {", i);
+        for (int j = 0; j < 1024; j++)
+            printf("%s%u", j ? (j % 16 ? ", " : ",\n   ") : " ", (i * 1024 + j) * 2654435761U % 100000);
+        printf(" };\n\n");
+        printf("struct record records_%d[64] = {", i);
+        for (int j = 0; j < 64; j++)
+            printf("%s{ %d, %d, %d }", j ? (j % 4 ? ", " : ",\n   ") : " ", j, j * i, j % 127);
+        printf(" };\n\n");
+    }
+    printf("int main() {\n    return table_0[0] & 0;\n}\n");
+}
+
+/* switches with many cases */
+static void generate_switches(int count) {
+    for (int i = 0; i < count / 256 + 1; i++) {
+        printf("int switch_%d(int value) {\n    int r = 0;\n    switch (value) {\n", i);
+        for (int j = 0; j < 256; j++)
+            printf("        case %d: r = %d; break;\n", j * (i % 3 + 1), j ^ i);
+        printf("        default: r = -1;\n    }\n    return r;\n}\n\n");
+    }
+    printf("int main() {\n    return switch_0(3) & 0;\n}\n");
+}
+
+/* many globals of every type, and functions using them */
+static void generate_globals(int count) {
+    static const char *types[] = { "char", "short", "int", "long", "double", "float" };
+    for (int i = 0; i < count; i++)
+        printf("%s global_%d%s;\n", types[i % 6], i, (i % 4 == 0) ? "[8]" : "");
+    printf("\n");
+    for (int i = 0; i < count; i += 64) {
+        printf("long globals_%d() {\n    long sum = 0;\n", i);
+        for (int j = i; j < i + 64 && j < count; j++) {
+            if (j % 4 == 0)
+                printf("    sum = sum + global_%d[%d];\n", j, j % 8);
+            else
+                printf("    sum = sum + global_%d;\n", j);
+        }
+        printf("    return sum;\n}\n\n");
+    }
+    printf("int main() {\n    return globals_0() & 0;\n}\n");
+}
+
+static const struct {
+    const char *name;
+    void      (*generate)(int count);
+} generators[] = {
+    { "functions",    &generate_functions    },
+    { "expressions",  &generate_expressions  },
+    { "initializers", &generate_initializers },
+    { "switches",     &generate_switches     },
+    { "globals",      &generate_globals      }
+};
+
+int main(int argc, char **argv) {
+    if (argc == 3) {
+        for (size_t i = 0; i < sizeof(generators) / sizeof(*generators); i++) {
+            if (strcmp(argv[1], generators[i].name))
+                continue;
+            generators[i].generate(atoi(argv[2]) > 0 ? atoi(argv[2]) : 1);
+            return EXIT_SUCCESS;
+        }
+    }
+
+    fprintf(stderr, "usage: %s KIND COUNT > input.c\nkinds:", argv[0]);
+    for (size_t i = 0; i < sizeof(generators) / sizeof(*generators); i++)
+        fprintf(stderr, " %s", generators[i].name);
+    fprintf(stderr, "\n");
+    return EXIT_FAILURE;
+}
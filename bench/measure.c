@@ -0,0 +1,209 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE /* wait4 */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+/*
+ * Throughput benchmark: compiles every input a number of times and
+ * reports lines and tokens per second of the best run, and the peak
+ * resident set of the worst. Results are compared against a baseline
+ * of an earlier run, a slowdown or growth beyond the threshold fails.
+ */
+typedef struct {
+    char  *name;
+    long   lines;
+    long   tokens;
+    double seconds;
+    long   rss;
+} measure_t;
+
+static double measure_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* runs the compiler with the input on stdin, discarding the assembly */
+static bool measure_run(const char *compiler, const char *input, const char *option,
+                        int report, double *seconds, long *rss) {
+    struct rusage usage;
+    int           status;
+    double        start = measure_now();
+    pid_t         pid   = fork();
+
+    if (pid == 0) {
+        int in   = open(input, O_RDONLY);
+        int null = open("/dev/null", O_WRONLY);
+        if (in == -1 || null == -1)
+            _exit(127);
+        dup2(in, 0);
+        dup2(null, 1);
+        if (report != -1)
+            dup2(report, 2);
+        execl(compiler, compiler, option, (char*)NULL);
+        _exit(127);
+    }
+    if (pid == -1 || wait4(pid, &status, 0, &usage) == -1)
+        return false;
+
+    *seconds = measure_now() - start;
+    *rss     = usage.ru_maxrss;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static long measure_lines(const char *input) {
+    FILE *file  = fopen(input, "r");
+    long  lines = 0;
+    int   c;
+
+    if (!file)
+        return 0;
+    while ((c = fgetc(file)) != EOF)
+        lines += (c == '\n');
+    fclose(file);
+    return lines;
+}
+
+/* the token count comes from the compiler's own report */
+static long measure_tokens(const char *compiler, const char *input) {
+    FILE   *report = tmpfile();
+    char    buffer[4096];
+    double  seconds;
+    long    rss;
+    long    tokens = 0;
+
+    if (!report || !measure_run(compiler, input, "--time-report=json", fileno(report), &seconds, &rss))
+        return 0;
+
+    rewind(report);
+    size_t got = fread(buffer, 1, sizeof(buffer) - 1, report);
+    buffer[got] = '\0';
+    char *field = strstr(buffer, "\"tokens\":");
+    if (field)
+        tokens = atol(field + strlen("\"tokens\":"));
+    fclose(report);
+    return tokens;
+}
+
+static char *measure_name(const char *input) {
+    const char *base = strrchr(input, '/');
+    char       *name = strdup(base ? base + 1 : input);
+    char       *dot  = strrchr(name, '.');
+    if (dot)
+        *dot = '\0';
+    return name;
+}
+
+static bool measure_baseline(const char *path, measure_t *measure, double threshold) {
+    FILE  *file = fopen(path, "r");
+    char   name[256];
+    double lines;
+    double tokens;
+    long   rss;
+    bool   ok   = true;
+
+    if (!file)
+        return true;
+
+    while (fscanf(file, "%255s %lf %lf %ld", name, &lines, &tokens, &rss) == 4) {
+        if (strcmp(name, measure->name))
+            continue;
+
+        double now = measure->lines / measure->seconds;
+        if (now < lines * (1 - threshold)) {
+            printf("  regression: %s compiles %.0f lines/s, was %.0f\n", name, now, lines);
+            ok = false;
+        }
+        if (measure->rss > rss * (1 + threshold)) {
+            printf("  regression: %s needs %ld KB, was %ld\n", name, measure->rss, rss);
+            ok = false;
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    const char *baseline  = NULL;
+    bool        update    = false;
+    double      threshold = 0.2;
+    int         runs      = 5;
+    int         arg       = 1;
+
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (!strcmp(argv[arg], "-b") && arg + 1 < argc)
+            baseline = argv[++arg];
+        else if (!strcmp(argv[arg], "-u"))
+            update = true;
+        else if (!strcmp(argv[arg], "-t") && arg + 1 < argc)
+            threshold = atof(argv[++arg]) / 100;
+        else if (!strcmp(argv[arg], "-r") && arg + 1 < argc)
+            runs = atoi(argv[++arg]);
+        else
+            break;
+    }
+
+    if (argc - arg < 2 || runs < 1) {
+        fprintf(stderr, "usage: %s [-b BASELINE [-u]] [-t PERCENT] [-r RUNS] COMPILER INPUT...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char *compiler = argv[arg++];
+    int         count    = argc - arg;
+    measure_t  *measures = calloc(count, sizeof(measure_t));
+    bool        ok       = true;
+
+    printf("%-14s %8s %10s %12s %12s %10s\n", "input", "lines", "seconds", "lines/s", "tokens/s", "peak KB");
+    for (int i = 0; i < count; i++) {
+        measure_t *measure = &measures[i];
+        const char *input  = argv[arg + i];
+
+        measure->name    = measure_name(input);
+        measure->lines   = measure_lines(input);
+        measure->tokens  = measure_tokens(compiler, input);
+        measure->seconds = 0;
+
+        for (int run = 0; run < runs; run++) {
+            double seconds;
+            long   rss;
+            if (!measure_run(compiler, input, "-j1", -1, &seconds, &rss)) {
+                fprintf(stderr, "%s: compiling `%s' failed\n", argv[0], input);
+                return EXIT_FAILURE;
+            }
+            if (!measure->seconds || seconds < measure->seconds)
+                measure->seconds = seconds;
+            if (rss > measure->rss)
+                measure->rss = rss;
+        }
+
+        printf("%-14s %8ld %10.4f %12.0f %12.0f %10ld\n", measure->name, measure->lines, measure->seconds,
+            measure->lines / measure->seconds, measure->tokens / measure->seconds, measure->rss);
+        if (baseline && !update && !measure_baseline(baseline, measure, threshold))
+            ok = false;
+    }
+
+    if (baseline && update) {
+        FILE *file = fopen(baseline, "w");
+        if (!file) {
+            fprintf(stderr, "%s: cannot write `%s'\n", argv[0], baseline);
+            return EXIT_FAILURE;
+        }
+        for (int i = 0; i < count; i++)
+            fprintf(file, "%s %.0f %.0f %ld\n", measures[i].name, measures[i].lines / measures[i].seconds,
+                measures[i].tokens / measures[i].seconds, measures[i].rss);
+        fclose(file);
+        printf("baseline written to %s\n", baseline);
+    }
+
+    for (int i = 0; i < count; i++)
+        free(measures[i].name);
+    free(measures);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
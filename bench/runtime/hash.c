@@ -0,0 +1,49 @@
+/* bit operations and table probing: FNV hashing into an open addressed table */
+int printf(const char *format, ...);
+
+#define SLOTS 262144
+#define MASK  (SLOTS - 1)
+
+long hash_keys[SLOTS];
+int  hash_counts[SLOTS];
+
+long hash_mix(long key) {
+    long hash = 2166136261;
+    for (int i = 0; i < 8; i++) {
+        hash = hash ^ ((key >> (i * 8)) & 255);
+        hash = (hash * 16777619) & 4294967295;
+    }
+    return hash;
+}
+
+void hash_insert(long key) {
+    int slot = hash_mix(key) & MASK;
+    while (hash_counts[slot] && hash_keys[slot] != key)
+        slot = (slot + 1) & MASK;
+    hash_keys[slot] = key;
+    hash_counts[slot]++;
+}
+
+int hash_find(long key) {
+    int slot = hash_mix(key) & MASK;
+    while (hash_counts[slot]) {
+        if (hash_keys[slot] == key)
+            return hash_counts[slot];
+        slot = (slot + 1) & MASK;
+    }
+    return 0;
+}
+
+int main() {
+    long seed  = 7;
+    long found = 0;
+
+    for (int i = 0; i < 1600000; i++) {
+        seed = (seed * 1103515245 + 12345) & 2147483647;
+        hash_insert(seed % 150000);
+    }
+    for (long key = 0; key < 1200000; key++)
+        found = found + hash_find(key) * (key & 7);
+    printf("%ld\n", found);
+    return 0;
+}
@@ -0,0 +1,66 @@
+/* indirect branches: a switch dispatched bytecode interpreter */
+int printf(const char *format, ...);
+
+enum {
+    OP_PUSH,
+    OP_LOAD,
+    OP_STORE,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_MOD,
+    OP_JUMP,
+    OP_JUMPNZ,
+    OP_DUP,
+    OP_HALT
+};
+
+int interpreter_code[64];
+long interpreter_stack[64];
+long interpreter_slots[8];
+
+long interpreter_run(int *code) {
+    int   pc = 0;
+    int   sp = 0;
+    long *stack = interpreter_stack;
+    long *slots = interpreter_slots;
+
+    for (;;) {
+        int op = code[pc++];
+        switch (op) {
+            case OP_PUSH:   stack[sp++] = code[pc++];                   break;
+            case OP_LOAD:   stack[sp++] = slots[code[pc++]];            break;
+            case OP_STORE:  slots[code[pc++]] = stack[--sp];            break;
+            case OP_ADD:    sp--; stack[sp - 1] = stack[sp - 1] + stack[sp]; break;
+            case OP_SUB:    sp--; stack[sp - 1] = stack[sp - 1] - stack[sp]; break;
+            case OP_MUL:    sp--; stack[sp - 1] = stack[sp - 1] * stack[sp]; break;
+            case OP_MOD:    sp--; stack[sp - 1] = stack[sp - 1] % stack[sp]; break;
+            case OP_JUMP:   pc = code[pc];                              break;
+            case OP_JUMPNZ: if (stack[--sp]) pc = code[pc]; else pc++;  break;
+            case OP_DUP:    stack[sp] = stack[sp - 1]; sp++;            break;
+            case OP_HALT:   return slots[1];
+        }
+    }
+}
+
+int main() {
+    /*
+     * slot 0 counts down from n, slot 1 accumulates
+     * (acc * 31 + counter) % 1000003
+     */
+    int program[] = {
+        OP_PUSH, 3000000, OP_STORE, 0,
+        OP_PUSH, 1, OP_STORE, 1,
+        /* 8: loop */
+        OP_LOAD, 1, OP_PUSH, 31, OP_MUL, OP_LOAD, 0, OP_ADD,
+        OP_PUSH, 1000003, OP_MOD, OP_STORE, 1,
+        OP_LOAD, 0, OP_PUSH, 1, OP_SUB, OP_DUP, OP_STORE, 0,
+        OP_JUMPNZ, 8,
+        OP_HALT
+    };
+    for (int i = 0; i < sizeof(program) / sizeof(*program); i++)
+        interpreter_code[i] = program[i];
+
+    printf("%ld\n", interpreter_run(interpreter_code));
+    return 0;
+}
@@ -0,0 +1,89 @@
+/* pointer chasing and field access: linked lists of records */
+int printf(const char *format, ...);
+
+#define NODES 200000
+
+struct list_node {
+    long              key;
+    int               weight;
+    char              tag;
+    struct list_node *next;
+};
+
+struct list_node list_pool[NODES];
+
+struct list_node *list_build(int count, long seed) {
+    struct list_node *head = 0;
+    for (int i = 0; i < count; i++) {
+        struct list_node *node = &list_pool[i];
+        seed         = (seed * 1103515245 + 12345) & 2147483647;
+        node->key    = seed % 100000;
+        node->weight = i % 13;
+        node->tag    = 'a' + i % 26;
+        node->next   = head;
+        head         = node;
+    }
+    return head;
+}
+
+struct list_node *list_reverse(struct list_node *node) {
+    struct list_node *previous = 0;
+    while (node) {
+        struct list_node *next = node->next;
+        node->next = previous;
+        previous   = node;
+        node       = next;
+    }
+    return previous;
+}
+
+/* both lists are in key order, and so is the result */
+struct list_node *list_merge(struct list_node *a, struct list_node *b) {
+    struct list_node  head;
+    struct list_node *tail = &head;
+    while (a && b) {
+        if (a->key <= b->key) {
+            tail->next = a;
+            a = a->next;
+        } else {
+            tail->next = b;
+            b = b->next;
+        }
+        tail = tail->next;
+    }
+    tail->next = a ? a : b;
+    return head.next;
+}
+
+struct list_node *list_sort(struct list_node *list, int length) {
+    if (length < 2)
+        return list;
+    struct list_node *middle = list;
+    for (int i = 1; i < length / 2; i++)
+        middle = middle->next;
+    struct list_node *second = middle->next;
+    middle->next = 0;
+    return list_merge(list_sort(list, length / 2), list_sort(second, length - length / 2));
+}
+
+int main() {
+    long sum = 0;
+
+    struct list_node *list = list_build(NODES, 11);
+    for (int round = 0; round < 40; round++) {
+        list = list_reverse(list);
+        for (struct list_node *node = list; node; node = node->next)
+            if (node->tag == 'q')
+                sum = sum + node->weight;
+    }
+    list = list_sort(list, NODES);
+    for (struct list_node *node = list; node && node->next; node = node->next)
+        if (node->key > node->next->key)
+            return 1;
+    for (int i = 0; list && i < 1000; i++) {
+        sum  = sum + list->key;
+        list = list->next;
+    }
+    printf("%ld\n", sum);
+    return 0;
+}
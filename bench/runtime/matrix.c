@@ -0,0 +1,38 @@
+/* arithmetic in loop nests: integer matrix multiply */
+int printf(const char *format, ...);
+
+#define SIZE 200
+
+long matrix_a[SIZE][SIZE];
+long matrix_b[SIZE][SIZE];
+long matrix_c[SIZE][SIZE];
+
+void matrix_multiply() {
+    for (int i = 0; i < SIZE; i++) {
+        for (int j = 0; j < SIZE; j++) {
+            long sum = 0;
+            for (int k = 0; k < SIZE; k++)
+                sum += matrix_a[i][k] * matrix_b[k][j];
+            matrix_c[i][j] = sum;
+        }
+    }
+}
+
+int main() {
+    long trace = 0;
+
+    for (int i = 0; i < SIZE; i++) {
+        for (int j = 0; j < SIZE; j++) {
+            matrix_a[i][j] = (i * 7 + j * 3) % 19 - 9;
+            matrix_b[i][j] = (i * 5 + j * 11) % 23 - 11;
+        }
+    }
+    for (int round = 0; round < 4; round++) {
+        matrix_multiply();
+        matrix_a[round][round] = matrix_c[round][SIZE - 1 - round] % 100;
+    }
+    for (int i = 0; i < SIZE; i++)
+        trace += matrix_c[i][i];
+    printf("%ld\n", trace);
+    return 0;
+}
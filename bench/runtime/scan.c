@@ -0,0 +1,54 @@
+/* byte loads: scanning a generated text for words, digits and a pattern */
+int printf(const char *format, ...);
+
+#define LENGTH 4000000
+
+char scan_text[LENGTH + 1];
+
+int scan_match(char *text, char *pattern) {
+    int i = 0;
+    while (pattern[i]) {
+        if (text[i] != pattern[i])
+            return 0;
+        i++;
+    }
+    return 1;
+}
+
+int main() {
+    static char *words[] = { "lice ", "compiles ", "c ", "quickly, ", "42 ", "times\n" };
+    int  length  = 0;
+    int  word    = 0;
+    long seed    = 3;
+    int  count   = 0;
+    int  digits  = 0;
+    int  matches = 0;
+    int  inword  = 0;
+
+    while (length < LENGTH - 16) {
+        seed = (seed * 1103515245 + 12345) & 2147483647;
+        char *w = words[(seed >> 16) % 6];
+        for (int i = 0; w[i]; i++)
+            scan_text[length++] = w[i];
+        word++;
+    }
+    scan_text[length] = 0;
+
+    for (int round = 0; round < 3; round++) {
+        for (char *p = scan_text; *p; p++) {
+            char c = *p;
+            if (c >= '0' && c <= '9')
+                digits++;
+            if (c == ' ' || c == '\n' || c == ',') {
+                inword = 0;
+            } else if (!inword) {
+                inword = 1;
+                count++;
+            }
+            if (c == 'q' && scan_match(p, "quickly"))
+                matches++;
+        }
+    }
+    printf("%d %d %d %d\n", word, count, digits, matches);
+    return 0;
+}
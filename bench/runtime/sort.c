@@ -0,0 +1,53 @@
+/* memory and branches: quicksort of pseudo random integers */
+int printf(const char *format, ...);
+
+int sort_data[1000000];
+
+void sort_quick(int *data, int low, int high) {
+    while (low < high) {
+        int pivot = data[(low + high) / 2];
+        int i     = low;
+        int j     = high;
+        while (i <= j) {
+            while (data[i] < pivot)
+                i++;
+            while (data[j] > pivot)
+                j--;
+            if (i <= j) {
+                int swap = data[i];
+                data[i]  = data[j];
+                data[j]  = swap;
+                i++;
+                j--;
+            }
+        }
+        /* recurse into the smaller half */
+        if (j - low < high - i) {
+            sort_quick(data, low, j);
+            low = i;
+        } else {
+            sort_quick(data, i, high);
+            high = j;
+        }
+    }
+}
+
+int main() {
+    long seed = 1;
+    long sum  = 0;
+    int  n    = 1000000;
+
+    for (int i = 0; i < n; i++) {
+        seed         = (seed * 1103515245 + 12345) & 2147483647;
+        sort_data[i] = seed >> 8;
+    }
+    sort_quick(sort_data, 0, n - 1);
+
+    for (int i = 1; i < n; i++)
+        if (sort_data[i - 1] > sort_data[i])
+            return 1;
+    for (int i = 0; i < n; i += 1000)
+        sum = sum + sort_data[i];
+    printf("%ld\n", sum);
+    return 0;
+}
@@ -0,0 +1,68 @@
+/* indirect branches: the interpreter benchmark with threaded dispatch */
+int printf(const char *format, ...);
+
+enum {
+    OP_PUSH,
+    OP_LOAD,
+    OP_STORE,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_MOD,
+    OP_JUMP,
+    OP_JUMPNZ,
+    OP_DUP,
+    OP_HALT
+};
+
+int threaded_code[64];
+long threaded_stack[64];
+long threaded_slots[8];
+
+long threaded_run(int *code) {
+    void *dispatch[] = {
+        &&push, &&load, &&store, &&add, &&sub, &&mul,
+        &&mod,  &&jump, &&jumpnz, &&dup, &&halt
+    };
+    int   pc = 0;
+    int   sp = 0;
+    long *stack = threaded_stack;
+    long *slots = threaded_slots;
+
+    /* every handler dispatches the next one itself */
+    goto *dispatch[code[pc++]];
+
+push:   stack[sp++] = code[pc++];                        goto *dispatch[code[pc++]];
+load:   stack[sp++] = slots[code[pc++]];                 goto *dispatch[code[pc++]];
+store:  slots[code[pc++]] = stack[--sp];                 goto *dispatch[code[pc++]];
+add:    sp--; stack[sp - 1] = stack[sp - 1] + stack[sp]; goto *dispatch[code[pc++]];
+sub:    sp--; stack[sp - 1] = stack[sp - 1] - stack[sp]; goto *dispatch[code[pc++]];
+mul:    sp--; stack[sp - 1] = stack[sp - 1] * stack[sp]; goto *dispatch[code[pc++]];
+mod:    sp--; stack[sp - 1] = stack[sp - 1] % stack[sp]; goto *dispatch[code[pc++]];
+jump:   pc = code[pc];                                   goto *dispatch[code[pc++]];
+jumpnz: if (stack[--sp]) pc = code[pc]; else pc++;       goto *dispatch[code[pc++]];
+dup:    stack[sp] = stack[sp - 1]; sp++;                 goto *dispatch[code[pc++]];
+halt:   return slots[1];
+}
+
+int main() {
+    /*
+     * slot 0 counts down from n, slot 1 accumulates
+     * (acc * 31 + counter) % 1000003
+     */
+    int program[] = {
+        OP_PUSH, 3000000, OP_STORE, 0,
+        OP_PUSH, 1, OP_STORE, 1,
+        /* 8: loop */
+        OP_LOAD, 1, OP_PUSH, 31, OP_MUL, OP_LOAD, 0, OP_ADD,
+        OP_PUSH, 1000003, OP_MOD, OP_STORE, 1,
+        OP_LOAD, 0, OP_PUSH, 1, OP_SUB, OP_DUP, OP_STORE, 0,
+        OP_JUMPNZ, 8,
+        OP_HALT
+    };
+    for (int i = 0; i < sizeof(program) / sizeof(*program); i++)
+        threaded_code[i] = program[i];
+
+    printf("%ld\n", threaded_run(threaded_code));
+    return 0;
+}
@@ -0,0 +1,136 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*
+ * Client for `lice --server SOCKET': reads a translation unit from stdin,
+ * or the file named, and writes the assembly to stdout like lice itself
+ * does, diagnostics are written to stderr. -I and -D are passed on with
+ * the directory the client runs in, so includes are found as if lice
+ * was run here.
+ */
+static int client_copy(int from, int to) {
+    char    chunk[4096];
+    ssize_t got;
+
+    while ((got = read(from, chunk, sizeof(chunk))) > 0) {
+        for (char *p = chunk; got > 0; ) {
+            ssize_t wrote = write(to, p, got);
+            if (wrote <= 0)
+                return -1;
+            p   += wrote;
+            got -= wrote;
+        }
+    }
+    return got;
+}
+
+static int client_write(int to, const char *data, size_t size) {
+    while (size) {
+        ssize_t wrote = write(to, data, size);
+        if (wrote <= 0)
+            return -1;
+        data += wrote;
+        size -= wrote;
+    }
+    return 0;
+}
+
+/*
+ * The request header, see compile_server_request in lice.c: an option
+ * per line and an empty line after them. Returns NULL when the
+ * arguments are not understood.
+ */
+static char *client_header(int argc, char **argv, const char **file, size_t *size) {
+    char *header    = NULL;
+    FILE *stream    = open_memstream(&header, size);
+    char *directory = getcwd(NULL, 0);
+    bool  usage     = !directory;
+
+    if (directory)
+        fprintf(stream, "C%s\n", directory);
+    free(directory);
+
+    for (int i = 2; i < argc && !usage; i++) {
+        const char *value = argv[i] + 2;
+        char        name  = argv[i][1];
+
+        if (strncmp(argv[i], "-I", 2) && strncmp(argv[i], "-D", 2)) {
+            usage = (*file != NULL);
+            *file = argv[i];
+            value = argv[i];
+            name  = 'F';
+        } else if (!*value) {
+            usage = (i + 1 == argc);
+            value = usage ? "" : argv[++i];
+        }
+        usage = usage || strchr(value, '\n');
+        fprintf(stream, "%c%s\n", name, value);
+    }
+    fprintf(stream, "\n");
+    fclose(stream);
+
+    if (usage) {
+        free(header);
+        return NULL;
+    }
+    return header;
+}
+
+int main(int argc, char **argv) {
+    struct sockaddr_un  address = { .sun_family = AF_UNIX };
+    int                 server;
+    int                 input   = STDIN_FILENO;
+    const char         *file    = NULL;
+    size_t              size;
+    char               *header  = (argc < 2) ? NULL : client_header(argc, argv, &file, &size);
+    char                status;
+
+    if (!header) {
+        fprintf(stderr, "usage: %s SOCKET [-I DIR] [-D NAME[=VALUE]] [input.c] > output.s\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (file && (input = open(file, O_RDONLY)) < 0) {
+        fprintf(stderr, "cannot open input `%s'\n", file);
+        return EXIT_FAILURE;
+    }
+
+    if (strlen(argv[1]) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "socket path `%s' is too long\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    strcpy(address.sun_path, argv[1]);
+
+    if ((server = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+    ||  connect(server, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        fprintf(stderr, "cannot connect to `%s'\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    if (client_write(server, header, size) < 0 || client_copy(input, server) < 0
+    ||  shutdown(server, SHUT_WR) < 0) {
+        fprintf(stderr, "cannot send request\n");
+        return EXIT_FAILURE;
+    }
+
+    if (read(server, &status, 1) != 1) {
+        fprintf(stderr, "no reply from `%s'\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    if (status == '0') {
+        client_copy(server, STDOUT_FILENO);
+        return EXIT_SUCCESS;
+    }
+
+    client_copy(server, STDERR_FILENO);
+    fprintf(stderr, "\n");
+    return EXIT_FAILURE;
+}
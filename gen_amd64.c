@@ -1,16 +1,30 @@
+#define _POSIX_C_SOURCE 200809L /* open_memstream */
 #include <stdarg.h>
+#include <limits.h>
+#include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
 #include "lice.h"
+#include "lexer.h"
+#include "profile.h"
 
 static const char *registers[] = {
     "rdi", "rsi", "rdx",
     "rcx", "r8",  "r9"
 };
 
+/* callee saved, for locals which don't escape: 64, 32, 16 and 8 bits */
+static const char *registers_saved[][4] = {
+    { "rbx", "ebx",  "bx",   "bl"   },
+    { "r12", "r12d", "r12w", "r12b" },
+    { "r13", "r13d", "r13w", "r13b" },
+    { "r14", "r14d", "r14w", "r14b" },
+    { "r15", "r15d", "r15w", "r15b" }
+};
+
 static void gen_expression(ast_t *);
-static void gen_declaration_initialization(list_t *, int);
+static void gen_declaration_initialization(list_t *, data_type_t *, int);
 
 #define gen_emit(...)        gen_emit_impl(__LINE__, "\t" __VA_ARGS__)
 #define gen_emit_inline(...) gen_emit_impl(__LINE__,      __VA_ARGS__)
@@ -19,19 +33,83 @@ static void gen_declaration_initialization(list_t *, int);
 #define gen_push_xmm(X)      gen_push_xmm_(X, __LINE__)
 #define gen_pop_xmm(X)       gen_pop_xmm_ (X, __LINE__)
 
-static int   gen_stack = 0;
+static COMPILE_LOCAL int   gen_stack = 0;
+static COMPILE_LOCAL int   gen_saved = 0;
+static COMPILE_LOCAL FILE *gen_output = NULL;
+
+bool gen_frame_statistics = false;
+
+bool gen_codegen_statistics = false;
+
+COMPILE_LOCAL gen_statistics_t gen_statistics;
+
+const char *gen_profile_generate = NULL;
+
+bool gen_debug = false;
+
+int gen_target = ARCH_LEVEL_V1;
+
+static COMPILE_LOCAL char *gen_label_break          = NULL;
+static COMPILE_LOCAL char *gen_label_continue       = NULL;
+static COMPILE_LOCAL char *gen_label_break_store    = NULL;
+static COMPILE_LOCAL char *gen_label_continue_store = NULL;
+static COMPILE_LOCAL char *gen_label_switch         = NULL;
+static COMPILE_LOCAL char *gen_label_entry          = NULL;
+static COMPILE_LOCAL char *gen_function_name        = NULL;
+
+/* the cases of the innermost switch, see <gen_switch> */
+static COMPILE_LOCAL list_t *gen_switch_cases = NULL;
+
+/* counters of the function being generated and its code moved out of line */
+static COMPILE_LOCAL int     gen_profile_counters = 0;
+static COMPILE_LOCAL FILE   *gen_cold             = NULL;
+static COMPILE_LOCAL char   *gen_cold_buffer      = NULL;
+static COMPILE_LOCAL size_t  gen_cold_size        = 0;
 
-static char *gen_label_break          = NULL;
-static char *gen_label_continue       = NULL;
-static char *gen_label_break_store    = NULL;
-static char *gen_label_continue_store = NULL;
-static char *gen_label_switch         = NULL;
-static char *gen_label_switch_store   = NULL;
+/* the source line the code being emitted is attributed to */
+static COMPILE_LOCAL int gen_location_file = 0;
+static COMPILE_LOCAL int gen_location_line = 0;
+
+void gen_init(FILE *output) {
+    gen_output = output;
+    memset(&gen_statistics, 0, sizeof(gen_statistics));
+}
+
+/* breaks an instruction down into what it is and what it touches */
+static void gen_statistics_count(const char *instruction) {
+    char   name[sizeof(gen_statistics.mnemonics[0].name)];
+    size_t length;
+
+    while (*instruction == '\t')
+        instruction++;
+    length = strcspn(instruction, " \t");
+    if (!length || length >= sizeof(name))
+        return;
+    memcpy(name, instruction, length);
+    name[length] = '\0';
+
+    if (strchr(instruction, '(') && strcmp(name, "lea"))
+        gen_statistics.memory++;
+    if (!strcmp(name, "call"))
+        gen_statistics.calls++;
+
+    int i;
+    for (i = 0; i < gen_statistics.mnemonic_count; i++)
+        if (!strcmp(gen_statistics.mnemonics[i].name, name))
+            break;
+    if (i == gen_statistics.mnemonic_count) {
+        if (i == GEN_MNEMONICS)
+            return;
+        strcpy(gen_statistics.mnemonics[i].name, name);
+        gen_statistics.mnemonic_count++;
+    }
+    gen_statistics.mnemonics[i].count++;
+}
 
 void gen_emit_impl(int line, const char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    int col = vprintf(fmt, args);
+    int col = vfprintf(gen_output, fmt, args);
     va_end(args);
 
     for (const char *p = fmt; *p; p++)
@@ -39,7 +117,20 @@ void gen_emit_impl(int line, const char *fmt, ...) {
           col += 8 - 1;
 
     col = (40 - col) > 0 ? (40 - col) : 2;
-    printf("%*c % 4d\n", col, '#', line);
+    fprintf(gen_output, "%*c % 4d\n", col, '#', line);
+
+    /* labels aren't indented and directives start with a dot */
+    if (fmt[0] != '\t' || fmt[1] == '.')
+        return;
+
+    gen_statistics.instructions++;
+    if (gen_codegen_statistics) {
+        char instruction[256];
+        va_start(args, fmt);
+        vsnprintf(instruction, sizeof(instruction), fmt, args);
+        va_end(args);
+        gen_statistics_count(instruction);
+    }
 }
 
 static void gen_jump_save(char *lbreak, char *lcontinue) {
@@ -57,20 +148,24 @@ static void gen_jump_restore(void) {
 static void gen_push_(const char *reg, int line) {
     gen_emit_impl(line, "\tpush %%%s", reg);
     gen_stack += 8;
+    gen_statistics.pushes++;
 }
 static void gen_pop_(const char *reg, int line) {
     gen_emit_impl(line, "\tpop %%%s", reg);
     gen_stack -= 8;
+    gen_statistics.pops++;
 }
 static void gen_push_xmm_(int r, int line) {
     gen_emit_impl(line, "\tsub $8, %%rsp");
     gen_emit_impl(line, "\tmovsd %%xmm%d, (%%rsp)", r);
     gen_stack += 8;
+    gen_statistics.pushes++;
 }
 static void gen_pop_xmm_(int r, int line) {
     gen_emit_impl(line, "\tmovsd (%%rsp), %%xmm%d", r);
     gen_emit_impl(line, "\tadd $8, %%rsp");
     gen_stack -= 8;
+    gen_statistics.pops++;
 }
 
 static const char *gen_register_integer(data_type_t *type, char r) {
@@ -150,6 +245,25 @@ static void gen_save_local(data_type_t *type, int offset) {
         gen_emit("mov %%%s, %d(%%rbp)", gen_register_integer(type, 'a'), offset);
 }
 
+static bool gen_promoted(ast_t *var) {
+    return var->type == AST_TYPE_VAR_LOCAL && var->variable.reg;
+}
+
+/* loaded zero extended, exactly like a load from the stack slot */
+static void gen_load_register(ast_t *var) {
+    const char **reg = registers_saved[var->variable.reg - 1];
+    switch (var->ctype->size) {
+        case 1:  gen_emit("movzbl %%%s, %%eax", reg[3]); break;
+        case 2:  gen_emit("movzwl %%%s, %%eax", reg[2]); break;
+        case 4:  gen_emit("mov %%%s, %%eax",    reg[1]); break;
+        default: gen_emit("mov %%%s, %%rax",    reg[0]); break;
+    }
+}
+
+static void gen_save_register(ast_t *var) {
+    gen_emit("mov %%rax, %%%s", registers_saved[var->variable.reg - 1][0]);
+}
+
 static void gen_assignment_dereference_intermediate(data_type_t *type, int offset) {
     gen_emit("mov (%%rsp), %%rcx");
 
@@ -169,7 +283,7 @@ static void gen_assignment_dereference(ast_t *var) {
 
 static void gen_ensure_lva(ast_t *ast) {
     if (ast->variable.init)
-        gen_declaration_initialization(ast->variable.init, ast->variable.off);
+        gen_declaration_initialization(ast->variable.init, ast->ctype, ast->variable.off);
     ast->variable.init = NULL;
 }
 
@@ -245,6 +359,10 @@ static void gen_assignment(ast_t *var) {
             gen_assignment_structure(var->structure, var->ctype, 0);
             break;
         case AST_TYPE_VAR_LOCAL:
+            if (gen_promoted(var)) {
+                gen_save_register(var);
+                break;
+            }
             gen_ensure_lva(var);
             gen_save_local(var->ctype, var->variable.off);
             break;
@@ -278,8 +396,217 @@ static void gen_comparision(char *operation, ast_t *ast) {
     gen_emit("movzb %%al, %%eax");
 }
 
+static bool gen_integer_constant(ast_t *ast, long *value) {
+    long left;
+    long right;
+
+    switch (ast->type) {
+        case AST_TYPE_LITERAL:
+            if (!ast_type_integer(ast->ctype))
+                return false;
+            *value = ast->integer;
+            return true;
+
+        case AST_TYPE_EXPRESSION_CAST:
+            if (!ast_type_integer(ast->ctype))
+                return false;
+            return gen_integer_constant(ast->unary.operand, value);
+
+        /* unary minus is parsed as (0 - operand) */
+        case '-':
+            if (!gen_integer_constant(ast->left, &left) || !gen_integer_constant(ast->right, &right))
+                return false;
+            *value = left - right;
+            return true;
+    }
+    return false;
+}
+
+/*
+ * Division and modulo operate in 32-bit registers unless one of the
+ * operands is wider than an int.
+ */
+static bool gen_binary_wide(ast_t *ast) {
+    return ast->left->ctype->size  > ARCH_TYPE_SIZE_INT
+        || ast->right->ctype->size > ARCH_TYPE_SIZE_INT;
+}
+
+/* unsigned when an operand as wide as the operation is unsigned */
+static bool gen_binary_unsigned(ast_t *ast) {
+    int size = gen_binary_wide(ast) ? ARCH_TYPE_SIZE_LONG : ARCH_TYPE_SIZE_INT;
+    return (ast->left->ctype->size  == size && !ast->left->ctype->sign)
+        || (ast->right->ctype->size == size && !ast->right->ctype->sign);
+}
+
+/* an int operand of a long division is converted by its own sign */
+static void gen_binary_widen(ast_t *ast, data_type_t *type) {
+    if (gen_binary_wide(ast) && type->size == ARCH_TYPE_SIZE_INT)
+        gen_emit("%s", type->sign ? "movslq %eax, %rax" : "mov %eax, %eax");
+}
+
+/*
+ * Calculates the magic multiplier and post shift for signed division
+ * by a constant of the given width in bits. The divisor must satisfy
+ * 2 <= |divisor|. See Hacker's Delight, 10-4 (figure 10-1).
+ */
+static void gen_division_magic(long divisor, int bits, long *multiplier, int *shift) {
+    unsigned long mask  = (bits == 64) ? ~0UL : (1UL << bits) - 1;
+    unsigned long two   = 1UL << (bits - 1);
+    unsigned long ad    = (divisor < 0) ? -(unsigned long)divisor : (unsigned long)divisor;
+    unsigned long t     = two + (((unsigned long)divisor & mask) >> (bits - 1));
+    unsigned long anc   = t - 1 - t % ad;
+    unsigned long q1    = two / anc;
+    unsigned long r1    = two - q1 * anc;
+    unsigned long q2    = two / ad;
+    unsigned long r2    = two - q2 * ad;
+    unsigned long delta;
+    int           p     = bits - 1;
+
+    do {
+        p++;
+        q1 = (q1 * 2) & mask;
+        r1 = (r1 * 2) & mask;
+        if (r1 >= anc) {
+            q1++;
+            r1 -= anc;
+        }
+        q2 = (q2 * 2) & mask;
+        r2 = (r2 * 2) & mask;
+        if (r2 >= ad) {
+            q2++;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+
+    unsigned long m = (q2 + 1) & mask;
+    if (divisor < 0)
+        m = -m & mask;
+
+    /* sign extend the multiplier from the width of the operation */
+    *multiplier = (bits == 64) ? (long)m : (long)(int)(unsigned int)m;
+    *shift      = p - bits;
+}
+
+/*
+ * Lowers division or modulo by a non-zero constant in %rax. The dividend
+ * is sign extended to 64 bits so the same shifts work for both widths,
+ * it's kept in %rcx for the remainder calculation.
+ */
+static void gen_division_constant(ast_t *ast, long divisor) {
+    bool          wide = gen_binary_wide(ast);
+    unsigned long ad   = (divisor < 0) ? -(unsigned long)divisor : (unsigned long)divisor;
+
+    gen_binary_widen(ast, ast->left->ctype);
+    if (!wide)
+        gen_emit("cltq");
+    gen_emit("mov %%rax, %%rcx");
+
+    if (ad == 1) {
+        if (divisor < 0)
+            gen_emit("neg %%rax");
+    } else if ((ad & (ad - 1)) == 0) {
+        int k = __builtin_ctzl(ad);
+
+        /* round towards zero by biasing negative dividends by 2^k-1 */
+        gen_emit("mov %%rax, %%rdx");
+        gen_emit("sar $63, %%rdx");
+        gen_emit("shr $%d, %%rdx", 64 - k);
+        gen_emit("add %%rdx, %%rax");
+        gen_emit("sar $%d, %%rax", k);
+        if (divisor < 0)
+            gen_emit("neg %%rax");
+    } else {
+        long multiplier;
+        int  shift;
+
+        if (wide) {
+            gen_division_magic(divisor, 64, &multiplier, &shift);
+            gen_emit("mov $%ld, %%rax", multiplier);
+            gen_emit("imul %%rcx");
+        } else {
+            gen_division_magic(divisor, 32, &multiplier, &shift);
+            gen_emit("imul $%ld, %%rax, %%rdx", multiplier);
+            gen_emit("sar $32, %%rdx");
+        }
+
+        if (divisor > 0 && multiplier < 0)
+            gen_emit("add %%rcx, %%rdx");
+        else if (divisor < 0 && multiplier > 0)
+            gen_emit("sub %%rcx, %%rdx");
+        if (shift)
+            gen_emit("sar $%d, %%rdx", shift);
+
+        /* add one when the quotient is negative */
+        gen_emit("mov %%rdx, %%rax");
+        gen_emit("shr $63, %%rdx");
+        gen_emit("add %%rdx, %%rax");
+    }
+
+    if (ast->type == '%') {
+        gen_emit("imul $%ld, %%rax", divisor);
+        gen_emit("sub %%rax, %%rcx");
+        gen_emit("mov %%rcx, %%rax");
+    }
+}
+
+/*
+ * Calculates the multiplier for unsigned division by a constant of the
+ * given width in bits which isn't a power of two, the quotient is
+ * (t + ((n - t) >> 1)) >> (log - 1) with t the high half of n times
+ * the multiplier. See Granlund and Montgomery, Division by Invariant
+ * Integers using Multiplication, figure 4.1.
+ */
+static unsigned long gen_division_magic_unsigned(unsigned long divisor, int bits, int *log) {
+    *log = 64 - __builtin_clzl(divisor - 1);
+    unsigned __int128 excess = ((unsigned __int128)1 << *log) - divisor;
+    return (unsigned long)((excess << bits) / divisor + 1);
+}
+
+/*
+ * Lowers unsigned division or modulo by a constant in %rax, between one
+ * and the largest int so the remainder can multiply it back.
+ */
+static void gen_division_constant_unsigned(ast_t *ast, long divisor) {
+    bool        wide = gen_binary_wide(ast);
+    const char *a    = wide ? "rax" : "eax";
+    const char *c    = wide ? "rcx" : "ecx";
+    const char *d    = wide ? "rdx" : "edx";
+
+    gen_binary_widen(ast, ast->left->ctype);
+
+    if ((divisor & (divisor - 1)) == 0) {
+        if (ast->type == '%')
+            gen_emit("and $%ld, %%%s", divisor - 1, a);
+        else if (divisor > 1)
+            gen_emit("shr $%d, %%%s", __builtin_ctzl(divisor), a);
+        return;
+    }
+
+    int           log;
+    unsigned long multiplier = gen_division_magic_unsigned(divisor, wide ? 64 : 32, &log);
+
+    gen_emit("mov %%%s, %%%s", a, c);
+    gen_emit("mov $%lu, %%%s", multiplier, d);
+    gen_emit("mul %%%s", d);
+    gen_emit("mov %%%s, %%%s", c, a);
+    gen_emit("sub %%%s, %%%s", d, a);
+    gen_emit("shr $1, %%%s", a);
+    gen_emit("add %%%s, %%%s", d, a);
+    if (log > 1)
+        gen_emit("shr $%d, %%%s", log - 1, a);
+
+    if (ast->type == '%') {
+        gen_emit("imul $%ld, %%%s", divisor, a);
+        gen_emit("sub %%%s, %%%s", a, c);
+        gen_emit("mov %%%s, %%%s", c, a);
+    }
+}
+
 static void gen_binary_arithmetic_integer(ast_t *ast) {
     char *op;
+    long  divisor;
+
     switch (ast->type) {
         case '+':             op = "add";  break;
         case '-':             op = "sub";  break;
@@ -295,19 +622,65 @@ static void gen_binary_arithmetic_integer(ast_t *ast) {
             break;
     }
 
+    if ((ast->type == '/' || ast->type == '%') && gen_integer_constant(ast->right, &divisor) && divisor) {
+        if (!gen_binary_unsigned(ast)) {
+            gen_expression(ast->left);
+            gen_cast_int(ast->left->ctype);
+            gen_division_constant(ast, divisor);
+            return;
+        }
+        if (divisor > 0 && divisor <= INT_MAX) {
+            gen_expression(ast->left);
+            gen_cast_int(ast->left->ctype);
+            gen_division_constant_unsigned(ast, divisor);
+            return;
+        }
+    }
+
     gen_expression(ast->left);
     gen_cast_int(ast->left->ctype);
+    if (ast->type == '/' || ast->type == '%')
+        gen_binary_widen(ast, ast->left->ctype);
     gen_push("rax");
     gen_expression(ast->right);
     gen_cast_int(ast->right->ctype);
+    if (ast->type == '/' || ast->type == '%')
+        gen_binary_widen(ast, ast->right->ctype);
+
+    /* the count can be in any register, so the value needn't move */
+    if ((ast->type == AST_TYPE_LSHIFT || ast->type == AST_TYPE_RSHIFT) && (gen_target & ARCH_FEATURE_BMI2)) {
+        gen_pop("rcx");
+        gen_emit("%s %%rax, %%rcx, %%rax", (ast->type == AST_TYPE_LSHIFT) ? "shlx" : "sarx");
+        return;
+    }
+
     gen_emit("mov %%rax, %%rcx");
     gen_pop("rax");
 
-    if (ast->type == '/' || ast->type == '%') {
-        gen_emit("cqto");
-        gen_emit("idiv %%rcx");
-        if (ast->type == '%')
-            gen_emit("mov %%edx, %%eax");
+    if ((ast->type == '/' || ast->type == '%') && gen_binary_unsigned(ast)) {
+        if (gen_binary_wide(ast)) {
+            gen_emit("xor %%edx, %%edx");
+            gen_emit("div %%rcx");
+            if (ast->type == '%')
+                gen_emit("mov %%rdx, %%rax");
+        } else {
+            gen_emit("xor %%edx, %%edx");
+            gen_emit("div %%ecx");
+            if (ast->type == '%')
+                gen_emit("mov %%edx, %%eax");
+        }
+    } else if (ast->type == '/' || ast->type == '%') {
+        if (gen_binary_wide(ast)) {
+            gen_emit("cqto");
+            gen_emit("idiv %%rcx");
+            if (ast->type == '%')
+                gen_emit("mov %%rdx, %%rax");
+        } else {
+            gen_emit("cltd");
+            gen_emit("idiv %%ecx");
+            if (ast->type == '%')
+                gen_emit("mov %%edx, %%eax");
+        }
     } else if (ast->type == AST_TYPE_LSHIFT || ast->type == AST_TYPE_RSHIFT) {
         gen_emit("%s %%cl, %%rax", op);
     } else {
@@ -315,6 +688,49 @@ static void gen_binary_arithmetic_integer(ast_t *ast) {
     }
 }
 
+static bool gen_fused_product(ast_t *ast) {
+    return ast->type == '*' && ast_type_floating(ast->ctype);
+}
+
+/*
+ * A product added to or subtracted from something is done with one
+ * rounding, like other compilers contract it. The product is left in
+ * %xmm1 and %xmm2, what it is added to or subtracted from in %xmm0.
+ */
+static bool gen_fused(ast_t *ast) {
+    ast_t      *product;
+    ast_t      *addend;
+    const char *op;
+
+    if (ast->type != '+' && ast->type != '-')
+        return false;
+
+    if (gen_fused_product(ast->left)) {
+        product = ast->left;
+        addend  = ast->right;
+        op      = (ast->type == '+') ? "vfmadd231sd" : "vfmsub231sd";
+    } else if (gen_fused_product(ast->right)) {
+        product = ast->right;
+        addend  = ast->left;
+        op      = (ast->type == '+') ? "vfmadd231sd" : "vfnmadd231sd";
+    } else {
+        return false;
+    }
+
+    gen_expression(product->left);
+    gen_cast_float(product->left->ctype);
+    gen_push_xmm(0);
+    gen_expression(product->right);
+    gen_cast_float(product->right->ctype);
+    gen_push_xmm(0);
+    gen_expression(addend);
+    gen_cast_float(addend->ctype);
+    gen_pop_xmm(2);
+    gen_pop_xmm(1);
+    gen_emit("%s %%xmm2, %%xmm1, %%xmm0", op);
+    return true;
+}
+
 static void gen_binary_arithmetic_floating(ast_t *ast) {
     char *op;
     switch (ast->type) {
@@ -327,11 +743,22 @@ static void gen_binary_arithmetic_floating(ast_t *ast) {
             break;
     }
 
+    if ((gen_target & ARCH_FEATURE_FMA) && gen_fused(ast))
+        return;
+
     gen_expression(ast->left);
     gen_cast_float(ast->left->ctype);
     gen_push_xmm(0);
     gen_expression(ast->right);
     gen_cast_float(ast->right->ctype);
+
+    /* with three operands the right needn't move out of the way */
+    if (gen_target & ARCH_FEATURE_AVX) {
+        gen_pop_xmm(1);
+        gen_emit("v%s %%xmm0, %%xmm1, %%xmm0", op);
+        return;
+    }
+
     gen_emit("movsd %%xmm0, %%xmm1");
     gen_pop_xmm(0);
     gen_emit("%s %%xmm1, %%xmm0", op);
@@ -378,6 +805,162 @@ static void gen_binary(ast_t *ast) {
         compile_error("Internal error");
 }
 
+/*
+ * Masks, remainders and shifts are typed int whatever their operands
+ * are, but are computed in the whole register. This is the width the
+ * value really has.
+ */
+static int gen_bits_width(ast_t *ast) {
+    switch (ast->type) {
+        case '&':
+            return MAX(gen_bits_width(ast->left), gen_bits_width(ast->right));
+        case '%':
+            return gen_binary_wide(ast) ? ARCH_TYPE_SIZE_LONG : ARCH_TYPE_SIZE_INT;
+        case '~':
+            return gen_bits_width(ast->unary.operand);
+        case AST_TYPE_LSHIFT:
+        case AST_TYPE_RSHIFT:
+            return gen_bits_width(ast->left);
+
+        /* temporaries are always a whole register */
+        case AST_TYPE_EXPRESSION_SAVE:
+        case AST_TYPE_EXPRESSION_RELOAD:
+            return gen_bits_width(ast->right);
+    }
+    return ast->ctype->size;
+}
+
+/*
+ * Bit builtins work at the width of the conversion the parser wraps
+ * their operand in. An int made a long is extended first since the
+ * upper half of the register isn't kept clear for it, one which was
+ * computed as a long already is not.
+ */
+static int gen_bits_operand(ast_t *operand) {
+    ast_t *value = (operand->type == AST_TYPE_EXPRESSION_CAST)
+                        ? operand->unary.operand
+                        : operand;
+
+    gen_expression(operand);
+    if (operand->ctype->size == ARCH_TYPE_SIZE_LONG && gen_bits_width(value) == ARCH_TYPE_SIZE_INT)
+        gen_emit("%s", value->ctype->sign ? "movslq %eax, %rax" : "mov %eax, %eax");
+    return operand->ctype->size;
+}
+
+/* adds up bits in pairs, nibbles and bytes, then the bytes with a multiply */
+static void gen_bits_popcount(int size) {
+    const char    *a    = (size == 8) ? "rax" : "eax";
+    const char    *c    = (size == 8) ? "rcx" : "ecx";
+    const char    *d    = (size == 8) ? "rdx" : "edx";
+    unsigned long  ones = (size == 8) ? ~0UL  : 0xFFFFFFFFUL;
+
+    gen_emit("mov %%%s, %%%s", a, c);
+    gen_emit("shr $1, %%%s", c);
+    gen_emit("mov $0x%lx, %%%s", ones / 3, d);
+    gen_emit("and %%%s, %%%s", d, c);
+    gen_emit("sub %%%s, %%%s", c, a);
+    gen_emit("mov $0x%lx, %%%s", ones / 5, d);
+    gen_emit("mov %%%s, %%%s", a, c);
+    gen_emit("shr $2, %%%s", a);
+    gen_emit("and %%%s, %%%s", d, c);
+    gen_emit("and %%%s, %%%s", d, a);
+    gen_emit("add %%%s, %%%s", c, a);
+    gen_emit("mov %%%s, %%%s", a, c);
+    gen_emit("shr $4, %%%s", c);
+    gen_emit("add %%%s, %%%s", c, a);
+    gen_emit("mov $0x%lx, %%%s", ones / 17, d);
+    gen_emit("and %%%s, %%%s", d, a);
+    gen_emit("mov $0x%lx, %%%s", ones / 255, d);
+    gen_emit("imul %%%s, %%%s", d, a);
+    gen_emit("shr $%d, %%%s", size * 8 - 8, a);
+}
+
+static void gen_bits(ast_t *ast) {
+    int         size = gen_bits_operand(ast->unary.operand);
+    const char *a    = (size == 8) ? "rax" : "eax";
+
+    switch (ast->type) {
+        case AST_TYPE_POPCOUNT:
+            if (gen_target & ARCH_FEATURE_POPCNT)
+                gen_emit("popcnt %%%s, %%%s", a, a);
+            else
+                gen_bits_popcount(size);
+            break;
+
+        /* bsr and bsf leave the result undefined for zero, as the builtins do */
+        case AST_TYPE_CLZ:
+            if (gen_target & ARCH_FEATURE_LZCNT) {
+                gen_emit("lzcnt %%%s, %%%s", a, a);
+                break;
+            }
+            gen_emit("bsr %%%s, %%%s", a, a);
+            gen_emit("xor $%d, %%%s", size * 8 - 1, a);
+            break;
+        case AST_TYPE_CTZ:
+            if (gen_target & ARCH_FEATURE_BMI1)
+                gen_emit("tzcnt %%%s, %%%s", a, a);
+            else
+                gen_emit("bsf %%%s, %%%s", a, a);
+            break;
+
+        case AST_TYPE_BSWAP:
+            if (size == 2) {
+                gen_emit("rol $8, %%ax");
+                gen_emit("movzwl %%ax, %%eax");
+            } else {
+                gen_emit("bswap %%%s", a);
+            }
+            break;
+    }
+}
+
+/* one side complemented is and-not, without the not */
+static bool gen_andn(ast_t *ast) {
+    if (ast->left->type == '~') {
+        gen_expression(ast->left->unary.operand);
+        gen_push("rax");
+        gen_expression(ast->right);
+        gen_pop("rcx");
+        gen_emit("andn %%rax, %%rcx, %%rax");
+        return true;
+    }
+    if (ast->right->type == '~') {
+        gen_expression(ast->left);
+        gen_push("rax");
+        gen_expression(ast->right->unary.operand);
+        gen_pop("rcx");
+        gen_emit("andn %%rcx, %%rax, %%rax");
+        return true;
+    }
+    return false;
+}
+
+static void gen_rotate(ast_t *ast) {
+    const char *op = (ast->type == AST_TYPE_ROTATE_LEFT) ? "rol" : "ror";
+    const char *a  = gen_register_integer(ast->ctype, 'a');
+    long        count;
+
+    gen_expression(ast->left);
+    if (gen_integer_constant(ast->right, &count)) {
+        gen_emit("%s $%ld, %%%s", op, count & (ast->ctype->size * 8 - 1), a);
+        return;
+    }
+    gen_push("rax");
+    gen_expression(ast->right);
+    gen_emit("mov %%rax, %%rcx");
+    gen_pop("rax");
+    gen_emit("%s %%cl, %%%s", op, a);
+}
+
+/* by locality, from none to keeping it in every level of cache */
+static void gen_prefetch(ast_t *ast) {
+    static const char *instructions[] = {
+        "prefetchnta", "prefetcht2", "prefetcht1", "prefetcht0"
+    };
+    gen_expression(ast->left);
+    gen_emit("%s (%%rax)", instructions[ast->right->integer]);
+}
+
 static void gen_literal_save(ast_t *ast, data_type_t *type, int offset) {
     switch (type->type) {
         case TYPE_CHAR:  gen_emit("movb $%d, %d(%%rbp)", ast->integer, offset); break;
@@ -393,82 +976,472 @@ static void gen_literal_save(ast_t *ast, data_type_t *type, int offset) {
             gen_pop("rax");
             break;
 
-        case TYPE_FLOAT:
+        /* exactly the width of the slot, neighbours may be packed against it */
+        case TYPE_FLOAT: {
+            float value = ast_type_floating(ast->ctype) ? ast->floating.value : ast->integer;
+            gen_emit("movl $%u, %d(%%rbp)", *(unsigned int*)&value, offset);
+            break;
+        }
+
         case TYPE_DOUBLE:
+        case TYPE_LDOUBLE: {
+            double value = ast_type_floating(ast->ctype) ? ast->floating.value : ast->integer;
             gen_push("rax");
-            gen_emit("movq $%uld, %%rax", *(long*)&ast->floating);
+            gen_emit("movq $%lu, %%rax", *(unsigned long*)&value);
             gen_emit("movq %%rax, %d(%%rbp)", offset);
             gen_pop("rax");
             break;
+        }
 
         default:
             compile_error("codegen internal error in %s", __func__);
     }
 }
 
-static void gen_declaration_initialization(list_t *init, int offset) {
+/*
+ * Aggregates are cleared and copied with sixteen byte moves through
+ * %xmm0, what is left over with the widest integer moves that fit.
+ * Past GEN_BLOCK_INLINE bytes the string instructions are used
+ * instead of growing the code any further.
+ */
+#define GEN_BLOCK_INLINE 128
+
+static void gen_block_tail(int i, int size, bool zero) {
+    static const struct {
+        int         size;
+        const char *suffix;
+        const char *reg;
+    } widths[] = {
+        { 8, "q", "rcx" },
+        { 4, "l", "ecx" },
+        { 2, "w", "cx"  },
+        { 1, "b", "cl"  }
+    };
+
+    for (int w = 0; w < sizeof(widths) / sizeof(*widths); w++) {
+        for (; i + widths[w].size <= size; i += widths[w].size) {
+            if (zero) {
+                gen_emit("mov%s $0, %d(%%rdi)", widths[w].suffix, i);
+            } else {
+                gen_emit("mov %d(%%rsi), %%%s", i, widths[w].reg);
+                gen_emit("mov %%%s, %d(%%rdi)", widths[w].reg, i);
+            }
+        }
+    }
+}
+
+/* clears size bytes at %rdi */
+static void gen_block_zero(int size) {
+    if (size > GEN_BLOCK_INLINE) {
+        gen_emit("xor %%eax, %%eax");
+        gen_emit("mov $%d, %%ecx", size);
+        gen_emit("rep stosb");
+        return;
+    }
+
+    int i = 0;
+    if (size >= 16)
+        gen_emit("xorps %%xmm0, %%xmm0");
+    for (; i + 16 <= size; i += 16)
+        gen_emit("movups %%xmm0, %d(%%rdi)", i);
+    gen_block_tail(i, size, true);
+}
+
+/* copies size bytes from %rsi to %rdi */
+static void gen_block_copy(int size) {
+    if (size > GEN_BLOCK_INLINE) {
+        gen_emit("mov $%d, %%ecx", size);
+        gen_emit("rep movsb");
+        return;
+    }
+
+    int i = 0;
+    for (; i + 16 <= size; i += 16) {
+        gen_emit("movups %d(%%rsi), %%xmm0", i);
+        gen_emit("movups %%xmm0, %d(%%rdi)", i);
+    }
+    gen_block_tail(i, size, false);
+}
+
+static void gen_address(ast_t *ast) {
+    switch (ast->type) {
+        case AST_TYPE_VAR_LOCAL:
+            gen_ensure_lva(ast);
+            gen_emit("lea %d(%%rbp), %%rax", ast->variable.off);
+            break;
+
+        case AST_TYPE_VAR_GLOBAL:
+            gen_emit("lea %s(%%rip), %%rax", ast->variable.label);
+            break;
+
+        case AST_TYPE_DEREFERENCE:
+            gen_expression(ast->unary.operand);
+            break;
+
+        case AST_TYPE_STRUCT:
+            gen_address(ast->structure);
+            if (ast->ctype->offset)
+                gen_emit("add $%d, %%rax", ast->ctype->offset);
+            break;
+
+        default:
+            compile_error("Internal error: gen_address");
+            break;
+    }
+}
+
+/* structure assignment, leaves the address of the destination in %rax */
+static void gen_assignment_copy(ast_t *to, ast_t *from) {
+    gen_address(from);
+    gen_push("rax");
+    gen_address(to);
+    gen_emit("mov %%rax, %%rdi");
+    gen_pop("rsi");
+    gen_block_copy(to->ctype->size);
+}
+
+static bool gen_literal_zero(ast_t *ast) {
+    if (ast->type != AST_TYPE_LITERAL)
+        return false;
+    if (ast_type_floating(ast->ctype))
+        return !*(unsigned long*)&ast->floating.value;
+    return !ast->integer;
+}
+
+/*
+ * When anything in an aggregate is zero initialized (including what the
+ * initializer leaves out) the whole object is cleared up front, which
+ * leaves only the non zero parts to be stored one at a time.
+ */
+static void gen_declaration_initialization(list_t *init, data_type_t *type, int offset) {
+    bool cleared = false;
+    if (type->type == TYPE_ARRAY || type->type == TYPE_STRUCTURE) {
+        for (list_iterator_t *it = list_iterator(init); !cleared && !list_iterator_end(it); )
+            cleared = gen_literal_zero(((ast_t*)list_iterator_next(it))->init.value);
+    }
+
+    if (cleared) {
+        gen_emit("lea %d(%%rbp), %%rdi", offset);
+        gen_block_zero(type->size);
+    }
+
     for (list_iterator_t *it = list_iterator(init); !list_iterator_end(it); ) {
         ast_t *node = list_iterator_next(it);
-        if (node->init.value->type == AST_TYPE_LITERAL)
+        if (cleared && gen_literal_zero(node->init.value))
+            continue;
+
+        if (node->init.type->type == TYPE_STRUCTURE) {
+            gen_address(node->init.value);
+            gen_emit("mov %%rax, %%rsi");
+            gen_emit("lea %d(%%rbp), %%rdi", node->init.offset + offset);
+            gen_block_copy(node->init.type->size);
+        } else if (node->init.value->type == AST_TYPE_LITERAL) {
             gen_literal_save(node->init.value, node->init.type, node->init.offset + offset);
-        else {
+        } else {
             gen_expression(node->init.value);
             gen_save_local(node->init.type, node->init.offset + offset);
         }
     }
 }
 
-static void gen_emit_prefix(ast_t *ast, const char *op) {
-    gen_expression(ast->unary.operand);
-    gen_emit("%s $1, %%rax", op);
-    gen_assignment(ast->unary.operand);
+static void gen_emit_prefix(ast_t *ast, const char *op) {
+    gen_expression(ast->unary.operand);
+    gen_emit("%s $1, %%rax", op);
+    gen_assignment(ast->unary.operand);
+}
+
+static void gen_emit_postfix(ast_t *ast, const char *op) {
+    gen_expression(ast->unary.operand);
+    gen_push("rax");
+    gen_emit("%s $1, %%rax", op);
+    gen_assignment(ast->unary.operand);
+    gen_pop("rax");
+}
+
+static list_t *gen_function_argument_types(ast_t *ast) {
+    list_t *list = list_create();
+    for (list_iterator_t *it = list_iterator(ast->function.call.args),
+                         *jt = list_iterator(ast->function.call.paramtypes); !list_iterator_end(it); ) {
+
+        ast_t       *value = list_iterator_next(it);
+        data_type_t *type  = list_iterator_next(jt);
+
+        list_push(list, type ? type : ast_result_type('=', value->ctype, ast_data_table[AST_DATA_INT]));
+    }
+    return list;
+}
+
+static void gen_je(const char *label) {
+    gen_emit("test %%rax, %%rax");
+    gen_emit("je %s", label);
+}
+
+static void gen_label(const char *label) {
+    gen_emit_inline("%s:", label);
+}
+
+static void gen_jmp(const char *label) {
+    gen_emit("jmp %s", label);
+}
+
+/*
+ * The callee saved registers are kept right below the frame pointer.
+ * Returns can be anywhere in a function, what follows one still has
+ * the frame, see <gen_leave_after>.
+ */
+static void gen_leave(void) {
+    gen_emit(".cfi_remember_state");
+    for (int i = 0; i < gen_saved; i++)
+        gen_emit("mov %d(%%rbp), %%%s", -8 * (i + 1), registers_saved[i][0]);
+    gen_emit("leave");
+    gen_emit(".cfi_def_cfa %%rsp, 8");
+}
+
+static void gen_leave_after(void) {
+    gen_emit(".cfi_restore_state");
+}
+
+static void gen_location(ast_t *ast) {
+    if (!gen_debug || !ast->line)
+        return;
+    if (ast->file == gen_location_file && ast->line == gen_location_line)
+        return;
+    gen_location_file = ast->file;
+    gen_location_line = ast->line;
+    gen_emit(".loc %d %d %d", ast->file, ast->line, ast->column);
+}
+
+/*
+ * Counters are numbered in the order code is generated. That is the
+ * same whether a profile is being generated or used, so long as the
+ * source is, which is how the counts find their way back.
+ */
+static int gen_profile_reserve(int count) {
+    int first = gen_profile_counters;
+    gen_profile_counters += count;
+    return first;
+}
+
+static void gen_profile_increment(int index) {
+    if (gen_profile_generate)
+        gen_emit("incq .L%s.profile+%d(%%rip)", gen_function_name, index * 8);
+}
+
+static long gen_profile_count(int index) {
+    return profile_count(gen_function_name, index);
+}
+
+/*
+ * Conditionals have a counter for being reached and one for taking
+ * the then branch. With a profile, or failing that a hint, the likelier
+ * branch is the one falling through, and a then branch which never
+ * runs is moved out of line to the end of the function.
+ */
+static void gen_if(ast_t *ast) {
+    int   profile  = gen_profile_reserve(2);
+    long  executed = gen_profile_count(profile);
+    long  then     = gen_profile_count(profile + 1);
+    bool  counted  = executed >= 0 && then >= 0;
+    bool  unlikely = counted ? (executed > 0 && then == 0) : ast->ifstmt.expect < 0;
+    bool  inverted = counted ? (executed - then > then)    : ast->ifstmt.expect < 0;
+    char *ne;
+    char *end;
+
+    gen_profile_increment(profile);
+    gen_expression(ast->ifstmt.cond);
+
+    if (ast->ifstmt.last && inverted) {
+        ne  = ast_label();
+        end = ast_label();
+        gen_emit("test %%rax, %%rax");
+        gen_emit("jne %s", ne);
+        gen_expression(ast->ifstmt.last);
+        gen_jmp(end);
+        gen_label(ne);
+        gen_expression(ast->ifstmt.then);
+        gen_label(end);
+        return;
+    }
+
+    if (unlikely && !ast->ifstmt.last && ast->type == AST_TYPE_STATEMENT_IF && gen_output != gen_cold) {
+        ne  = ast_label();
+        end = ast_label();
+        gen_emit("test %%rax, %%rax");
+        gen_emit("jne %s", ne);
+        gen_label(end);
+
+        if (!gen_cold && !(gen_cold = open_memstream(&gen_cold_buffer, &gen_cold_size)))
+            compile_error("cannot allocate output buffer");
+        FILE *output = gen_output;
+        int   file   = gen_location_file;
+        int   line   = gen_location_line;
+        gen_output        = gen_cold;
+        gen_location_line = 0;
+        gen_label(ne);
+        gen_expression(ast->ifstmt.then);
+        gen_jmp(end);
+        gen_output        = output;
+        gen_location_file = file;
+        gen_location_line = line;
+        return;
+    }
+
+    ne = ast_label();
+    gen_je(ne);
+    gen_profile_increment(profile + 1);
+    gen_expression(ast->ifstmt.then);
+    if (ast->ifstmt.last) {
+        end = ast_label();
+        gen_jmp(end);
+        gen_label(ne);
+        gen_expression(ast->ifstmt.last);
+        gen_label(end);
+    } else {
+        gen_label(ne);
+    }
+}
+
+/*
+ * The cases of a switch are found ahead of its body, each with a
+ * counter of its own. Without a profile the cases test for their
+ * value where they are, one after another; with one the switch tests
+ * for the most frequent values first and the cases are only labels.
+ */
+typedef struct {
+    ast_t *node;
+    char  *label;
+    int    profile;
+    long   count;
+} gen_case_t;
+
+static void gen_switch_collect(ast_t *ast, list_t *cases) {
+    if (!ast)
+        return;
+
+    switch (ast->type) {
+        case AST_TYPE_STATEMENT_COMPOUND:
+            for (list_iterator_t *it = list_iterator(ast->compound); !list_iterator_end(it); )
+                gen_switch_collect(list_iterator_next(it), cases);
+            break;
+
+        case AST_TYPE_STATEMENT_IF:
+            gen_switch_collect(ast->ifstmt.then, cases);
+            gen_switch_collect(ast->ifstmt.last, cases);
+            break;
+
+        case AST_TYPE_STATEMENT_FOR:
+        case AST_TYPE_STATEMENT_WHILE:
+        case AST_TYPE_STATEMENT_DO:
+            gen_switch_collect(ast->forstmt.body, cases);
+            break;
+
+        /* a nested switch has cases of its own */
+        case AST_TYPE_STATEMENT_CASE:
+        case AST_TYPE_STATEMENT_DEFAULT: {
+            gen_case_t *entry = memory_allocate(sizeof(gen_case_t));
+            entry->node  = ast;
+            entry->label = NULL;
+            list_push(cases, entry);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+static gen_case_t *gen_switch_case(ast_t *ast) {
+    if (gen_switch_cases) {
+        for (list_iterator_t *it = list_iterator(gen_switch_cases); !list_iterator_end(it); ) {
+            gen_case_t *entry = list_iterator_next(it);
+            if (entry->node == ast)
+                return entry;
+        }
+    }
+    compile_error("ICE");
+    return NULL;
 }
 
-static void gen_emit_postfix(ast_t *ast, const char *op) {
-    gen_expression(ast->unary.operand);
-    gen_push("rax");
-    gen_emit("%s $1, %%rax", op);
-    gen_assignment(ast->unary.operand);
-    gen_pop("rax");
+static int gen_switch_compare(const void *a, const void *b) {
+    const gen_case_t *x = *(gen_case_t *const *)a;
+    const gen_case_t *y = *(gen_case_t *const *)b;
+    if (x->count != y->count)
+        return (x->count < y->count) - (x->count > y->count);
+    return x->profile - y->profile;
 }
 
-static list_t *gen_function_argument_types(ast_t *ast) {
-    list_t *list = list_create();
-    for (list_iterator_t *it = list_iterator(ast->function.call.args),
-                         *jt = list_iterator(ast->function.call.paramtypes); !list_iterator_end(it); ) {
+static void gen_switch_dispatch(list_t *cases) {
+    int          count   = list_length(cases);
+    gen_case_t **sorted   = memory_allocate(sizeof(gen_case_t*) * count);
+    gen_case_t  *fallback = NULL;
+    int          index    = 0;
 
-        ast_t       *value = list_iterator_next(it);
-        data_type_t *type  = list_iterator_next(jt);
-
-        list_push(list, type ? type : ast_result_type('=', value->ctype, ast_data_table[AST_DATA_INT]));
+    for (list_iterator_t *it = list_iterator(cases); !list_iterator_end(it); ) {
+        gen_case_t *entry = list_iterator_next(it);
+        entry->label = ast_label();
+        sorted[index++] = entry;
     }
-    return list;
-}
+    qsort(sorted, count, sizeof(gen_case_t*), &gen_switch_compare);
 
-static void gen_je(const char *label) {
-    gen_emit("test %%rax, %%rax");
-    gen_emit("je %s", label);
+    for (index = 0; index < count; index++) {
+        if (sorted[index]->node->type == AST_TYPE_STATEMENT_DEFAULT) {
+            fallback = sorted[index];
+            continue;
+        }
+        gen_emit("cmp $%d, %%eax", sorted[index]->node->casevalue);
+        gen_emit("je %s", sorted[index]->label);
+    }
+    gen_jmp(fallback ? fallback->label : gen_label_break);
 }
 
-static void gen_label(const char *label) {
-    gen_emit("%s:", label);
-}
+static void gen_switch(ast_t *ast) {
+    list_t *cases        = list_create();
+    list_t *cases_store  = gen_switch_cases;
+    char   *switch_store = gen_label_switch;
+    char   *break_store  = gen_label_break;
+
+    gen_switch_collect(ast->switchstmt.body, cases);
+
+    int  profile  = gen_profile_reserve(list_length(cases));
+    bool dispatch = list_length(cases) > 0;
+    for (list_iterator_t *it = list_iterator(cases); !list_iterator_end(it); ) {
+        gen_case_t *entry = list_iterator_next(it);
+        entry->profile = profile++;
+        entry->count   = gen_profile_count(entry->profile);
+        if (entry->count < 0)
+            dispatch = false;
+    }
 
-static void gen_jmp(const char *label) {
-    gen_emit("jmp %s", label);
+    gen_expression(ast->switchstmt.expr);
+    gen_switch_cases = cases;
+    gen_label_switch = ast_label();
+    gen_label_break  = ast_label();
+    if (dispatch)
+        gen_switch_dispatch(cases);
+    else
+        gen_jmp(gen_label_switch);
+    gen_expression(ast->switchstmt.body);
+    gen_label(gen_label_switch);
+    gen_label(gen_label_break);
+    gen_switch_cases = cases_store;
+    gen_label_switch = switch_store;
+    gen_label_break  = break_store;
 }
 
 static void gen_expression(ast_t *ast) {
     if (!ast) return;
+    gen_location(ast);
 
     char *begin;
-    char *ne;
     char *end;
     char *step;
     char *skip;
 
+    gen_case_t *entry;
+
     int regi = 0, backi;
     int regx = 0, backx;
+    int tail;
 
     list_t *argtypes;
 
@@ -504,6 +1477,10 @@ static void gen_expression(ast_t *ast) {
             break;
 
         case AST_TYPE_VAR_LOCAL:
+            if (gen_promoted(ast)) {
+                gen_load_register(ast);
+                break;
+            }
             gen_ensure_lva(ast);
             gen_load_local(ast->ctype, "rbp", ast->variable.off);
             break;
@@ -512,6 +1489,7 @@ static void gen_expression(ast_t *ast) {
             break;
 
         case AST_TYPE_CALL:
+            tail     = gen_stack;
             argtypes = gen_function_argument_types(ast);
             for (list_iterator_t *it = list_iterator(argtypes); !list_iterator_end(it); ) {
                 if (ast_type_floating(list_iterator_next(it))) {
@@ -546,6 +1524,25 @@ static void gen_expression(ast_t *ast) {
                 }
             }
             gen_emit("mov $%d, %%eax", regx);
+
+            /*
+             * A tail call leaves through the callee, the registers saved
+             * above are never restored. Calling ourselves just starts
+             * over in the same frame.
+             */
+            if (ast->function.call.tail) {
+                if (!strcmp(ast->function.name, gen_function_name)) {
+                    gen_emit("lea %d(%%rbp), %%rsp", -8 * gen_saved);
+                    gen_jmp(gen_label_entry);
+                } else {
+                    gen_leave();
+                    gen_emit("jmp %s", ast->function.name);
+                    gen_leave_after();
+                }
+                gen_stack = tail;
+                break;
+            }
+
             if (gen_stack % 16)
                 gen_emit("sub $8, %%rsp");
 
@@ -568,29 +1565,18 @@ static void gen_expression(ast_t *ast) {
             break;
 
         case AST_TYPE_DECLARATION:
-            if (ast->decl.init)
-                gen_declaration_initialization(ast->decl.init, ast->decl.var->variable.off);
+            if (ast->decl.init && gen_promoted(ast->decl.var)) {
+                for (list_iterator_t *it = list_iterator(ast->decl.init); !list_iterator_end(it); ) {
+                    gen_expression(((ast_t*)list_iterator_next(it))->init.value);
+                    gen_save_register(ast->decl.var);
+                }
+            } else if (ast->decl.init) {
+                gen_declaration_initialization(ast->decl.init, ast->decl.var->ctype, ast->decl.var->variable.off);
+            }
             break;
 
         case AST_TYPE_ADDRESS:
-            switch (ast->unary.operand->type) {
-                case AST_TYPE_VAR_LOCAL:
-                    gen_ensure_lva(ast->unary.operand);
-                    gen_emit("lea %d(%%rbp), %%rax", ast->unary.operand->variable.off);
-                    break;
-
-                case AST_TYPE_VAR_GLOBAL:
-                    gen_emit("lea %s(%%rip), %%rax", ast->unary.operand->variable.label);
-                    break;
-
-                case AST_TYPE_DEREFERENCE:
-                    gen_expression(ast->unary.operand);
-                    break;
-
-                default:
-                    compile_error("Internal error");
-                    break;
-            }
+            gen_address(ast->unary.operand);
             break;
 
         case AST_TYPE_DEREFERENCE:
@@ -601,19 +1587,7 @@ static void gen_expression(ast_t *ast) {
 
         case AST_TYPE_STATEMENT_IF:
         case AST_TYPE_EXPRESSION_TERNARY:
-            gen_expression(ast->ifstmt.cond);
-            ne = ast_label();
-            gen_je(ne);
-            gen_expression(ast->ifstmt.then);
-            if (ast->ifstmt.last) {
-                end = ast_label();
-                gen_jmp(end);
-                gen_label(ne);
-                gen_expression(ast->ifstmt.last);
-                gen_label(end);
-            } else {
-                gen_label(ne);
-            }
+            gen_if(ast);
             break;
 
         case AST_TYPE_STATEMENT_FOR:
@@ -630,6 +1604,7 @@ static void gen_expression(ast_t *ast) {
             }
             gen_expression(ast->forstmt.body);
             gen_label(step);
+            gen_location(ast);
             if (ast->forstmt.step)
                 gen_expression(ast->forstmt.step);
             gen_jmp(begin);
@@ -645,6 +1620,7 @@ static void gen_expression(ast_t *ast) {
             gen_expression(ast->forstmt.cond);
             gen_je(end);
             gen_expression(ast->forstmt.body);
+            gen_location(ast);
             gen_jmp(begin);
             gen_label(end);
             gen_jump_restore();
@@ -656,6 +1632,7 @@ static void gen_expression(ast_t *ast) {
             gen_jump_save(end, begin);
             gen_label(begin);
             gen_expression(ast->forstmt.body);
+            gen_location(ast);
             gen_expression(ast->forstmt.cond);
             gen_je(end);
             gen_jmp(begin);
@@ -676,35 +1653,43 @@ static void gen_expression(ast_t *ast) {
             break;
 
         case AST_TYPE_STATEMENT_SWITCH:
-            gen_label_switch_store = gen_label_switch;
-            gen_label_break_store  = gen_label_break;
-            gen_expression(ast->switchstmt.expr);
-            gen_label_switch = ast_label();
-            gen_label_break  = ast_label();
-            gen_jmp(gen_label_switch);
-            gen_expression(ast->switchstmt.body);
-            gen_label(gen_label_switch);
-            gen_label(gen_label_break);
-            gen_label_switch = gen_label_switch_store;
-            gen_label_break  = gen_label_break_store;
+            gen_switch(ast);
             break;
 
         case AST_TYPE_STATEMENT_CASE:
             if (!gen_label_switch)
                 compile_error("ICE");
+            if ((entry = gen_switch_case(ast))->label) {
+                gen_label(entry->label);
+                break;
+            }
             skip = ast_label();
             gen_jmp(skip);
             gen_label(gen_label_switch);
             gen_emit("cmp $%d, %%eax", ast->casevalue);
             gen_label_switch = ast_label();
             gen_emit("jne %s", gen_label_switch);
+            gen_profile_increment(entry->profile);
             gen_label(skip);
             break;
 
         case AST_TYPE_STATEMENT_DEFAULT:
             if (!gen_label_switch)
                 compile_error("ICE");
-            gen_label(gen_label_switch);
+            if ((entry = gen_switch_case(ast))->label) {
+                gen_label(entry->label);
+                break;
+            }
+            /* falling through into the default doesn't count as taking it */
+            if (gen_profile_generate) {
+                skip = ast_label();
+                gen_jmp(skip);
+                gen_label(gen_label_switch);
+                gen_profile_increment(entry->profile);
+                gen_label(skip);
+            } else {
+                gen_label(gen_label_switch);
+            }
             gen_label_switch = ast_label();
             break;
 
@@ -712,18 +1697,32 @@ static void gen_expression(ast_t *ast) {
             gen_jmp(ast->gotostmt.where);
             break;
 
+        case AST_TYPE_STATEMENT_GOTO_COMPUTED:
+            gen_expression(ast->unary.operand);
+            gen_emit("jmp *%%rax");
+            break;
+
+        case AST_TYPE_LABEL_ADDRESS:
+            gen_emit("lea %s(%%rip), %%rax", ast->gotostmt.where);
+            break;
+
         case AST_TYPE_STATEMENT_LABEL:
             if (ast->gotostmt.where)
                 gen_label(ast->gotostmt.where);
             break;
 
         case AST_TYPE_STATEMENT_RETURN:
+            if (ast->returnstmt && ast->returnstmt->type == AST_TYPE_CALL && ast->returnstmt->function.call.tail) {
+                gen_expression(ast->returnstmt);
+                break;
+            }
             if (ast->returnstmt) {
                 gen_expression(ast->returnstmt);
                 gen_save(ast->ctype, ast->returnstmt->ctype);
             }
-            gen_emit("leave");
+            gen_leave();
             gen_emit("ret");
+            gen_leave_after();
             break;
 
         case AST_TYPE_STATEMENT_COMPOUND:
@@ -771,6 +1770,8 @@ static void gen_expression(ast_t *ast) {
             break;
 
         case '&':
+            if ((gen_target & ARCH_FEATURE_BMI1) && gen_andn(ast))
+                break;
         case '|':
             gen_expression(ast->left);
             gen_push("rax");
@@ -784,6 +1785,22 @@ static void gen_expression(ast_t *ast) {
             gen_emit("not %%rax");
             break;
 
+        case AST_TYPE_POPCOUNT:
+        case AST_TYPE_CLZ:
+        case AST_TYPE_CTZ:
+        case AST_TYPE_BSWAP:
+            gen_bits(ast);
+            break;
+
+        case AST_TYPE_ROTATE_LEFT:
+        case AST_TYPE_ROTATE_RIGHT:
+            gen_rotate(ast);
+            break;
+
+        case AST_TYPE_PREFETCH:
+            gen_prefetch(ast);
+            break;
+
         case AST_TYPE_POST_INCREMENT: gen_emit_postfix(ast, "add"); break;
         case AST_TYPE_POST_DECREMENT: gen_emit_postfix(ast, "sub"); break;
         case AST_TYPE_PRE_INCREMENT:  gen_emit_prefix (ast, "add"); break;
@@ -795,99 +1812,188 @@ static void gen_expression(ast_t *ast) {
             break;
 
         case '=':
+            if (ast->ctype->type == TYPE_STRUCTURE) {
+                gen_assignment_copy(ast->left, ast->right);
+                break;
+            }
             gen_expression(ast->right);
             gen_load(ast->ctype, ast->right->ctype);
             gen_assignment(ast->left);
             break;
 
+        /* temporaries keep the full register so a reload is exact */
+        case AST_TYPE_EXPRESSION_SAVE:
+            gen_expression(ast->right);
+            if (gen_promoted(ast->left))
+                gen_save_register(ast->left);
+            else if (ast_type_floating(ast->ctype))
+                gen_emit("movsd %%xmm0, %d(%%rbp)", ast->left->variable.off);
+            else
+                gen_emit("mov %%rax, %d(%%rbp)", ast->left->variable.off);
+            break;
+
+        case AST_TYPE_EXPRESSION_RELOAD:
+            if (gen_promoted(ast->left))
+                gen_load_register(ast->left);
+            else if (ast_type_floating(ast->ctype))
+                gen_emit("movsd %d(%%rbp), %%xmm0", ast->left->variable.off);
+            else
+                gen_emit("mov %d(%%rbp), %%rax", ast->left->variable.off);
+            break;
+
         default:
             gen_binary(ast);
     }
 }
 
+/*
+ * A relocation in initialized data: the address of label is stored
+ * at offset, the rest of the data is known bytes.
+ */
+typedef struct {
+    int   offset;
+    char *label;
+} gen_relocation_t;
+
+typedef struct {
+    char   *data;        /* the bytes of the object                        */
+    char   *width;       /* width of the scalar initialized at each offset */
+    list_t *relocations; /* gen_relocation_t, in the order they were found */
+} gen_data_t;
+
 int parse_evaluate(ast_t *ast);
-static void gen_data_initialization_intermediate(table_t *labels, char *data, table_t *literal, list_t *init, int offset) {
+static double gen_data_floating(ast_t *ast) {
+    return ast_type_floating(ast->ctype) ? ast->floating.value : parse_evaluate(ast);
+}
+
+static void gen_data_initialization_intermediate(gen_data_t *object, table_t *literal, list_t *init, int offset) {
     for (list_iterator_t *it = list_iterator(init); !list_iterator_end(it); ) {
         ast_t *node = list_iterator_next(it);
+        int    at   = node->init.offset + offset;
 
         if (node->init.value->type                == AST_TYPE_ADDRESS
         &&  node->init.value->unary.operand->type == AST_TYPE_VAR_LOCAL
         &&  node->init.value->unary.operand->variable.init) {
 
-            char     *label  = ast_label();
-            string_t *string = string_create();
+            gen_relocation_t *relocation = memory_allocate(sizeof(gen_relocation_t));
+            relocation->offset = at;
+            relocation->label  = ast_label();
 
-            string_catf(string, "%d", node->init.offset + offset);
-
-            table_insert(literal, label, node->init.value->unary.operand);
-            table_insert(labels,  string_buffer(string), label);
+            table_insert(literal, relocation->label, node->init.value->unary.operand);
+            list_push(object->relocations, relocation);
             continue;
         }
 
         if (node->init.value->type == AST_TYPE_VAR_LOCAL && node->init.value->variable.init) {
-            gen_data_initialization_intermediate(labels, data, literal, node->init.value->variable.init, node->init.offset + offset);
+            gen_data_initialization_intermediate(object, literal, node->init.value->variable.init, at);
             continue;
         }
 
+        char *data = object->data + at;
         switch (node->init.type->type) {
-            case TYPE_FLOAT:
-                *(float*)(data + node->init.offset + offset) = node->init.value->floating.value;
-                break;
-
-            case TYPE_DOUBLE:
-                *(double*)(data + node->init.offset + offset) = node->init.value->floating.value;
-                break;
-
-            case TYPE_CHAR:
-                *(char*)(data + node->init.offset + offset) = parse_evaluate(node->init.value);
-                break;
+            case TYPE_FLOAT:   *(float*)    data = gen_data_floating(node->init.value);  break;
+            case TYPE_DOUBLE:  *(double*)   data = gen_data_floating(node->init.value);  break;
+            case TYPE_CHAR:    *(char*)     data = parse_evaluate(node->init.value);     break;
+            case TYPE_SHORT:   *(short*)    data = parse_evaluate(node->init.value);     break;
+            case TYPE_INT:     *(int*)      data = parse_evaluate(node->init.value);     break;
+            case TYPE_LONG:    *(long*)     data = parse_evaluate(node->init.value);     break;
+            case TYPE_LLONG:   *(long long*)data = parse_evaluate(node->init.value);     break;
+            case TYPE_POINTER: *(long*)     data = parse_evaluate(node->init.value);     break;
 
-            case TYPE_SHORT:
-                *(short*)(data + node->init.offset + offset) = parse_evaluate(node->init.value);
-                break;
-
-            case TYPE_INT:
-                *(int*)(data + node->init.offset + offset) = parse_evaluate(node->init.value);
-                break;
-
-            case TYPE_LONG:
-                *(long*)(data + node->init.offset + offset) = parse_evaluate(node->init.value);
-                break;
+            default:
+                continue;
+        }
+        object->width[at] = node->init.type->size;
+    }
+}
 
-            case TYPE_LLONG:
-                *(long long*)(data + node->init.offset + offset) = parse_evaluate(node->init.value);
-                break;
+static int gen_data_relocation_compare(const void *a, const void *b) {
+    return (*(gen_relocation_t**)a)->offset - (*(gen_relocation_t**)b)->offset;
+}
 
-            case TYPE_POINTER:
-                *(long *)(data + node->init.offset + offset) = parse_evaluate(node->init.value);
+static bool gen_data_zero(const char *data, int size) {
+    for (int i = 0; i < size; i++)
+        if (data[i])
+            return false;
+    return true;
+}
 
-            default:
-                break;
-        }
+static void gen_data_ascii(const char *data, int size) {
+    string_t *string = string_create();
+    for (int i = 0; i < size; i++) {
+        unsigned char c = data[i];
+        if (c == '\"' || c == '\\')
+            string_catf(string, "\\%c", c);
+        else if (c >= ' ' && c < 0x7F)
+            string_cat(string, c);
+        else
+            string_catf(string, "\\%03o", c);
     }
+    gen_emit(".ascii \"%s\"", string_buffer(string));
 }
 
+/*
+ * Emits the object in runs rather than a directive per word: spans of
+ * zero bytes become a single .zero, byte data (character arrays) a
+ * single .ascii, and everything else the directive matching the width
+ * it was initialized with. Relocations are visited in offset order
+ * alongside the data.
+ */
 static void gen_data_initialization(table_t *table, list_t *list, int size) {
-    char *data = memory_allocate(size);
-    memset(data, 0, size);
+    gen_data_t object = {
+        .data        = memory_allocate(size),
+        .width       = memory_allocate(size),
+        .relocations = list_create()
+    };
+    memset(object.data,  0, size);
+    memset(object.width, 0, size);
+
+    gen_data_initialization_intermediate(&object, table, list, 0);
+
+    int                count       = list_length(object.relocations);
+    gen_relocation_t **relocations = memory_allocate(sizeof(gen_relocation_t*) * (count + 1));
+    int                next        = 0;
+
+    for (list_iterator_t *it = list_iterator(object.relocations); !list_iterator_end(it); )
+        relocations[next++] = list_iterator_next(it);
+    qsort(relocations, count, sizeof(gen_relocation_t*), &gen_data_relocation_compare);
+
+    next = 0;
+    for (int i = 0; i < size; ) {
+        int limit = (next < count) ? relocations[next]->offset : size;
+        if (i == limit) {
+            gen_emit(".quad %s", relocations[next++]->label);
+            i += 8;
+            continue;
+        }
 
-    table_t *labels = table_create(NULL);
-    gen_data_initialization_intermediate(labels, data, table, list, 0);
+        /* zero scalars and padding */
+        int j = i;
+        while (j < limit) {
+            int width = object.width[j] ? object.width[j] : 1;
+            if (j + width > limit || !gen_data_zero(object.data + j, width))
+                break;
+            j += width;
+        }
+        if (j != i) {
+            gen_emit(".zero %d", j - i);
+            i = j;
+            continue;
+        }
 
-    int i = 0;
-    for (; i <= size - 4; i += 4) {
-        string_t *string = string_create();
-        string_catf(string, "%d", i);
-        char *label = table_find(labels, string_buffer(string));
-        if (label) {
-            gen_emit(".quad %s", label);
-            i += 4;
-        } else {
-            gen_emit(".long %d", data[i]);
+        switch (object.width[i]) {
+            case 2: gen_emit(".short %d", *(short*)(object.data + i)); i += 2; continue;
+            case 4: gen_emit(".long %d",  *(int*)  (object.data + i)); i += 4; continue;
+            case 8: gen_emit(".quad %ld", *(long*) (object.data + i)); i += 8; continue;
         }
+
+        /* byte data runs until padding, a wide scalar or a long zero span */
+        for (j = i + 1; j < limit && object.width[j] == 1; j++)
+            if (j + 8 <= limit && gen_data_zero(object.data + j, 8))
+                break;
+        gen_data_ascii(object.data + i, j - i);
+        i = j;
     }
-    for (; i < size; i++)
-        gen_emit(".byte %d", data[i]);
     gen_emit(".align 8");
 }
 
@@ -911,9 +2017,13 @@ static void gen_data_literal(char *label, ast_t *ast) {
 static void gen_data(ast_t *ast) {
     table_t *table = table_create(NULL);
 
+    /* may follow a function in the translation unit */
+    gen_emit_inline(".data");
     if (!ast->decl.var->ctype->isstatic)
         gen_emit_inline(".global %s", ast->decl.var->variable.name);
 
+    gen_emit(".type %s, @object", ast->decl.var->variable.name);
+    gen_emit(".size %s, %d", ast->decl.var->variable.name, ast->decl.var->ctype->size);
     gen_emit_inline("%s:", ast->decl.var->variable.name);
     gen_data_initialization(table, ast->decl.init, ast->decl.var->ctype->size);
 
@@ -937,26 +2047,101 @@ static void gen_global(ast_t *var) {
     }
 }
 
-void gen_data_section(void) {
-    gen_emit(".data");
+/*
+ * Orders strings by their reversal so that every string sorts right
+ * before the strings it is a suffix of.
+ */
+static int gen_data_suffix_compare(const void *a, const void *b) {
+    const char *x = (*(ast_t**)a)->string.data;
+    const char *y = (*(ast_t**)b)->string.data;
+    int         i = strlen(x);
+    int         j = strlen(y);
+
+    while (i && j) {
+        unsigned char c = x[--i];
+        unsigned char d = y[--j];
+        if (c != d)
+            return c - d;
+    }
+    return i - j;
+}
+
+static bool gen_data_suffix(const char *suffix, const char *string) {
+    size_t length = strlen(string);
+    size_t part   = strlen(suffix);
+    return part <= length && !strcmp(string + length - part, suffix);
+}
+
+/*
+ * Identical strings share one label, and a string which is the tail
+ * of another is emitted as an alias into the longer one. Either way
+ * a string keeps the label named after its contents. The sections
+ * are mergeable so the linker can fold literals across objects too.
+ */
+static void gen_data_strings(void) {
+    hashtable_t *pool   = hashtable_create();
+    ast_t      **unique = memory_allocate(sizeof(ast_t*) * (list_length(ast_strings) + 1));
+    int          count  = 0;
 
     for (list_iterator_t *it = list_iterator(ast_strings); !list_iterator_end(it); ) {
         ast_t *ast = list_iterator_next(it);
+        if (hashtable_find(pool, ast->string.data))
+            continue;
+        hashtable_insert(pool, ast->string.data, ast);
+        unique[count++] = ast;
+    }
+
+    if (!count)
+        return;
+
+    qsort(unique, count, sizeof(ast_t*), &gen_data_suffix_compare);
+    gen_emit_inline(".section .rodata.str1.1,\"aMS\",@progbits,1");
+
+    ast_t *owner = NULL;
+    for (int i = count - 1; i >= 0; i--) {
+        ast_t *ast = unique[i];
+        if (owner && gen_data_suffix(ast->string.data, owner->string.data)) {
+            gen_emit_inline(".set %s, %s+%d", ast->string.label, owner->string.label,
+                (int)(strlen(owner->string.data) - strlen(ast->string.data)));
+            continue;
+        }
+        owner = ast;
         gen_emit_inline("%s: ", ast->string.label);
         gen_emit(".string \"%s\"", string_quote(ast->string.data));
     }
+}
+
+/* named by the bit pattern so that 0.0 and -0.0 stay distinct */
+static void gen_data_floats(void) {
+    hashtable_t *pool    = hashtable_create();
+    bool         section = false;
 
     for (list_iterator_t *it = list_iterator(ast_floats); !list_iterator_end(it); ) {
-        ast_t *ast   = list_iterator_next(it);
-        char  *label = ast_label();
+        ast_t    *ast    = list_iterator_next(it);
+        string_t *string = string_create();
+
+        string_catf(string, ".LF%016lx", *(unsigned long*)&ast->floating.value);
+        if ((ast->floating.label = hashtable_find(pool, string_buffer(string))))
+            continue;
 
-        ast->floating.label = label;
-        gen_emit_inline("%s:", label);
+        if (!section)
+            gen_emit_inline(".section .rodata.cst8,\"aM\",@progbits,8");
+        section = true;
+
+        ast->floating.label = string_buffer(string);
+        hashtable_insert(pool, string_buffer(string), ast->floating.label);
+        gen_emit(".align 8");
+        gen_emit_inline("%s:", ast->floating.label);
         gen_emit(".long %d", ((int*)&ast->floating.value)[0]);
         gen_emit(".long %d", ((int*)&ast->floating.value)[1]);
     }
 }
 
+void gen_data_section(void) {
+    gen_data_strings();
+    gen_data_floats();
+}
+
 static int gen_alignment(int n, int align) {
     int remainder = n % align;
     return (remainder == 0)
@@ -964,17 +2149,184 @@ static int gen_alignment(int n, int align) {
                 : n - remainder + align;
 }
 
+static bool gen_promotable(ast_t *var) {
+    data_type_t *type = var->ctype;
+    return !var->variable.escapes
+        && (ast_type_integer(type) || type->type == TYPE_POINTER)
+        && var->variable.uses > 2;
+}
+
+/*
+ * The most used of the locals and parameters which don't escape are
+ * given the callee saved registers.
+ */
+static void gen_function_registers(ast_t *ast) {
+    list_t *candidates = list_create();
+
+    for (list_iterator_t *it = list_iterator(ast->function.params); !list_iterator_end(it); )
+        list_push(candidates, list_iterator_next(it));
+    for (list_iterator_t *it = list_iterator(ast->function.locals); !list_iterator_end(it); )
+        list_push(candidates, list_iterator_next(it));
+
+    for (list_iterator_t *it = list_iterator(candidates); !list_iterator_end(it); )
+        ((ast_t*)list_iterator_next(it))->variable.reg = 0;
+
+    for (gen_saved = 0; gen_saved < sizeof(registers_saved) / sizeof(registers_saved[0]); gen_saved++) {
+        ast_t *best = NULL;
+        for (list_iterator_t *it = list_iterator(candidates); !list_iterator_end(it); ) {
+            ast_t *var = list_iterator_next(it);
+            if (!var->variable.reg && gen_promotable(var) && (!best || var->variable.uses > best->variable.uses))
+                best = var;
+        }
+        if (!best)
+            break;
+        best->variable.reg = gen_saved + 1;
+    }
+}
+
+static int gen_frame_alignment(data_type_t *type) {
+    if (type->type == TYPE_ARRAY)
+        return gen_frame_alignment(type->pointer);
+
+    if (type->type == TYPE_STRUCTURE) {
+        int align = 1;
+        for (list_iterator_t *it = list_iterator(table_values(type->fields)); !list_iterator_end(it); ) {
+            int field = gen_frame_alignment(list_iterator_next(it));
+            if (field > align)
+                align = field;
+        }
+        return align;
+    }
+
+    return (type->size >= 8) ? 8 : (type->size > 0) ? type->size : 1;
+}
+
+/*
+ * Packs the variables below depth bytes under the frame pointer, each
+ * at its natural alignment. The most strictly aligned go first so the
+ * smaller ones fill in behind them without padding. Returns the new
+ * depth.
+ */
+static int gen_frame_place(list_t *vars, int depth) {
+    for (int align = 8; align; align /= 2) {
+        for (list_iterator_t *it = list_iterator(vars); !list_iterator_end(it); ) {
+            ast_t *var = list_iterator_next(it);
+            if (gen_frame_alignment(var->ctype) != align)
+                continue;
+            depth = gen_alignment(depth + var->ctype->size, align);
+            var->variable.off = -depth;
+        }
+    }
+    return depth;
+}
+
+static int gen_frame_scope(ast_t *ast, int depth);
+
+/*
+ * A block's own declarations are placed first, then every nested
+ * block is laid out from where they end. Nested blocks are never
+ * live at the same time, so they all share the same space and the
+ * block needs only as much as the deepest one.
+ */
+static int gen_frame_block(list_t *statements, int depth) {
+    list_t *vars = list_create();
+    for (list_iterator_t *it = list_iterator(statements); !list_iterator_end(it); ) {
+        ast_t *statement = list_iterator_next(it);
+        if (!statement || statement->type != AST_TYPE_DECLARATION)
+            continue;
+        if (statement->decl.var->type == AST_TYPE_VAR_LOCAL && !gen_promoted(statement->decl.var))
+            list_push(vars, statement->decl.var);
+    }
+
+    depth = gen_frame_place(vars, depth);
+
+    int extent = depth;
+    for (list_iterator_t *it = list_iterator(statements); !list_iterator_end(it); ) {
+        int nested = gen_frame_scope(list_iterator_next(it), depth);
+        if (nested > extent)
+            extent = nested;
+    }
+    return extent;
+}
+
+static int gen_frame_scope(ast_t *ast, int depth) {
+    if (!ast)
+        return depth;
+
+    switch (ast->type) {
+        case AST_TYPE_STATEMENT_COMPOUND:
+            return gen_frame_block(ast->compound, depth);
+
+        case AST_TYPE_STATEMENT_IF: {
+            int then = gen_frame_scope(ast->ifstmt.then, depth);
+            int last = gen_frame_scope(ast->ifstmt.last, depth);
+            return (then > last) ? then : last;
+        }
+
+        /* the declaration in the first clause of a for is scoped to it */
+        case AST_TYPE_STATEMENT_FOR:
+        case AST_TYPE_STATEMENT_WHILE:
+        case AST_TYPE_STATEMENT_DO: {
+            list_t *statements = list_create();
+            list_push(statements, ast->forstmt.init);
+            list_push(statements, ast->forstmt.body);
+            return gen_frame_block(statements, depth);
+        }
+
+        case AST_TYPE_STATEMENT_SWITCH:
+            return gen_frame_scope(ast->switchstmt.body, depth);
+
+        default:
+            return depth;
+    }
+}
+
+/* where the callee saved registers are, relative to the frame */
+static void gen_function_saved(void) {
+    for (int i = 0; i < gen_saved; i++)
+        gen_emit(".cfi_offset %%%s, %d", registers_saved[i][0], -16 - 8 * (i + 1));
+}
+
 static void gen_function_prologue(ast_t *ast) {
     if (list_length(ast->function.params) > sizeof(registers)/sizeof(registers[0]))
         compile_error("Too many params for function");
 
-    gen_emit_inline(".text");
-    gen_emit_inline(".global %s", ast->function.name);
+    /*
+     * Cold functions, and those the profile never saw run, are kept
+     * away from the rest. Hot ones are kept together.
+     */
+    if (ast->function.attributes & ATTRIBUTE_COLD || profile_count(ast->function.name, 0) == 0)
+        gen_emit_inline(".section .text.unlikely,\"ax\",@progbits");
+    else if (ast->function.attributes & ATTRIBUTE_HOT)
+        gen_emit_inline(".section .text.hot,\"ax\",@progbits");
+    else
+        gen_emit_inline(".text");
+    if (!ast->ctype->isstatic)
+        gen_emit_inline(".global %s", ast->function.name);
+    gen_emit(".type %s, @function", ast->function.name);
     gen_emit_inline("%s:", ast->function.name);
+    gen_emit(".cfi_startproc");
+    gen_location_file = 0;
+    gen_location_line = 0;
+    gen_location(ast);
     gen_push("rbp");
+    gen_emit(".cfi_def_cfa_offset 16");
+    gen_emit(".cfi_offset %%rbp, -16");
     gen_emit("mov %%rsp, %%rbp");
+    gen_emit(".cfi_def_cfa_register %%rbp");
+
+    gen_function_registers(ast);
+    for (int i = 0; i < gen_saved; i++)
+        gen_push(registers_saved[i][0]);
+    gen_function_saved();
 
-    int offset = 0;
+    gen_function_name    = ast->function.name;
+    gen_profile_counters = 0;
+    gen_profile_increment(gen_profile_reserve(1));
+    gen_label_entry      = ast_label();
+    gen_label(gen_label_entry);
+
+    int offset = -8 * gen_saved;
     int regi   = 0;
     int regx   = 0;
 
@@ -985,6 +2337,9 @@ static void gen_function_prologue(ast_t *ast) {
             gen_push_xmm(regx++);
         } else if (value->ctype->type == TYPE_DOUBLE|| value->ctype->type == TYPE_LDOUBLE) {
             gen_push_xmm(regx++);
+        } else if (gen_promoted(value)) {
+            gen_emit("mov %%%s, %%%s", registers[regi++], registers_saved[value->variable.reg - 1][0]);
+            continue;
         } else {
             gen_push(registers[regi++]);
         }
@@ -992,35 +2347,229 @@ static void gen_function_prologue(ast_t *ast) {
         value->variable.off = offset;
     }
 
-    int localdata = 0;
+    /*
+     * Locals declared in a block get laid out by the walk over the body,
+     * whatever is left (temporaries, compound literals) lives for the
+     * whole function and goes below everything else.
+     */
+    list_t *remaining = list_create();
+    int     naive     = 0;
     for (list_iterator_t *it = list_iterator(ast->function.locals); !list_iterator_end(it); ) {
         ast_t *value = list_iterator_next(it);
-        offset -= gen_alignment(value->ctype->size, 8);
-        value->variable.off = offset;
-        localdata += offset;
+        if (gen_promoted(value))
+            continue;
+        value->variable.off = 0;
+        naive += gen_alignment(value->ctype->size, 8);
     }
 
+    int depth = gen_frame_scope(ast->function.body, -offset);
+    for (list_iterator_t *it = list_iterator(ast->function.locals); !list_iterator_end(it); ) {
+        ast_t *value = list_iterator_next(it);
+        if (!gen_promoted(value) && !value->variable.off)
+            list_push(remaining, value);
+    }
+    depth = gen_frame_place(remaining, depth);
+
+    /* keep the frame a multiple of sixteen so calls need no padding */
+    int localdata = gen_alignment(gen_stack + depth + offset, 16) - gen_stack;
+    if (gen_frame_statistics)
+        fprintf(stderr, "%-32s %6d bytes, %6d without slot sharing\n",
+            ast->function.name,
+            gen_stack + localdata - 8,
+            gen_alignment(gen_stack + naive, 16) - 8
+        );
     if (localdata)
-        gen_emit("sub $%d, %%rsp", -localdata);
-    gen_stack += -(offset - 8);
+        gen_emit("sub $%d, %%rsp", localdata);
+    gen_stack += localdata;
 }
 
 static void gen_function_epilogue(void) {
-    gen_emit("leave");
+    gen_leave();
     gen_emit("ret");
+    gen_leave_after();
+    gen_emit(".cfi_endproc");
+    gen_emit(".size %s, .-%s", gen_function_name, gen_function_name);
+}
+
+/*
+ * What the profile says never runs, after everything else. It is a
+ * function of its own as far as tools are concerned, one which runs
+ * in the frame of the function it came out of.
+ */
+static void gen_function_cold(void) {
+    if (!gen_cold)
+        return;
+    fclose(gen_cold);
+    gen_emit_inline(".section .text.unlikely,\"ax\",@progbits");
+    gen_emit(".type %s.cold, @function", gen_function_name);
+    gen_emit_inline("%s.cold:", gen_function_name);
+    gen_emit(".cfi_startproc");
+    gen_emit(".cfi_def_cfa %%rbp, 16");
+    gen_emit(".cfi_offset %%rbp, -16");
+    gen_function_saved();
+    fwrite(gen_cold_buffer, 1, gen_cold_size, gen_output);
+    gen_emit(".cfi_endproc");
+    gen_emit(".size %s.cold, .-%s.cold", gen_function_name, gen_function_name);
+    free(gen_cold_buffer);
+    gen_cold        = NULL;
+    gen_cold_buffer = NULL;
+    gen_cold_size   = 0;
+}
+
+/*
+ * The counters of a function are named after it, <gen_profile_section>
+ * finds them by name.
+ */
+static void gen_function_counters(void) {
+    if (!gen_profile_generate)
+        return;
+    gen_emit_inline(".bss");
+    gen_emit(".align 8");
+    gen_emit_inline(".L%s.profile:", gen_function_name);
+    gen_emit(".zero %d", gen_profile_counters * 8);
+    gen_emit(".set .L%s.profile_count, %d", gen_function_name, gen_profile_counters);
+    gen_emit_inline(".section .rodata");
+    gen_emit_inline(".L%s.profile_name:", gen_function_name);
+    gen_emit(".string \"%s\"", gen_function_name);
 }
 
 void gen_function(ast_t *ast) {
-    gen_stack = 0;
+    /* the return address */
+    gen_stack = 8;
     if (ast->type == AST_TYPE_FUNCTION) {
         gen_function_prologue(ast);
+        int frame = gen_stack;
         gen_expression(ast->function.body);
         gen_function_epilogue();
+        gen_function_cold();
+        gen_function_counters();
+        if (gen_stack != frame)
+            fprintf(gen_output, "## stack is misaligned by %d (bytes)\n", gen_stack - frame);
     } else if (ast->type == AST_TYPE_DECLARATION) {
         gen_global(ast);
     } else {
         compile_error("ICE");
     }
-    if (gen_stack > 8)
-        printf("## stack is misaligned by %d (bytes)\n", gen_stack);
+}
+
+/*
+ * Every unit with counters writes them out when the program exits,
+ * one line of function, counter and count each. The units of a
+ * program all append to the same file, as does every run of it.
+ */
+void gen_profile_section(list_t *toplevel) {
+    gen_emit_inline(".section .rodata");
+    gen_emit_inline(".Lprofile.path:");
+    gen_emit(".string \"%s\"", gen_profile_generate);
+    gen_emit_inline(".Lprofile.mode:");
+    gen_emit(".string \"a\"");
+    gen_emit_inline(".Lprofile.format:");
+    gen_emit(".string \"%%s %%ld %%ld\\n\"");
+
+    gen_emit_inline(".data");
+    gen_emit(".align 8");
+    gen_emit_inline(".Lprofile.functions:");
+    for (list_iterator_t *it = list_iterator(toplevel); !list_iterator_end(it); ) {
+        ast_t *ast = list_iterator_next(it);
+        if (ast->type != AST_TYPE_FUNCTION)
+            continue;
+        gen_emit(".quad .L%s.profile_name", ast->function.name);
+        gen_emit(".quad .L%s.profile", ast->function.name);
+        gen_emit(".quad .L%s.profile_count", ast->function.name);
+    }
+    gen_emit(".quad 0");
+
+    /* rbx walks the functions, r12 is the file and r13 the counter */
+    gen_emit_inline(".text");
+    gen_emit_inline(".Lprofile.write:");
+    gen_emit("push %%rbx");
+    gen_emit("push %%r12");
+    gen_emit("push %%r13");
+    gen_emit("lea .Lprofile.path(%%rip), %%rdi");
+    gen_emit("lea .Lprofile.mode(%%rip), %%rsi");
+    gen_emit("call fopen");
+    gen_emit("test %%rax, %%rax");
+    gen_emit("je .Lprofile.done");
+    gen_emit("mov %%rax, %%r12");
+    gen_emit("lea .Lprofile.functions(%%rip), %%rbx");
+    gen_emit_inline(".Lprofile.function:");
+    gen_emit("cmpq $0, (%%rbx)");
+    gen_emit("je .Lprofile.close");
+    gen_emit("xor %%r13, %%r13");
+    gen_emit_inline(".Lprofile.counter:");
+    gen_emit("cmp 16(%%rbx), %%r13");
+    gen_emit("jge .Lprofile.next");
+    gen_emit("mov %%r12, %%rdi");
+    gen_emit("lea .Lprofile.format(%%rip), %%rsi");
+    gen_emit("mov (%%rbx), %%rdx");
+    gen_emit("mov %%r13, %%rcx");
+    gen_emit("mov 8(%%rbx), %%r8");
+    gen_emit("mov (%%r8,%%r13,8), %%r8");
+    gen_emit("xor %%eax, %%eax");
+    gen_emit("call fprintf");
+    gen_emit("inc %%r13");
+    gen_emit("jmp .Lprofile.counter");
+    gen_emit_inline(".Lprofile.next:");
+    gen_emit("add $24, %%rbx");
+    gen_emit("jmp .Lprofile.function");
+    gen_emit_inline(".Lprofile.close:");
+    gen_emit("mov %%r12, %%rdi");
+    gen_emit("call fclose");
+    gen_emit_inline(".Lprofile.done:");
+    gen_emit("pop %%r13");
+    gen_emit("pop %%r12");
+    gen_emit("pop %%rbx");
+    gen_emit("ret");
+
+    gen_emit_inline(".section .fini_array,\"aw\"");
+    gen_emit(".align 8");
+    gen_emit(".quad .Lprofile.write");
+}
+
+/* -march, by the names other compilers know the levels by */
+static const struct {
+    const char *name;
+    int         features;
+} gen_targets[] = {
+    { "x86-64",    ARCH_LEVEL_V1 },
+    { "x86-64-v2", ARCH_LEVEL_V2 },
+    { "x86-64-v3", ARCH_LEVEL_V3 }
+};
+
+/* so code can tell what it is compiled for, as with other compilers */
+static const struct {
+    int         feature;
+    const char *macro;
+} gen_target_macros[] = {
+    { ARCH_FEATURE_SSE42,  "__SSE3__"    },
+    { ARCH_FEATURE_SSE42,  "__SSSE3__"   },
+    { ARCH_FEATURE_SSE42,  "__SSE4_1__"  },
+    { ARCH_FEATURE_SSE42,  "__SSE4_2__"  },
+    { ARCH_FEATURE_POPCNT, "__POPCNT__"  },
+    { ARCH_FEATURE_AVX,    "__AVX__"     },
+    { ARCH_FEATURE_AVX,    "__AVX2__"    },
+    { ARCH_FEATURE_FMA,    "__FMA__"     },
+    { ARCH_FEATURE_LZCNT,  "__LZCNT__"   },
+    { ARCH_FEATURE_BMI1,   "__BMI__"     },
+    { ARCH_FEATURE_BMI2,   "__BMI2__"    }
+};
+
+bool gen_target_select(const char *name) {
+    for (size_t i = 0; i < sizeof(gen_targets) / sizeof(*gen_targets); i++) {
+        if (strcmp(name, gen_targets[i].name))
+            continue;
+        gen_target = gen_targets[i].features;
+        for (size_t j = 0; j < sizeof(gen_target_macros) / sizeof(*gen_target_macros); j++)
+            if (gen_target & gen_target_macros[j].feature)
+                lexer_predefine(gen_target_macros[j].macro);
+        return true;
+    }
+    return false;
+}
+
+/* the numbers the line table refers to files by */
+void gen_debug_section(list_t *files) {
+    int number = 1;
+    for (list_iterator_t *it = list_iterator(files); !list_iterator_end(it); )
+        gen_emit(".file %d \"%s\"", number++, (char*)list_iterator_next(it));
 }
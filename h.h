@@ -0,0 +1,4 @@
+#ifndef H_H
+#define H_H
+int from_header = 3;
+#endif
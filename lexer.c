@@ -1,13 +1,96 @@
+#define _XOPEN_SOURCE 700 /* fmemopen, realpath */
 #include <stdlib.h>
+#include <limits.h>
 #include <ctype.h>
 #include <stdio.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "lexer.h"
 #include "util.h"
 #include "lice.h"
+#include "snapshot.h"
 
-static list_t *lexer_buffer = &SENTINEL_LIST;
+static COMPILE_LOCAL list_t *lexer_buffer    = &SENTINEL_LIST;
+static COMPILE_LOCAL FILE   *lexer_input     = NULL;
+static COMPILE_LOCAL list_t *lexer_record    = NULL;
+
+/* what the scanner passed over before the token it is scanning */
+static COMPILE_LOCAL bool    lexer_begin     = true;
+static COMPILE_LOCAL bool    lexer_space     = false;
+
+/* the end of the line ends a directive and is a token of its own there */
+static COMPILE_LOCAL bool    lexer_directive = false;
+
+/*
+ * Where the scanner is in the file on top of the include stack, and
+ * where the token it is scanning starts. The column the line before
+ * ended on is kept so a newline can be put back.
+ */
+static COMPILE_LOCAL int     lexer_position_file   = 0;
+static COMPILE_LOCAL int     lexer_position_line   = 1;
+static COMPILE_LOCAL int     lexer_position_column = 1;
+static COMPILE_LOCAL int     lexer_position_last   = 1;
+static COMPILE_LOCAL int     lexer_token_line      = 1;
+static COMPILE_LOCAL int     lexer_token_column    = 1;
+
+COMPILE_LOCAL lexer_statistics_t lexer_statistics;
+bool                             lexer_timed = false;
+
+static int lexer_getc(void) {
+    int c = getc(lexer_input);
+    if (c == '\n') {
+        lexer_position_last   = lexer_position_column;
+        lexer_position_column = 1;
+        lexer_position_line++;
+    } else if (c != EOF) {
+        lexer_position_column++;
+    }
+    return c;
+}
+
+static void lexer_ungetc(int c) {
+    if (c == EOF)
+        return;
+    ungetc(c, lexer_input);
+    if (c == '\n') {
+        lexer_position_column = lexer_position_last;
+        lexer_position_line--;
+    } else {
+        lexer_position_column--;
+    }
+}
+
+void lexer_capture(list_t *tokens) {
+    lexer_record = tokens;
+}
+
+unsigned long lexer_hash(unsigned long hash, list_t *tokens) {
+    for (list_iterator_t *it = list_iterator(tokens); !list_iterator_end(it); ) {
+        lexer_token_t *token = list_iterator_next(it);
+        hash = hash_bytes(hash, &token->type, sizeof(token->type));
+        switch (token->type) {
+            case LEXER_TOKEN_IDENTIFIER:
+            case LEXER_TOKEN_STRING:
+            case LEXER_TOKEN_NUMBER:
+                /* with the terminator so that tokens can't run together */
+                hash = hash_bytes(hash, token->string, strlen(token->string) + 1);
+                break;
+            case LEXER_TOKEN_PUNCT:
+                hash = hash_bytes(hash, &token->punct, sizeof(token->punct));
+                break;
+            case LEXER_TOKEN_CHAR:
+                hash = hash_bytes(hash, &token->character, sizeof(token->character));
+                break;
+            default:
+                break;
+        }
+    }
+    return hash;
+}
 
 static lexer_token_t *lexer_token_copy(lexer_token_t *token) {
     return memcpy(malloc(sizeof(lexer_token_t)), token, sizeof(lexer_token_t));
@@ -44,9 +127,12 @@ static lexer_token_t *lexer_char(char value) {
     });
 }
 
+/* the end of the line is left for lexer_skip since it may end a directive */
 static void lexer_skip_comment_line(void) {
     for (;;) {
-        int c = getc(stdin);
+        int c = lexer_getc();
+        if (c == '\n')
+            lexer_ungetc(c);
         if (c == '\n' || c == EOF)
             return;
     }
@@ -59,7 +145,11 @@ static void lexer_skip_comment_block(void) {
     } state = comment_outside;
 
     for (;;) {
-        int c = getc(stdin);
+        int c = lexer_getc();
+        if (c == EOF)
+            compile_error("unterminated comment");
+        if (c == '\n' && !lexer_directive)
+            lexer_begin = true;
         if (c == '*')
             state = comment_astrick;
         else if (state == comment_astrick && c == '/')
@@ -71,10 +161,25 @@ static void lexer_skip_comment_block(void) {
 
 static int lexer_skip(void) {
     int c;
-    while ((c = getc(stdin)) != EOF) {
-        if (isspace(c) || c == '\n' || c == '\r')
+    while ((c = lexer_getc()) != EOF) {
+        if (c == '\\') {
+            /* a line continued on the next one */
+            if ((c = lexer_getc()) != '\n')
+                compile_error("stray `\\' in program");
+            lexer_space = true;
+            continue;
+        }
+        if (c == '\n' && lexer_directive) {
+            lexer_ungetc(c);
+            return c;
+        }
+        if (c == '\n')
+            lexer_begin = true;
+        if (isspace(c)) {
+            lexer_space = true;
             continue;
-        ungetc(c, stdin);
+        }
+        lexer_ungetc(c);
         return c;
     }
     return EOF;
@@ -84,9 +189,9 @@ static lexer_token_t *lexer_read_number(int c) {
     string_t *string = string_create();
     string_cat(string, c);
     for (;;) {
-        int p = getc(stdin);
+        int p = lexer_getc();
         if (!isdigit(p) && !isalpha(p) && p != '.') {
-            ungetc(p, stdin);
+            lexer_ungetc(p);
             return lexer_number(string_buffer(string));
         }
         string_cat(string, p);
@@ -104,29 +209,29 @@ static bool lexer_read_character_octal_brace(int c, int *r) {
 
 static int lexer_read_character_octal(int c) {
     int r = c - '0';
-    if (lexer_read_character_octal_brace((c = getc(stdin)), &r)) {
-        if (!lexer_read_character_octal_brace((c = getc(stdin)), &r))
-            ungetc(c, stdin);
+    if (lexer_read_character_octal_brace((c = lexer_getc()), &r)) {
+        if (!lexer_read_character_octal_brace((c = lexer_getc()), &r))
+            lexer_ungetc(c);
     } else
-        ungetc(c, stdin);
+        lexer_ungetc(c);
     return r;
 }
 
 static int lexer_read_character_hexadecimal(void) {
-    int c = getc(stdin);
+    int c = lexer_getc();
     int r = 0;
 
     if (!isxdigit(c))
         compile_error("malformatted hexadecimal character");
 
-    for (;; c = getc(stdin)) {
+    for (;; c = lexer_getc()) {
         switch (c) {
             case '0' ... '9': r = (r << 4) | (c - '0');      continue;
             case 'a' ... 'f': r = (r << 4) | (c - 'a' + 10); continue;
             case 'A' ... 'F': r = (r << 4) | (c - 'f' + 10); continue;
 
             default:
-                ungetc(c, stdin);
+                lexer_ungetc(c);
                 return r;
         }
     }
@@ -134,7 +239,7 @@ static int lexer_read_character_hexadecimal(void) {
 }
 
 static int lexer_read_character_escaped(void) {
-    int c = getc(stdin);
+    int c = lexer_getc();
 
     switch (c) {
         case '\'':        return '\'';
@@ -160,10 +265,10 @@ static int lexer_read_character_escaped(void) {
 }
 
 static lexer_token_t *lexer_read_character(void) {
-    int c = getc(stdin);
+    int c = lexer_getc();
     int r = (c == '\\') ? lexer_read_character_escaped() : c;
 
-    if (getc(stdin) != '\'')
+    if (lexer_getc() != '\'')
         compile_error("unterminated character");
 
     return lexer_char((char)r);
@@ -172,7 +277,7 @@ static lexer_token_t *lexer_read_character(void) {
 static lexer_token_t *lexer_read_string(void) {
     string_t *string = string_create();
     for (;;) {
-        int c = getc(stdin);
+        int c = lexer_getc();
         if (c == EOF)
             compile_error("Expected termination for string literal");
 
@@ -190,11 +295,11 @@ static lexer_token_t *lexer_read_identifier(int c1) {
     string_cat(string, (char)c1);
 
     for (;;) {
-        int c2 = getc(stdin);
+        int c2 = lexer_getc();
         if (isalnum(c2) || c2 == '_' || c2 == '$') {
             string_cat(string, c2);
         } else {
-            ungetc(c2, stdin);
+            lexer_ungetc(c2);
             return lexer_identifier(string);
         }
     }
@@ -202,24 +307,26 @@ static lexer_token_t *lexer_read_identifier(int c1) {
 }
 
 static lexer_token_t *lexer_read_reclassify_one(int expect1, int a, int e) {
-    int c = getc(stdin);
+    int c = lexer_getc();
     if (c == expect1) return lexer_punct(a);
-    ungetc(c, stdin);
+    lexer_ungetc(c);
     return lexer_punct(e);
 }
 static lexer_token_t *lexer_read_reclassify_two(int expect1, int a, int expect2, int b, int e) {
-    int c = getc(stdin);
+    int c = lexer_getc();
     if (c == expect1) return lexer_punct(a);
     if (c == expect2) return lexer_punct(b);
-    ungetc(c, stdin);
+    lexer_ungetc(c);
     return lexer_punct(e);
 }
 
-static lexer_token_t *lexer_read_token(void) {
+static lexer_token_t *lexer_scan(void) {
     int c;
     lexer_skip();
 
-    switch ((c = getc(stdin))) {
+    lexer_token_line   = lexer_position_line;
+    lexer_token_column = lexer_position_column;
+    switch ((c = lexer_getc())) {
         case '0' ... '9':  return lexer_read_number(c);
         case '"':          return lexer_read_string();
         case '\'':         return lexer_read_character();
@@ -231,25 +338,27 @@ static lexer_token_t *lexer_read_token(void) {
             return lexer_read_identifier(c);
 
         case 'L':
-            switch ((c = getc(stdin))) {
+            switch ((c = lexer_getc())) {
                 case '"':  return lexer_read_string();
                 case '\'': return lexer_read_character();
             }
-            ungetc(c, stdin);
+            lexer_ungetc(c);
             return lexer_read_identifier('L');
 
         case '/':
-            switch ((c = getc(stdin))) {
+            switch ((c = lexer_getc())) {
                 case '/':
                     lexer_skip_comment_line();
-                    return lexer_read_token();
+                    lexer_space = true;
+                    return lexer_scan();
                 case '*':
                     lexer_skip_comment_block();
-                    return lexer_read_token();
+                    lexer_space = true;
+                    return lexer_scan();
             }
             if (c == '=')
                 return lexer_punct(LEXER_TOKEN_COMPOUND_DIV);
-            ungetc(c, stdin);
+            lexer_ungetc(c);
             return lexer_punct('/');
 
         case '(': case ')':
@@ -260,6 +369,14 @@ static lexer_token_t *lexer_read_token(void) {
         case '~':
             return lexer_punct(c);
 
+        case '#': return lexer_read_reclassify_one('#', LEXER_TOKEN_PASTE, '#');
+
+        case '\n':
+            /* only when reading a directive, see lexer_skip */
+            return lexer_token_copy(&(lexer_token_t){
+                .type = LEXER_TOKEN_NEWLINE
+            });
+
         case '+': return lexer_read_reclassify_two('+', LEXER_TOKEN_INCREMENT,    '=', LEXER_TOKEN_COMPOUND_ADD, '+');
         case '&': return lexer_read_reclassify_two('&', LEXER_TOKEN_AND,          '=', LEXER_TOKEN_COMPOUND_AND, '&');
         case '|': return lexer_read_reclassify_two('|', LEXER_TOKEN_OR,           '=', LEXER_TOKEN_COMPOUND_OR,  '|');
@@ -270,39 +387,39 @@ static lexer_token_t *lexer_read_token(void) {
         case '^': return lexer_read_reclassify_one('=', LEXER_TOKEN_COMPOUND_XOR, '^');
 
         case '-':
-            switch ((c = getc(stdin))) {
+            switch ((c = lexer_getc())) {
                 case '-': return lexer_punct(LEXER_TOKEN_DECREMENT);
                 case '>': return lexer_punct(LEXER_TOKEN_ARROW);
                 case '=': return lexer_punct(LEXER_TOKEN_COMPOUND_SUB);
                 default:
                     break;
             }
-            ungetc(c, stdin);
+            lexer_ungetc(c);
             return lexer_punct('-');
 
         case '<':
-            if ((c = getc(stdin)) == '=')
+            if ((c = lexer_getc()) == '=')
                 return lexer_punct(LEXER_TOKEN_LEQUAL);
             if (c == '<')
                 return lexer_read_reclassify_one('=', LEXER_TOKEN_COMPOUND_LSHIFT, LEXER_TOKEN_LSHIFT);
-            ungetc(c, stdin);
+            lexer_ungetc(c);
             return lexer_punct('<');
         case '>':
-            if ((c = getc(stdin)) == '=')
+            if ((c = lexer_getc()) == '=')
                 return lexer_punct(LEXER_TOKEN_GEQUAL);
             if (c == '>')
                 return lexer_read_reclassify_one('=', LEXER_TOKEN_COMPOUND_RSHIFT, LEXER_TOKEN_RSHIFT);
-            ungetc(c, stdin);
+            lexer_ungetc(c);
             return lexer_punct('>');
 
         case '.':
-            c = getc(stdin);
+            c = lexer_getc();
             if (c == '.') {
                 string_t *str = string_create();
-                string_catf(str, "..%c", getc(stdin));
+                string_catf(str, "..%c", lexer_getc());
                 return lexer_identifier(str);
             }
-            ungetc(c, stdin);
+            lexer_ungetc(c);
             return lexer_punct('.');
 
         case EOF:
@@ -314,52 +431,1596 @@ static lexer_token_t *lexer_read_token(void) {
     return NULL;
 }
 
+static lexer_token_t *lexer_read_token(void) {
+    lexer_token_t *token = lexer_scan();
+    if (token) {
+        token->begin  = lexer_begin;
+        token->space  = lexer_space;
+        token->file   = lexer_position_file;
+        token->line   = lexer_token_line;
+        token->column = lexer_token_column;
+    }
+    lexer_begin = (token && token->type == LEXER_TOKEN_NEWLINE);
+    lexer_space = false;
+    return token;
+}
+
 bool lexer_ispunct(lexer_token_t *token, int c) {
     return token && (token->type == LEXER_TOKEN_PUNCT) && (token->punct == c);
 }
 
-void lexer_unget(lexer_token_t *token) {
-    if (!token)
-        return;
-    list_push(lexer_buffer, token);
+static bool lexer_isidentifier(lexer_token_t *token, const char *name) {
+    return token && token->type == LEXER_TOKEN_IDENTIFIER && !strcmp(token->string, name);
 }
 
-lexer_token_t *lexer_next(void) {
-    if (list_length(lexer_buffer) > 0)
-        return list_pop(lexer_buffer);
-    return lexer_read_token();
+/*
+ * The preprocessor sits between the scanner and the parser. Tokens are
+ * read from the file on top of the include stack, or from a list of
+ * tokens which were put back or which came out of a macro.
+ */
+typedef struct {
+    FILE *input;
+    FILE *parent;
+    char *path;
+    char *directory;
+    int   conditions;
+
+    /*
+     * A header is guarded when everything in it is within one
+     * #ifndef group, which is remembered so that the header isn't
+     * read again while the macro of the group is still defined.
+     */
+    enum {
+        lexer_guard_start,
+        lexer_guard_open,
+        lexer_guard_closed,
+        lexer_guard_none
+    } guard;
+    char *macro;
+    int   depth;
+
+    /* where the parent was left, which is resumed once this ends */
+    int   line;
+    int   column;
+    int   number;
+} lexer_file_t;
+
+typedef struct {
+    bool    function;
+    bool    variadic;
+    list_t *parameters;
+    list_t *body;
+} lexer_macro_t;
+
+typedef struct {
+    char   *data;
+    size_t  size;
+} lexer_header_t;
+
+static COMPILE_LOCAL list_t      *lexer_files      = NULL;
+static COMPILE_LOCAL list_t      *lexer_pending    = NULL;
+static COMPILE_LOCAL bool         lexer_isolated   = false;
+static COMPILE_LOCAL int          lexer_conditions = 0;
+static COMPILE_LOCAL list_t      *lexer_groups     = NULL;
+static COMPILE_LOCAL hashtable_t *lexer_macros     = NULL;
+static COMPILE_LOCAL hashtable_t *lexer_headers    = NULL;
+static COMPILE_LOCAL hashtable_t *lexer_guards     = NULL;
+static COMPILE_LOCAL hashtable_t *lexer_once       = NULL;
+static COMPILE_LOCAL bool         lexer_included   = false;
+
+/* every file read, numbered from one in the order they were first read */
+static COMPILE_LOCAL list_t      *lexer_names      = NULL;
+static COMPILE_LOCAL hashtable_t *lexer_numbers    = NULL;
+
+/* mappings outlive the memory pool of the unit, they are undone by the next one */
+static COMPILE_LOCAL lexer_header_t *lexer_mappings       = NULL;
+static COMPILE_LOCAL int             lexer_mappings_count = 0;
+
+/* shared by every unit, set up before any of them is compiled */
+static const char **lexer_paths         = NULL;
+static int          lexer_paths_count   = 0;
+static const char **lexer_defines       = NULL;
+static int          lexer_defines_count = 0;
+
+/* the options of one request to the compile server */
+static COMPILE_LOCAL const char  *lexer_unit_directory = NULL;
+static COMPILE_LOCAL const char **lexer_unit_paths     = NULL;
+static COMPILE_LOCAL const char **lexer_unit_defines   = NULL;
+
+static const char *lexer_paths_system[] = {
+    "/usr/local/include",
+    "/usr/include/x86_64-linux-gnu",
+    "/usr/include"
+};
+
+static const char *lexer_predefined[] = {
+    "__LICE__ 1",
+    "__STDC__ 1",
+    "__STDC_VERSION__ 199901L",
+    "__STDC_HOSTED__ 1",
+    "__x86_64__ 1",
+    "__amd64__ 1",
+    "__LP64__ 1",
+    "__linux__ 1",
+    "__unix__ 1",
+    "__CHAR_BIT__ 8"
+};
+
+void lexer_include_path(const char *directory) {
+    lexer_paths = realloc(lexer_paths, sizeof(char*) * (lexer_paths_count + 1));
+    lexer_paths[lexer_paths_count++] = directory;
 }
 
-lexer_token_t *lexer_peek(void) {
-    lexer_token_t *token = lexer_next();
-    lexer_unget(token);
-    return token;
+void lexer_predefine(const char *definition) {
+    lexer_defines = realloc(lexer_defines, sizeof(char*) * (lexer_defines_count + 1));
+    lexer_defines[lexer_defines_count++] = definition;
+}
+
+void lexer_unit_options(const char *directory, const char **paths, const char **defines) {
+    lexer_unit_directory = directory;
+    lexer_unit_paths     = paths;
+    lexer_unit_defines   = defines;
 }
 
+static lexer_file_t *lexer_file(void) {
+    return list_tail(lexer_files);
+}
+
+static const char *lexer_punct_spelling[] = {
+    [LEXER_TOKEN_EQUAL           - LEXER_TOKEN_EQUAL] = "==",
+    [LEXER_TOKEN_LEQUAL          - LEXER_TOKEN_EQUAL] = "<=",
+    [LEXER_TOKEN_GEQUAL          - LEXER_TOKEN_EQUAL] = ">=",
+    [LEXER_TOKEN_NEQUAL          - LEXER_TOKEN_EQUAL] = "!=",
+    [LEXER_TOKEN_INCREMENT       - LEXER_TOKEN_EQUAL] = "++",
+    [LEXER_TOKEN_DECREMENT       - LEXER_TOKEN_EQUAL] = "--",
+    [LEXER_TOKEN_ARROW           - LEXER_TOKEN_EQUAL] = "->",
+    [LEXER_TOKEN_LSHIFT          - LEXER_TOKEN_EQUAL] = "<<",
+    [LEXER_TOKEN_RSHIFT          - LEXER_TOKEN_EQUAL] = ">>",
+    [LEXER_TOKEN_COMPOUND_ADD    - LEXER_TOKEN_EQUAL] = "+=",
+    [LEXER_TOKEN_COMPOUND_SUB    - LEXER_TOKEN_EQUAL] = "-=",
+    [LEXER_TOKEN_COMPOUND_MUL    - LEXER_TOKEN_EQUAL] = "*=",
+    [LEXER_TOKEN_COMPOUND_DIV    - LEXER_TOKEN_EQUAL] = "/=",
+    [LEXER_TOKEN_COMPOUND_MOD    - LEXER_TOKEN_EQUAL] = "%=",
+    [LEXER_TOKEN_COMPOUND_AND    - LEXER_TOKEN_EQUAL] = "&=",
+    [LEXER_TOKEN_COMPOUND_OR     - LEXER_TOKEN_EQUAL] = "|=",
+    [LEXER_TOKEN_COMPOUND_XOR    - LEXER_TOKEN_EQUAL] = "^=",
+    [LEXER_TOKEN_COMPOUND_LSHIFT - LEXER_TOKEN_EQUAL] = "<<=",
+    [LEXER_TOKEN_COMPOUND_RSHIFT - LEXER_TOKEN_EQUAL] = ">>=",
+    [LEXER_TOKEN_AND             - LEXER_TOKEN_EQUAL] = "&&",
+    [LEXER_TOKEN_OR              - LEXER_TOKEN_EQUAL] = "||",
+    [LEXER_TOKEN_PASTE           - LEXER_TOKEN_EQUAL] = "##"
+};
+
 char *lexer_tokenstr(lexer_token_t *token) {
     string_t *string = string_create();
     if (!token)
         return "(null)";
     switch (token->type) {
         case LEXER_TOKEN_PUNCT:
-            if (token->punct == LEXER_TOKEN_EQUAL) {
-                string_catf(string, "==");
-                return string_buffer(string);
-            }
+            if (token->punct >= LEXER_TOKEN_EQUAL)
+                return (char*)lexer_punct_spelling[token->punct - LEXER_TOKEN_EQUAL];
+            string_cat(string, token->punct);
+            return string_buffer(string);
         case LEXER_TOKEN_CHAR:
-            string_cat(string, token->character);
+            if (token->character == '\'' || token->character == '\\')
+                string_catf(string, "'\\%c'", token->character);
+            else
+                string_catf(string, "'%s'", string_quote((char[]){ token->character, '\0' }));
             return string_buffer(string);
         case LEXER_TOKEN_NUMBER:
-            string_catf(string, "%d", token->integer);
+            string_catf(string, "%s", token->string);
             return string_buffer(string);
         case LEXER_TOKEN_STRING:
-            string_catf(string, "\"%s\"", token->string);
+            string_catf(string, "\"%s\"", string_quote(token->string));
             return string_buffer(string);
         case LEXER_TOKEN_IDENTIFIER:
             return token->string;
+        case LEXER_TOKEN_NEWLINE:
+            return "newline";
         default:
             break;
     }
     compile_error("Internal error: unexpected token");
     return NULL;
 }
+
+/* a token which never came out of a macro has no hideset at all */
+static bool lexer_hideset_contains(list_t *hideset, const char *name) {
+    if (!hideset)
+        return false;
+    for (list_iterator_t *it = list_iterator(hideset); !list_iterator_end(it); )
+        if (!strcmp(list_iterator_next(it), name))
+            return true;
+    return false;
+}
+
+static list_t *lexer_hideset_union(list_t *a, list_t *b) {
+    list_t *result = list_create();
+    if (a)
+        for (list_iterator_t *it = list_iterator(a); !list_iterator_end(it); )
+            list_push(result, list_iterator_next(it));
+    if (b)
+        for (list_iterator_t *it = list_iterator(b); !list_iterator_end(it); ) {
+            char *name = list_iterator_next(it);
+            if (!lexer_hideset_contains(result, name))
+                list_push(result, name);
+        }
+    return result;
+}
+
+static list_t *lexer_hideset_intersection(list_t *a, list_t *b) {
+    list_t *result = list_create();
+    if (!a)
+        return result;
+    for (list_iterator_t *it = list_iterator(a); !list_iterator_end(it); ) {
+        char *name = list_iterator_next(it);
+        if (lexer_hideset_contains(b, name))
+            list_push(result, name);
+    }
+    return result;
+}
+
+static list_t *lexer_hideset_add(list_t *hideset, char *name) {
+    list_t *result = lexer_hideset_union(hideset, NULL);
+    list_push(result, name);
+    return result;
+}
+
+/* scans text which isn't part of any file, like a pasted token */
+static list_t *lexer_scan_text(const char *text) {
+    list_t *tokens    = list_create();
+    FILE   *input     = fmemopen((void*)text, strlen(text), "r");
+    FILE   *saved     = lexer_input;
+    bool    directive = lexer_directive;
+    bool    begin     = lexer_begin;
+    bool    space     = lexer_space;
+    int     line      = lexer_position_line;
+    int     column    = lexer_position_column;
+    int     last      = lexer_position_last;
+
+    if (!input)
+        compile_error("cannot allocate input buffer");
+
+    lexer_input     = input;
+    lexer_directive = true;
+    for (lexer_token_t *token; (token = lexer_read_token()) && token->type != LEXER_TOKEN_NEWLINE; )
+        list_push(tokens, token);
+
+    lexer_input     = saved;
+    lexer_directive = directive;
+    lexer_begin     = begin;
+    lexer_space     = space;
+    fclose(input);
+
+    lexer_position_line   = line;
+    lexer_position_column = column;
+    lexer_position_last   = last;
+    return tokens;
+}
+
+/*
+ * Headers are mapped rather than read, and every mapping is kept for
+ * the rest of the unit so that a header which is included again is
+ * not read from disk again.
+ */
+static lexer_header_t *lexer_header(char *path) {
+    lexer_header_t *header = hashtable_find(lexer_headers, path);
+    struct stat     status;
+    int             fd;
+
+    if (header)
+        return header;
+
+    if ((fd = open(path, O_RDONLY)) == -1 || fstat(fd, &status) == -1)
+        compile_error("cannot open include file `%s'", path);
+
+    header       = memory_allocate(sizeof(lexer_header_t));
+    header->size = status.st_size;
+    header->data = NULL;
+
+    if (header->size) {
+        header->data = mmap(NULL, header->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (header->data == MAP_FAILED)
+            compile_error("cannot map include file `%s'", path);
+
+        lexer_mappings = realloc(lexer_mappings, sizeof(lexer_header_t) * (lexer_mappings_count + 1));
+        lexer_mappings[lexer_mappings_count++] = *header;
+    }
+    close(fd);
+
+    hashtable_insert(lexer_headers, path, header);
+    return header;
+}
+
+static char *lexer_directory(const char *path) {
+    string_t   *string = string_create();
+    const char *slash  = strrchr(path, '/');
+
+    if (!slash)
+        return ".";
+    for (const char *p = path; p < slash; p++)
+        string_cat(string, *p);
+    return (slash == path) ? "/" : string_buffer(string);
+}
+
+static int lexer_file_number(const char *path) {
+    const char *name   = path ? path : "<stdin>";
+    int        *number = hashtable_find(lexer_numbers, name);
+
+    if (!number) {
+        number  = memory_allocate(sizeof(int));
+        *number = list_length(lexer_names) + 1;
+        list_push(lexer_names, (char*)name);
+        hashtable_insert(lexer_numbers, (char*)name, number);
+    }
+    return *number;
+}
+
+list_t *lexer_file_names(void) {
+    return lexer_names;
+}
+
+/* the files are hashed by name since the numbers depend on what was included */
+unsigned long lexer_hash_positions(unsigned long hash, list_t *tokens) {
+    for (list_iterator_t *it = list_iterator(lexer_names); !list_iterator_end(it); ) {
+        char *name = list_iterator_next(it);
+        hash = hash_bytes(hash, name, strlen(name) + 1);
+    }
+    for (list_iterator_t *it = list_iterator(tokens); !list_iterator_end(it); ) {
+        lexer_token_t *token = list_iterator_next(it);
+        hash = hash_bytes(hash, &token->file,   sizeof(token->file));
+        hash = hash_bytes(hash, &token->line,   sizeof(token->line));
+        hash = hash_bytes(hash, &token->column, sizeof(token->column));
+    }
+    return hash;
+}
+
+static void lexer_file_push(FILE *input, char *path) {
+    lexer_file_t *file = memory_allocate(sizeof(lexer_file_t));
+
+    file->input      = input;
+    file->parent     = lexer_input;
+    file->path       = path;
+    file->directory  = path ? lexer_directory(path) : ".";
+    file->conditions = lexer_conditions;
+    file->guard      = lexer_guard_start;
+    file->macro      = NULL;
+    file->depth      = 0;
+    file->line       = lexer_position_line;
+    file->column     = lexer_position_column;
+    file->number     = lexer_position_file;
+
+    list_push(lexer_files, file);
+    lexer_input           = input;
+    lexer_begin           = true;
+    lexer_position_file   = lexer_file_number(path);
+    lexer_position_line   = 1;
+    lexer_position_column = 1;
+}
+
+/* returns false at the end of the translation unit */
+static bool lexer_file_pop(void) {
+    lexer_file_t *file = lexer_file();
+
+    if (lexer_conditions != file->conditions)
+        compile_error("unterminated conditional directive");
+
+    /* the unit itself may be a header too when it is precompiled */
+    if (file->guard == lexer_guard_closed && file->path)
+        hashtable_insert(lexer_guards, file->path, file->macro);
+    if (list_length(lexer_files) == 1)
+        return false;
+
+    fclose(file->input);
+    list_pop(lexer_files);
+    lexer_input           = file->parent;
+    lexer_begin           = true;
+    lexer_position_file   = file->number;
+    lexer_position_line   = file->line;
+    lexer_position_column = file->column;
+    return true;
+}
+
+static void lexer_guard_token(void) {
+    lexer_file_t *file = lexer_file();
+    if (file->guard != lexer_guard_open)
+        file->guard = lexer_guard_none;
+}
+
+static lexer_token_t *lexer_file_token(void) {
+    for (;;) {
+        lexer_token_t *token = lexer_read_token();
+        if (token) {
+            if (!token->begin || !lexer_ispunct(token, '#'))
+                lexer_guard_token();
+            return token;
+        }
+        if (!lexer_file_pop())
+            return NULL;
+    }
+}
+
+/* tokens which were put back come first, otherwise the file */
+static lexer_token_t *lexer_source(void) {
+    if (list_length(lexer_pending) > 0)
+        return list_pop(lexer_pending);
+    if (lexer_isolated)
+        return NULL;
+    return lexer_file_token();
+}
+
+static void lexer_source_unget(lexer_token_t *token) {
+    if (token)
+        list_push(lexer_pending, token);
+}
+
+static void lexer_source_push(list_t *tokens) {
+    for (list_iterator_t *it = list_iterator(list_reverse(tokens)); !list_iterator_end(it); )
+        list_push(lexer_pending, list_iterator_next(it));
+}
+
+/* the rest of the directive line */
+static list_t *lexer_line(void) {
+    list_t *tokens = list_create();
+
+    lexer_directive = true;
+    for (lexer_token_t *token; (token = lexer_read_token()) && token->type != LEXER_TOKEN_NEWLINE; )
+        list_push(tokens, token);
+    lexer_directive = false;
+
+    return tokens;
+}
+
+static lexer_token_t *lexer_line_name(void) {
+    lexer_token_t *token;
+
+    lexer_directive = true;
+    token           = lexer_read_token();
+    lexer_directive = false;
+
+    if (token && token->type == LEXER_TOKEN_NEWLINE) {
+        lexer_begin = true;
+        return NULL;
+    }
+    return token;
+}
+
+/*
+ * Skips the rest of a line which isn't preprocessed, comments and
+ * literals are passed over so nothing in them is taken for the end
+ * of the line or of a comment.
+ */
+static void lexer_skip_line(void) {
+    int c;
+    while ((c = lexer_getc()) != EOF && c != '\n') {
+        if (c == '\\') {
+            lexer_getc();
+        } else if (c == '"' || c == '\'') {
+            int quote = c;
+            while ((c = lexer_getc()) != EOF && c != quote && c != '\n')
+                if (c == '\\')
+                    lexer_getc();
+            if (c == '\n')
+                return;
+        } else if (c == '/') {
+            if ((c = lexer_getc()) == '*') {
+                lexer_skip_comment_block();
+            } else if (c == '/') {
+                lexer_skip_comment_line();
+            } else {
+                lexer_ungetc(c);
+            }
+        }
+    }
+}
+
+/* skips to the next line which is a directive, just past its `#' */
+static bool lexer_skip_to_directive(void) {
+    for (;;) {
+        int c;
+        while ((c = lexer_getc()) == ' ' || c == '\t' || c == '\f' || c == '\v' || c == '\r')
+            ;
+        if (c == EOF)
+            return false;
+        if (c == '#')
+            return true;
+        lexer_ungetc(c);
+        lexer_skip_line();
+    }
+}
+
+static lexer_token_t *lexer_expand(void);
+
+static list_t *lexer_expand_all(list_t *tokens) {
+    list_t *pending  = lexer_pending;
+    bool    isolated = lexer_isolated;
+    list_t *result   = list_create();
+
+    lexer_pending  = list_reverse(tokens);
+    lexer_isolated = true;
+    for (lexer_token_t *token; (token = lexer_expand()); )
+        list_push(result, token);
+
+    lexer_pending  = pending;
+    lexer_isolated = isolated;
+    return result;
+}
+
+static lexer_token_t *lexer_token_derive(lexer_token_t *token, list_t *hideset) {
+    lexer_token_t *copy = lexer_token_copy(token);
+    copy->begin   = false;
+    copy->hideset = lexer_hideset_union(token->hideset, hideset);
+    return copy;
+}
+
+static lexer_token_t *lexer_stringize(list_t *tokens) {
+    string_t *string = string_create();
+    for (list_iterator_t *it = list_iterator(tokens); !list_iterator_end(it); ) {
+        lexer_token_t *token = list_iterator_next(it);
+        if (token->space && string_buffer(string)[0])
+            string_cat(string, ' ');
+        string_catf(string, "%s", lexer_tokenstr(token));
+    }
+    return lexer_strtok(string);
+}
+
+static lexer_token_t *lexer_paste(lexer_token_t *left, lexer_token_t *right) {
+    string_t *string = string_create();
+    string_catf(string, "%s%s", lexer_tokenstr(left), lexer_tokenstr(right));
+
+    list_t *tokens = lexer_scan_text(string_buffer(string));
+    if (list_length(tokens) != 1)
+        compile_error("pasting `%s' and `%s' does not give a valid token", lexer_tokenstr(left), lexer_tokenstr(right));
+
+    lexer_token_t *token = list_pop(tokens);
+    token->space   = left->space;
+    token->hideset = left->hideset;
+    return token;
+}
+
+static int lexer_macro_parameter(lexer_macro_t *macro, lexer_token_t *token) {
+    int index = 0;
+    if (!macro->function || !token || token->type != LEXER_TOKEN_IDENTIFIER)
+        return -1;
+    for (list_iterator_t *it = list_iterator(macro->parameters); !list_iterator_end(it); index++)
+        if (!strcmp(list_iterator_next(it), token->string))
+            return index;
+    return -1;
+}
+
+static void lexer_macro_append(list_t *result, list_t *tokens) {
+    for (list_iterator_t *it = list_iterator(tokens); !list_iterator_end(it); )
+        list_push(result, list_iterator_next(it));
+}
+
+/* replaces the parameters in the body of a macro by its arguments */
+static list_t *lexer_macro_substitute(lexer_macro_t *macro, list_t **arguments, list_t *hideset) {
+    list_t         *result = list_create();
+    int             count  = list_length(macro->body);
+    lexer_token_t **body   = memory_allocate(sizeof(lexer_token_t*) * (count + 1));
+    int             index  = 0;
+
+    for (list_iterator_t *it = list_iterator(macro->body); !list_iterator_end(it); )
+        body[index++] = list_iterator_next(it);
+    body[count] = NULL;
+
+    for (int i = 0; i < count; i++) {
+        lexer_token_t *token = body[i];
+        lexer_token_t *next  = body[i + 1];
+        int            param = lexer_macro_parameter(macro, next);
+
+        if (lexer_ispunct(token, '#') && param != -1) {
+            lexer_token_t *string = lexer_stringize(arguments[param]);
+            string->space = token->space;
+            list_push(result, string);
+            i++;
+            continue;
+        }
+
+        if (lexer_ispunct(token, LEXER_TOKEN_PASTE) && list_length(result) && next) {
+            list_t *right = (param != -1) ? arguments[param] : NULL;
+            i++;
+            if (right && !list_length(right))
+                continue;
+
+            lexer_token_t *left = list_pop(result);
+            if (!right) {
+                list_push(result, lexer_paste(left, next));
+                continue;
+            }
+
+            list_iterator_t *it = list_iterator(right);
+            list_push(result, lexer_paste(left, list_iterator_next(it)));
+            while (!list_iterator_end(it))
+                list_push(result, list_iterator_next(it));
+            continue;
+        }
+
+        if ((param = lexer_macro_parameter(macro, token)) != -1) {
+            /* an operand of ## is not expanded, nor is an empty one kept */
+            if (lexer_ispunct(next, LEXER_TOKEN_PASTE)) {
+                if (!list_length(arguments[param]))
+                    i++;
+                else
+                    lexer_macro_append(result, arguments[param]);
+                continue;
+            }
+
+            list_t *expanded = lexer_expand_all(arguments[param]);
+            if (list_length(expanded)) {
+                lexer_token_t *first = lexer_token_copy(list_shift(expanded));
+                first->space = token->space;
+                list_push(result, first);
+            }
+            lexer_macro_append(result, expanded);
+            continue;
+        }
+
+        list_push(result, token);
+    }
+
+    list_t *derived = list_create();
+    for (list_iterator_t *it = list_iterator(result); !list_iterator_end(it); )
+        list_push(derived, lexer_token_derive(list_iterator_next(it), hideset));
+    return derived;
+}
+
+/* reads the arguments of a call to a function-like macro up to the closing parenthesis */
+static list_t **lexer_macro_arguments(lexer_macro_t *macro, char *name, lexer_token_t **close) {
+    int      parameters = list_length(macro->parameters);
+    list_t **arguments  = memory_allocate(sizeof(list_t*) * (parameters + 1));
+    list_t  *argument   = list_create();
+    int      count      = 0;
+    int      nests      = 0;
+
+    for (;;) {
+        lexer_token_t *token = lexer_source();
+        if (!token)
+            compile_error("unterminated call of macro `%s'", name);
+
+        if (nests == 0 && lexer_ispunct(token, ')')) {
+            *close = token;
+            break;
+        }
+
+        bool variadic = macro->variadic && count == parameters - 1;
+        if (nests == 0 && lexer_ispunct(token, ',') && !variadic) {
+            if (count < parameters)
+                arguments[count] = argument;
+            count++;
+            argument = list_create();
+            continue;
+        }
+
+        if (lexer_ispunct(token, '('))
+            nests++;
+        if (lexer_ispunct(token, ')'))
+            nests--;
+        list_push(argument, token);
+    }
+
+    if (count < parameters)
+        arguments[count] = argument;
+    count++;
+
+    /* f() calls a macro without parameters with no arguments */
+    if (parameters == 0 && count == 1 && !list_length(argument))
+        count = 0;
+    /* the variadic part may be left out altogether */
+    if (macro->variadic && count == parameters - 1)
+        arguments[count++] = list_create();
+
+    if (count != parameters)
+        compile_error("macro `%s' takes %d arguments, %d given", name, parameters, count);
+
+    return arguments;
+}
+
+static bool lexer_macro_defined(const char *name) {
+    return hashtable_find(lexer_macros, name) != NULL;
+}
+
+static void lexer_directive_run(void);
+
+static lexer_token_t *lexer_expand(void) {
+    for (;;) {
+        lexer_token_t *token = lexer_source();
+        if (!token)
+            return NULL;
+
+        if (!lexer_isolated && token->begin && lexer_ispunct(token, '#')) {
+            lexer_directive_run();
+            continue;
+        }
+
+        if (token->type != LEXER_TOKEN_IDENTIFIER)
+            return token;
+
+        char          *name  = token->string;
+        lexer_macro_t *macro = hashtable_find(lexer_macros, name);
+        if (!macro || lexer_hideset_contains(token->hideset, name))
+            return token;
+
+        list_t *expanded;
+        if (!macro->function) {
+            expanded = lexer_macro_substitute(macro, NULL, lexer_hideset_add(token->hideset, name));
+        } else {
+            lexer_token_t *next = lexer_source();
+            if (!lexer_ispunct(next, '(')) {
+                lexer_source_unget(next);
+                return token;
+            }
+
+            lexer_token_t  *close;
+            list_t        **arguments = lexer_macro_arguments(macro, name, &close);
+            list_t         *hideset   = lexer_hideset_intersection(token->hideset, close->hideset);
+
+            expanded = lexer_macro_substitute(macro, arguments, lexer_hideset_add(hideset, name));
+        }
+
+        /* what came out of a macro is where it was used */
+        for (list_iterator_t *it = list_iterator(expanded); !list_iterator_end(it); ) {
+            lexer_token_t *place = list_iterator_next(it);
+            place->file   = token->file;
+            place->line   = token->line;
+            place->column = token->column;
+        }
+
+        /* the expansion is read again so that macros in it are expanded too */
+        if (list_length(expanded)) {
+            lexer_token_t *first = lexer_token_copy(list_shift(expanded));
+            first->space = token->space;
+            lexer_source_push(expanded);
+            lexer_source_unget(first);
+        }
+    }
+}
+
+/*
+ * Conditions of #if and #elif are evaluated on the tokens of the
+ * line once `defined' is replaced and macros are expanded, names
+ * which are left over are zero. Every value is as wide as a long and
+ * is unsigned as it would be in C, so -1 > 0u.
+ */
+typedef struct {
+    lexer_token_t **tokens;
+    int             position;
+    int             unevaluated; /* operands && || and ?: leave out */
+} lexer_expression_t;
+
+typedef struct {
+    long value;
+    bool sign;
+} lexer_value_t;
+
+static lexer_value_t lexer_expression(lexer_expression_t *expression);
+
+static lexer_value_t lexer_value(long value, bool sign) {
+    return (lexer_value_t){ .value = value, .sign = sign };
+}
+
+static lexer_token_t *lexer_expression_next(lexer_expression_t *expression) {
+    lexer_token_t *token = expression->tokens[expression->position];
+    if (token)
+        expression->position++;
+    return token;
+}
+
+static bool lexer_expression_match(lexer_expression_t *expression, int punct) {
+    if (!lexer_ispunct(expression->tokens[expression->position], punct))
+        return false;
+    expression->position++;
+    return true;
+}
+
+/* a number too large for a long is unsigned even without a suffix */
+static lexer_value_t lexer_expression_number(const char *string) {
+    char          *end;
+    unsigned long  value = strtoul(string, &end, 0);
+    bool           sign  = (value <= LONG_MAX);
+
+    for (; *end == 'u' || *end == 'U' || *end == 'l' || *end == 'L'; end++)
+        if (*end == 'u' || *end == 'U')
+            sign = false;
+    if (*end)
+        compile_error("invalid number `%s' in preprocessor expression", string);
+    return lexer_value(value, sign);
+}
+
+static lexer_value_t lexer_expression_primary(lexer_expression_t *expression) {
+    lexer_token_t *token = lexer_expression_next(expression);
+    lexer_value_t  value;
+
+    if (!token)
+        compile_error("missing operand in preprocessor expression");
+
+    switch (token->type) {
+        case LEXER_TOKEN_NUMBER:     return lexer_expression_number(token->string);
+        case LEXER_TOKEN_CHAR:       return lexer_value(token->character, true);
+        case LEXER_TOKEN_IDENTIFIER: return lexer_value(0, true);
+        case LEXER_TOKEN_PUNCT:
+            switch (token->punct) {
+                case '(':
+                    value = lexer_expression(expression);
+                    if (!lexer_expression_match(expression, ')'))
+                        compile_error("expected `)' in preprocessor expression");
+                    return value;
+                case '!':
+                    value = lexer_expression_primary(expression);
+                    return lexer_value(!value.value, true);
+                case '~':
+                    value = lexer_expression_primary(expression);
+                    return lexer_value(~value.value, value.sign);
+                case '-':
+                    value = lexer_expression_primary(expression);
+                    return lexer_value(-(unsigned long)value.value, value.sign);
+                case '+':
+                    return lexer_expression_primary(expression);
+            }
+        default:
+            break;
+    }
+    compile_error("unexpected `%s' in preprocessor expression", lexer_tokenstr(token));
+    return lexer_value(0, true);
+}
+
+static int lexer_expression_priority(lexer_token_t *token) {
+    if (!token || token->type != LEXER_TOKEN_PUNCT)
+        return -1;
+    switch (token->punct) {
+        case '*': case '/': case '%':                   return 10;
+        case '+': case '-':                             return 9;
+        case LEXER_TOKEN_LSHIFT: case LEXER_TOKEN_RSHIFT: return 8;
+        case '<': case '>':
+        case LEXER_TOKEN_LEQUAL: case LEXER_TOKEN_GEQUAL: return 7;
+        case LEXER_TOKEN_EQUAL:  case LEXER_TOKEN_NEQUAL: return 6;
+        case '&':                                       return 5;
+        case '^':                                       return 4;
+        case '|':                                       return 3;
+        case LEXER_TOKEN_AND:                           return 2;
+        case LEXER_TOKEN_OR:                            return 1;
+    }
+    return -1;
+}
+
+/*
+ * Wrapping is done on unsigned values either way, the signed ones
+ * only differ where the order of the values matters.
+ */
+static lexer_value_t lexer_expression_signed(int punct, long value, long right) {
+    switch (punct) {
+        case '<':                    return lexer_value(value <  right, true);
+        case '>':                    return lexer_value(value >  right, true);
+        case LEXER_TOKEN_LEQUAL:     return lexer_value(value <= right, true);
+        case LEXER_TOKEN_GEQUAL:     return lexer_value(value >= right, true);
+        case LEXER_TOKEN_RSHIFT:     return lexer_value(value >> right, true);
+
+        /* a zero divisor only gets here from an operand which is left out */
+        case '/': return lexer_value((right && (value != LONG_MIN || right != -1)) ? value / right : 0, true);
+        case '%': return lexer_value((right && (value != LONG_MIN || right != -1)) ? value % right : 0, true);
+    }
+    return lexer_value(0, true);
+}
+
+static lexer_value_t lexer_expression_unsigned(int punct, unsigned long value, unsigned long right) {
+    switch (punct) {
+        case '<':                    return lexer_value(value <  right, true);
+        case '>':                    return lexer_value(value >  right, true);
+        case LEXER_TOKEN_LEQUAL:     return lexer_value(value <= right, true);
+        case LEXER_TOKEN_GEQUAL:     return lexer_value(value >= right, true);
+        case LEXER_TOKEN_RSHIFT:     return lexer_value(value >> right, false);
+        case '/':                    return lexer_value(right ? value / right : 0, false);
+        case '%':                    return lexer_value(right ? value % right : 0, false);
+    }
+    return lexer_value(0, true);
+}
+
+static lexer_value_t lexer_expression_binary(lexer_expression_t *expression, int priority) {
+    lexer_value_t value = lexer_expression_primary(expression);
+
+    for (;;) {
+        lexer_token_t *token = expression->tokens[expression->position];
+        int            next  = lexer_expression_priority(token);
+        if (next < priority)
+            return value;
+
+        /* the right side is still parsed when its value does not matter */
+        bool skip = (token->punct == LEXER_TOKEN_AND && !value.value)
+                 || (token->punct == LEXER_TOKEN_OR  &&  value.value);
+
+        expression->position++;
+        expression->unevaluated += skip;
+        lexer_value_t  right = lexer_expression_binary(expression, next + 1);
+        unsigned long  a     = value.value;
+        unsigned long  b     = right.value;
+        bool           sign  = value.sign && right.sign;
+        expression->unevaluated -= skip;
+
+        if ((token->punct == '/' || token->punct == '%') && !b && !expression->unevaluated)
+            compile_error("division by zero in #if");
+
+        switch (token->punct) {
+            case '*':                    value = lexer_value(a *  b, sign); break;
+            case '+':                    value = lexer_value(a +  b, sign); break;
+            case '-':                    value = lexer_value(a -  b, sign); break;
+            case '&':                    value = lexer_value(a &  b, sign); break;
+            case '^':                    value = lexer_value(a ^  b, sign); break;
+            case '|':                    value = lexer_value(a |  b, sign); break;
+            case LEXER_TOKEN_EQUAL:      value = lexer_value(a == b, true); break;
+            case LEXER_TOKEN_NEQUAL:     value = lexer_value(a != b, true); break;
+            case LEXER_TOKEN_AND:        value = lexer_value(a && b, true); break;
+            case LEXER_TOKEN_OR:         value = lexer_value(a || b, true); break;
+
+            /* a shift has the type of what is shifted */
+            case LEXER_TOKEN_LSHIFT:     value = lexer_value(a << (b & 63), value.sign); break;
+            case LEXER_TOKEN_RSHIFT:
+                value = value.sign ? lexer_expression_signed(token->punct, value.value, b & 63)
+                                   : lexer_expression_unsigned(token->punct, a, b & 63);
+                break;
+
+            default:
+                value = sign ? lexer_expression_signed(token->punct, value.value, right.value)
+                             : lexer_expression_unsigned(token->punct, a, b);
+                break;
+        }
+    }
+}
+
+static lexer_value_t lexer_expression(lexer_expression_t *expression) {
+    lexer_value_t condition = lexer_expression_binary(expression, 1);
+    if (!lexer_expression_match(expression, '?'))
+        return condition;
+
+    expression->unevaluated += !condition.value;
+    lexer_value_t then = lexer_expression(expression);
+    expression->unevaluated -= !condition.value;
+    if (!lexer_expression_match(expression, ':'))
+        compile_error("expected `:' in preprocessor expression");
+    expression->unevaluated += !!condition.value;
+    lexer_value_t otherwise = lexer_expression(expression);
+    expression->unevaluated -= !!condition.value;
+
+    lexer_value_t value = condition.value ? then : otherwise;
+    value.sign = then.sign && otherwise.sign;
+    return value;
+}
+
+static lexer_token_t *lexer_number_token(bool value) {
+    return lexer_number(value ? "1" : "0");
+}
+
+static bool lexer_condition(list_t *line) {
+    list_t *tokens = list_create();
+
+    for (list_iterator_t *it = list_iterator(line); !list_iterator_end(it); ) {
+        lexer_token_t *token = list_iterator_next(it);
+        if (!lexer_isidentifier(token, "defined")) {
+            list_push(tokens, token);
+            continue;
+        }
+
+        lexer_token_t *name  = list_iterator_next(it);
+        bool           paren = lexer_ispunct(name, '(');
+        if (paren)
+            name = list_iterator_next(it);
+        if (!name || name->type != LEXER_TOKEN_IDENTIFIER)
+            compile_error("expected macro name after `defined'");
+        if (paren && !lexer_ispunct(list_iterator_next(it), ')'))
+            compile_error("expected `)' after `defined(%s'", name->string);
+
+        list_push(tokens, lexer_number_token(lexer_macro_defined(name->string)));
+    }
+
+    tokens = lexer_expand_all(tokens);
+    if (!list_length(tokens))
+        compile_error("#if with no expression");
+
+    lexer_expression_t expression = {
+        .tokens   = memory_allocate(sizeof(lexer_token_t*) * (list_length(tokens) + 1)),
+        .position    = 0,
+        .unevaluated = 0
+    };
+
+    int index = 0;
+    for (list_iterator_t *it = list_iterator(tokens); !list_iterator_end(it); )
+        expression.tokens[index++] = list_iterator_next(it);
+    expression.tokens[index] = NULL;
+
+    lexer_value_t value = lexer_expression(&expression);
+    if (expression.tokens[expression.position])
+        compile_error("unexpected `%s' in preprocessor expression", lexer_tokenstr(expression.tokens[expression.position]));
+
+    return value.value != 0;
+}
+
+/* the group of a guard is the one its #ifndef opened */
+static void lexer_guard_directive(const char *name, bool skipping) {
+    lexer_file_t *file  = lexer_file();
+    int           depth = lexer_conditions - (skipping ? 0 : 1);
+
+    if (file->guard == lexer_guard_closed || file->guard == lexer_guard_start) {
+        file->guard = lexer_guard_none;
+        return;
+    }
+    if (file->guard != lexer_guard_open || depth != file->depth)
+        return;
+    if (!strcmp(name, "else") || !strcmp(name, "elif"))
+        file->guard = lexer_guard_none;
+}
+
+static void lexer_guard_endif(void) {
+    lexer_file_t *file = lexer_file();
+    if (file->guard == lexer_guard_open && lexer_conditions == file->depth)
+        file->guard = lexer_guard_closed;
+}
+
+/* each open group remembers the directive which began it */
+static void lexer_condition_open(const char *directive) {
+    lexer_conditions++;
+    list_push(lexer_groups, (char*)directive);
+}
+
+static const char *lexer_condition_close(void) {
+    lexer_conditions--;
+    return list_pop(lexer_groups);
+}
+
+/* nothing may follow the #else of a conditional but its #endif */
+static void lexer_condition_check(const char *group, const char *name) {
+    if (!strcmp(group, "else") && (!strcmp(name, "else") || !strcmp(name, "elif")))
+        compile_error("#%s after #else", name);
+}
+
+/*
+ * Skips a group whose condition is false. Returns at the #endif of
+ * the group, or at an #elif or #else which starts a group that is not
+ * skipped when *alternatives* are taken at all. The group began with
+ * *directive*, and so do the groups nested in it for the check above.
+ */
+static void lexer_condition_skip(bool alternatives, const char *directive) {
+    list_t *groups = list_create();
+
+    list_push(groups, (char*)directive);
+    for (;;) {
+        if (!lexer_skip_to_directive())
+            compile_error("unterminated conditional directive");
+
+        lexer_token_t *token = lexer_line_name();
+        if (!token)
+            continue;
+        if (token->type != LEXER_TOKEN_IDENTIFIER) {
+            if (token->type != LEXER_TOKEN_NEWLINE)
+                lexer_skip_line();
+            continue;
+        }
+
+        char *name = token->string;
+        if (!strcmp(name, "if") || !strcmp(name, "ifdef") || !strcmp(name, "ifndef")) {
+            lexer_skip_line();
+            list_push(groups, name);
+            continue;
+        }
+        if (!strcmp(name, "else") || !strcmp(name, "elif")) {
+            lexer_condition_check(list_pop(groups), name);
+            list_push(groups, name);
+        }
+        if (list_length(groups) > 1) {
+            if (!strcmp(name, "endif"))
+                list_pop(groups);
+            lexer_skip_line();
+            continue;
+        }
+
+        if (!strcmp(name, "endif")) {
+            lexer_skip_line();
+            lexer_guard_endif();
+            lexer_begin = true;
+            return;
+        }
+        if (!strcmp(name, "else") && alternatives) {
+            lexer_skip_line();
+            lexer_guard_directive(name, true);
+            lexer_condition_open(name);
+            lexer_begin = true;
+            return;
+        }
+        if (!strcmp(name, "elif") && alternatives) {
+            lexer_guard_directive(name, true);
+            if (lexer_condition(lexer_line())) {
+                lexer_condition_open(name);
+                lexer_begin = true;
+                return;
+            }
+            continue;
+        }
+        lexer_skip_line();
+    }
+}
+
+static void lexer_condition_enter(bool taken) {
+    if (taken)
+        lexer_condition_open("if");
+    else
+        lexer_condition_skip(true, "if");
+}
+
+static char *lexer_directive_name(list_t *line, const char *directive) {
+    lexer_token_t *token = list_length(line) ? list_shift(line) : NULL;
+    if (!token || token->type != LEXER_TOKEN_IDENTIFIER)
+        compile_error("expected macro name after #%s", directive);
+    return token->string;
+}
+
+static void lexer_directive_define(void) {
+    list_t        *line  = lexer_line();
+    char          *name  = lexer_directive_name(line, "define");
+    lexer_macro_t *macro = memory_allocate(sizeof(lexer_macro_t));
+    lexer_token_t *token = list_length(line) ? list_shift(line) : NULL;
+
+    macro->function   = false;
+    macro->variadic   = false;
+    macro->parameters = list_create();
+    macro->body       = line;
+
+    /* a parenthesis right after the name makes it function-like */
+    if (lexer_ispunct(token, '(') && !token->space) {
+        macro->function = true;
+        token = list_shift(line);
+        while (!lexer_ispunct(token, ')')) {
+            if (lexer_isidentifier(token, "...")) {
+                macro->variadic = true;
+                list_push(macro->parameters, "__VA_ARGS__");
+                token = list_shift(line);
+                if (!lexer_ispunct(token, ')'))
+                    compile_error("expected `)' after `...' in #define %s", name);
+                break;
+            }
+            if (!token || token->type != LEXER_TOKEN_IDENTIFIER)
+                compile_error("expected parameter name in #define %s", name);
+            list_push(macro->parameters, token->string);
+
+            token = list_shift(line);
+            if (lexer_ispunct(token, ','))
+                token = list_shift(line);
+            else if (!lexer_ispunct(token, ')'))
+                compile_error("expected `,' or `)' in #define %s", name);
+        }
+    } else if (token) {
+        list_t *body = list_create();
+        list_push(body, token);
+        lexer_macro_append(body, line);
+        macro->body = body;
+    }
+
+    hashtable_insert(lexer_macros, name, macro);
+}
+
+static void lexer_directive_undef(void) {
+    list_t *line = lexer_line();
+    hashtable_insert(lexer_macros, lexer_directive_name(line, "undef"), NULL);
+}
+
+static char *lexer_include_find(const char *name, bool quoted) {
+    string_t *path = string_create();
+    char     *real;
+
+    if (name[0] == '/')
+        return realpath(name, NULL);
+
+    if (quoted) {
+        string_catf(path, "%s/%s", lexer_file()->directory, name);
+        if ((real = realpath(string_buffer(path), NULL)))
+            return real;
+    }
+
+    for (const char **unit = lexer_unit_paths; unit && *unit; unit++) {
+        path = string_create();
+        string_catf(path, "%s/%s", *unit, name);
+        if ((real = realpath(string_buffer(path), NULL)))
+            return real;
+    }
+
+    for (int i = 0; i < lexer_paths_count; i++) {
+        path = string_create();
+        string_catf(path, "%s/%s", lexer_paths[i], name);
+        if ((real = realpath(string_buffer(path), NULL)))
+            return real;
+    }
+
+    for (size_t i = 0; i < sizeof(lexer_paths_system) / sizeof(*lexer_paths_system); i++) {
+        path = string_create();
+        string_catf(path, "%s/%s", lexer_paths_system[i], name);
+        if ((real = realpath(string_buffer(path), NULL)))
+            return real;
+    }
+    return NULL;
+}
+
+static void lexer_directive_include(void) {
+    list_t        *line  = lexer_line();
+    lexer_token_t *token = list_length(line) ? list_shift(line) : NULL;
+    string_t      *name  = string_create();
+    bool           quoted;
+
+    /* #include MACRO */
+    if (token && token->type == LEXER_TOKEN_IDENTIFIER) {
+        list_t *tokens = list_create();
+        list_push(tokens, token);
+        lexer_macro_append(tokens, line);
+        line  = lexer_expand_all(tokens);
+        token = list_length(line) ? list_shift(line) : NULL;
+    }
+
+    if (token && token->type == LEXER_TOKEN_STRING) {
+        quoted = true;
+        string_catf(name, "%s", token->string);
+    } else if (lexer_ispunct(token, '<')) {
+        quoted = false;
+        while ((token = list_shift(line)) && !lexer_ispunct(token, '>'))
+            string_catf(name, "%s", lexer_tokenstr(token));
+        if (!token)
+            compile_error("expected `>' after #include <%s", string_buffer(name));
+    } else {
+        compile_error("expected \"file\" or <file> after #include");
+        return;
+    }
+
+    char *found = lexer_include_find(string_buffer(name), quoted);
+    if (!found)
+        compile_error("cannot find include file `%s'", string_buffer(name));
+
+    /* realpath hands out memory which isn't pooled */
+    char *path = memory_allocate(strlen(found) + 1);
+    strcpy(path, found);
+    free(found);
+
+    /*
+     * A snapshot stands in for the header it was written from, but
+     * only as the first header of the unit since any header before
+     * could change what it means.
+     */
+    bool first = !lexer_included;
+    lexer_included = true;
+    if (first && snapshot_match(path)) {
+        unsigned long start = lexer_timed ? time_monotonic() : 0;
+        snapshot_load();
+        if (lexer_timed)
+            lexer_statistics.snapshot += time_monotonic() - start;
+        return;
+    }
+
+    char *guard = hashtable_find(lexer_guards, path);
+    if (hashtable_find(lexer_once, path) || (guard && lexer_macro_defined(guard)))
+        return;
+
+    lexer_header_t *header = lexer_header(path);
+    if (!header->size)
+        return;
+
+    FILE *input = fmemopen(header->data, header->size, "r");
+    if (!input)
+        compile_error("cannot allocate input buffer");
+    lexer_file_push(input, path);
+}
+
+static void lexer_directive_pragma(void) {
+    list_t        *line  = lexer_line();
+    lexer_token_t *token = list_length(line) ? list_shift(line) : NULL;
+
+    /* other pragmas are for other compilers */
+    if (lexer_isidentifier(token, "once") && lexer_file()->path)
+        hashtable_insert(lexer_once, lexer_file()->path, lexer_file());
+}
+
+static void lexer_directive_error(void) {
+    compile_error("#error %s", lexer_stringize(lexer_line())->string);
+}
+
+static void lexer_directive_run(void) {
+    lexer_token_t *token = lexer_line_name();
+    lexer_file_t  *file  = lexer_file();
+    bool           start = (file->guard == lexer_guard_start);
+
+    /* a line with only a `#' on it */
+    if (!token)
+        return;
+
+    /* line markers left by another preprocessor */
+    if (token->type == LEXER_TOKEN_NUMBER) {
+        lexer_line();
+        return;
+    }
+
+    if (token->type != LEXER_TOKEN_IDENTIFIER)
+        compile_error("invalid preprocessing directive #%s", lexer_tokenstr(token));
+
+    char *name = token->string;
+    if (!strcmp(name, "ifndef") || !strcmp(name, "ifdef")) {
+        list_t *line  = lexer_line();
+        char   *macro = lexer_directive_name(line, name);
+        bool    taken = lexer_macro_defined(macro) == !strcmp(name, "ifdef");
+
+        if (start && name[2] == 'n') {
+            file->guard = lexer_guard_open;
+            file->macro = macro;
+            file->depth = lexer_conditions;
+        } else {
+            lexer_guard_directive(name, false);
+        }
+        lexer_condition_enter(taken);
+        return;
+    }
+
+    if (!strcmp(name, "if")) {
+        list_t        *line  = lexer_line();
+        list_iterator_t *it  = list_iterator(line);
+        lexer_token_t *first = list_iterator_next(it);
+        lexer_token_t *next  = list_iterator_next(it);
+
+        /* #if !defined(X) guards a header as well as #ifndef X does */
+        if (start && lexer_ispunct(first, '!') && lexer_isidentifier(next, "defined")) {
+            lexer_token_t *macro = list_iterator_next(it);
+            if (lexer_ispunct(macro, '('))
+                macro = list_iterator_next(it);
+            if (macro && macro->type == LEXER_TOKEN_IDENTIFIER) {
+                file->guard = lexer_guard_open;
+                file->macro = macro->string;
+                file->depth = lexer_conditions;
+            } else {
+                lexer_guard_directive(name, false);
+            }
+        } else {
+            lexer_guard_directive(name, false);
+        }
+        lexer_condition_enter(lexer_condition(line));
+        return;
+    }
+
+    if (!strcmp(name, "elif") || !strcmp(name, "else")) {
+        if (!lexer_conditions || lexer_conditions == file->conditions)
+            compile_error("#%s without #if", name);
+        lexer_guard_directive(name, false);
+        lexer_condition_check(lexer_condition_close(), name);
+        lexer_skip_line();
+        lexer_condition_skip(false, name);
+        return;
+    }
+
+    if (!strcmp(name, "endif")) {
+        if (!lexer_conditions || lexer_conditions == file->conditions)
+            compile_error("#endif without #if");
+        lexer_line();
+        lexer_condition_close();
+        lexer_guard_endif();
+        return;
+    }
+
+    lexer_guard_directive(name, false);
+
+    if (!strcmp(name, "define"))
+        lexer_directive_define();
+    else if (!strcmp(name, "undef"))
+        lexer_directive_undef();
+    else if (!strcmp(name, "include"))
+        lexer_directive_include();
+    else if (!strcmp(name, "pragma"))
+        lexer_directive_pragma();
+    else if (!strcmp(name, "error"))
+        lexer_directive_error();
+    else if (!strcmp(name, "line") || !strcmp(name, "warning") || !strcmp(name, "ident"))
+        lexer_line();
+    else
+        compile_error("invalid preprocessing directive #%s", name);
+}
+
+/* predefined text, like scanned text, is not in the file and must not move the position */
+static void lexer_define_text(const char *text) {
+    FILE *input  = fmemopen((void*)text, strlen(text), "r");
+    FILE *saved  = lexer_input;
+    int   line   = lexer_position_line;
+    int   column = lexer_position_column;
+    int   last   = lexer_position_last;
+
+    if (!input)
+        compile_error("cannot allocate input buffer");
+
+    lexer_input = input;
+    lexer_directive_define();
+    lexer_input = saved;
+    fclose(input);
+
+    lexer_position_line   = line;
+    lexer_position_column = column;
+    lexer_position_last   = last;
+}
+
+/* -Dname=value defines name as value, -Dname as 1 */
+static void lexer_define_option(const char *definition) {
+    string_t   *string = string_create();
+    const char *equals = strchr(definition, '=');
+
+    if (!equals)
+        string_catf(string, "%s 1", definition);
+    else
+        string_catf(string, "%.*s %s", (int)(equals - definition), definition, equals + 1);
+    lexer_define_text(string_buffer(string));
+}
+
+void lexer_init(FILE *input, const char *file) {
+    for (int i = 0; i < lexer_mappings_count; i++)
+        munmap(lexer_mappings[i].data, lexer_mappings[i].size);
+    free(lexer_mappings);
+
+    lexer_mappings       = NULL;
+    lexer_mappings_count = 0;
+    lexer_buffer         = list_create();
+    lexer_input          = input;
+    lexer_record         = NULL;
+    lexer_begin          = true;
+    lexer_space          = false;
+    lexer_directive      = false;
+    lexer_files          = list_create();
+    lexer_pending        = list_create();
+    lexer_isolated       = false;
+    lexer_conditions     = 0;
+    lexer_groups         = list_create();
+    lexer_macros         = hashtable_create();
+    lexer_headers        = hashtable_create();
+    lexer_guards         = hashtable_create();
+    lexer_once           = hashtable_create();
+    lexer_included       = false;
+    lexer_names          = list_create();
+    lexer_numbers        = hashtable_create();
+    lexer_statistics     = (lexer_statistics_t){ 0 };
+
+    /* the unit is the first file whatever it is called */
+    char *path = NULL;
+    if (file) {
+        char *real = realpath(file, NULL);
+        path = memory_allocate(strlen(real ? real : file) + 1);
+        strcpy(path, real ? real : file);
+        free(real);
+    }
+    lexer_file_push(input, path);
+    if (file)
+        lexer_file()->directory = lexer_directory(file);
+    else if (lexer_unit_directory)
+        lexer_file()->directory = strcpy(memory_allocate(strlen(lexer_unit_directory) + 1), lexer_unit_directory);
+
+    for (size_t i = 0; i < sizeof(lexer_predefined) / sizeof(*lexer_predefined); i++)
+        lexer_define_text(lexer_predefined[i]);
+
+    for (int i = 0; i < lexer_defines_count; i++)
+        lexer_define_option(lexer_defines[i]);
+    for (const char **unit = lexer_unit_defines; unit && *unit; unit++)
+        lexer_define_option(*unit);
+    lexer_begin = true;
+}
+
+/*
+ * Everything a header leaves behind for the rest of the unit: its
+ * macros, and which headers need not be read again.
+ */
+void lexer_snapshot_save(FILE *output) {
+    list_t *names = list_create();
+
+    for (list_iterator_t *it = list_iterator(hashtable_keys(lexer_macros)); !list_iterator_end(it); ) {
+        char *name = list_iterator_next(it);
+        if (lexer_macro_defined(name))
+            list_push(names, name);
+    }
+
+    snapshot_write_int(output, list_length(names));
+    for (list_iterator_t *it = list_iterator(names); !list_iterator_end(it); ) {
+        char          *name  = list_iterator_next(it);
+        lexer_macro_t *macro = hashtable_find(lexer_macros, name);
+
+        snapshot_write_string(output, name);
+        snapshot_write_int(output, macro->function);
+        snapshot_write_int(output, macro->variadic);
+
+        snapshot_write_int(output, list_length(macro->parameters));
+        for (list_iterator_t *jt = list_iterator(macro->parameters); !list_iterator_end(jt); )
+            snapshot_write_string(output, list_iterator_next(jt));
+
+        snapshot_write_int(output, list_length(macro->body));
+        for (list_iterator_t *jt = list_iterator(macro->body); !list_iterator_end(jt); ) {
+            lexer_token_t *token = list_iterator_next(jt);
+            snapshot_write_int(output, token->type);
+            snapshot_write_int(output, token->space);
+            if (token->type == LEXER_TOKEN_PUNCT)
+                snapshot_write_int(output, token->punct);
+            else if (token->type == LEXER_TOKEN_CHAR)
+                snapshot_write_int(output, token->character);
+            else
+                snapshot_write_string(output, token->string);
+        }
+    }
+
+    list_t *guards = hashtable_keys(lexer_guards);
+    snapshot_write_int(output, list_length(guards));
+    for (list_iterator_t *it = list_iterator(guards); !list_iterator_end(it); ) {
+        char *path = list_iterator_next(it);
+        snapshot_write_string(output, path);
+        snapshot_write_string(output, hashtable_find(lexer_guards, path));
+    }
+
+    list_t *once = hashtable_keys(lexer_once);
+    snapshot_write_int(output, list_length(once));
+    for (list_iterator_t *it = list_iterator(once); !list_iterator_end(it); )
+        snapshot_write_string(output, list_iterator_next(it));
+}
+
+void lexer_snapshot_load(snapshot_t *snapshot) {
+    for (long count = snapshot_read_int(snapshot); count > 0; count--) {
+        char          *name  = snapshot_read_string(snapshot);
+        lexer_macro_t *macro = memory_allocate(sizeof(lexer_macro_t));
+
+        macro->function   = snapshot_read_int(snapshot);
+        macro->variadic   = snapshot_read_int(snapshot);
+        macro->parameters = list_create();
+        macro->body       = list_create();
+
+        for (long parameters = snapshot_read_int(snapshot); parameters > 0; parameters--)
+            list_push(macro->parameters, snapshot_read_string(snapshot));
+
+        for (long tokens = snapshot_read_int(snapshot); tokens > 0; tokens--) {
+            lexer_token_t *token = lexer_token_copy(&(lexer_token_t){
+                .type = snapshot_read_int(snapshot)
+            });
+            token->space = snapshot_read_int(snapshot);
+            if (token->type == LEXER_TOKEN_PUNCT)
+                token->punct = snapshot_read_int(snapshot);
+            else if (token->type == LEXER_TOKEN_CHAR)
+                token->character = snapshot_read_int(snapshot);
+            else
+                token->string = snapshot_read_string(snapshot);
+            list_push(macro->body, token);
+        }
+
+        hashtable_insert(lexer_macros, name, macro);
+    }
+
+    for (long count = snapshot_read_int(snapshot); count > 0; count--) {
+        char *path = snapshot_read_string(snapshot);
+        hashtable_insert(lexer_guards, path, snapshot_read_string(snapshot));
+    }
+
+    for (long count = snapshot_read_int(snapshot); count > 0; count--)
+        hashtable_insert(lexer_once, snapshot_read_string(snapshot), lexer_once);
+}
+
+void lexer_unget(lexer_token_t *token) {
+    if (!token)
+        return;
+    if (lexer_record && list_length(lexer_record) > 0)
+        list_pop(lexer_record);
+    list_push(lexer_buffer, token);
+}
+
+/* tokens put back aren't counted again */
+static lexer_token_t *lexer_expand_counted(void) {
+    unsigned long  start = lexer_timed ? time_monotonic() : 0;
+    lexer_token_t *token = lexer_expand();
+
+    if (lexer_timed)
+        lexer_statistics.time += time_monotonic() - start;
+    if (token)
+        lexer_statistics.tokens++;
+    return token;
+}
+
+lexer_token_t *lexer_next(void) {
+    lexer_token_t *token = (list_length(lexer_buffer) > 0)
+                                ? list_pop(lexer_buffer)
+                                : lexer_expand_counted();
+    if (lexer_record && token)
+        list_push(lexer_record, token);
+    return token;
+}
+
+lexer_token_t *lexer_peek(void) {
+    lexer_token_t *token = lexer_next();
+    lexer_unget(token);
+    return token;
+}
@@ -5,6 +5,10 @@
  *  Implements the interface for LICE's lexer
  */
 #include <stdbool.h>
+#include <stdio.h>
+
+#include "util.h"
+#include "snapshot.h"
 
 /*
  * Type: lexer_token_type_t
@@ -21,6 +25,7 @@
  *    LEXER_TOKEN_CHAR              - Character literal
  *    LEXER_TOKEN_STRING            - String literal
  *    LEXER_TOKEN_NUMBER            - Number (of any type)
+ *    LEXER_TOKEN_NEWLINE           - End of a preprocessing directive
  *    LEXER_TOKEN_EQUAL             - Equal
  *    LEXER_TOKEN_LEQUAL            - Lesser-or-equal
  *    LEXER_TOKEN_GEQUAL            - Greater-or-equal
@@ -41,6 +46,7 @@
  *    LEXER_TOKEN_COMPOUND_RSHIFt   - Compound-assignment right-shift
  *    LEXER_TOKEN_AND               - Logical and
  *    LEXER_TOKEN_OR                - Logical or
+ *    LEXER_TOKEN_PASTE             - Token pasting `##`
  */
 typedef enum {
     LEXER_TOKEN_IDENTIFIER,
@@ -48,6 +54,7 @@ typedef enum {
     LEXER_TOKEN_CHAR,
     LEXER_TOKEN_STRING,
     LEXER_TOKEN_NUMBER,
+    LEXER_TOKEN_NEWLINE,
     LEXER_TOKEN_EQUAL = 0x200,
     LEXER_TOKEN_LEQUAL,
     LEXER_TOKEN_GEQUAL,
@@ -68,7 +75,8 @@ typedef enum {
     LEXER_TOKEN_COMPOUND_LSHIFT,
     LEXER_TOKEN_COMPOUND_RSHIFT,
     LEXER_TOKEN_AND,
-    LEXER_TOKEN_OR
+    LEXER_TOKEN_OR,
+    LEXER_TOKEN_PASTE
 } lexer_token_type_t;
 
 /*
@@ -88,8 +96,83 @@ typedef struct {
         char *string;
         char  character;
     };
+
+    /*
+     * Variable: begin
+     *  The token is the first one on its line
+     */
+    bool begin;
+
+    /*
+     * Variable: space
+     *  The token is preceded by whitespace
+     */
+    bool space;
+
+    /*
+     * Variable: hideset
+     *  Names of the macros the token came out of, which may not be
+     *  expanded again for it.
+     */
+    list_t *hideset;
+
+    /*
+     * Variable: file
+     *  Number of the file the token is in, see <lexer_file_names>
+     */
+    int file;
+
+    /*
+     * Variable: line
+     *  Line the token starts on, counted from one
+     */
+    int line;
+
+    /*
+     * Variable: column
+     *  Column the token starts in, counted from one
+     *
+     * Remarks:
+     *  Tokens which came out of a macro are where the macro was used.
+     */
+    int column;
 } lexer_token_t;
 
+/*
+ * Struct: lexer_statistics_t
+ *  What lexing a translation unit took.
+ */
+typedef struct {
+    /*
+     * Variable: tokens
+     *  Tokens handed to the parser, after preprocessing.
+     */
+    int tokens;
+
+    /*
+     * Variable: time
+     *  Nanoseconds spent reading and preprocessing tokens, only
+     *  measured when <lexer_timed> is set.
+     */
+    unsigned long time;
+
+    /*
+     * Variable: snapshot
+     *  Nanoseconds of <time> spent restoring a snapshot in place of
+     *  a header.
+     */
+    unsigned long snapshot;
+} lexer_statistics_t;
+
+extern COMPILE_LOCAL lexer_statistics_t lexer_statistics;
+
+/*
+ * Variable: lexer_timed
+ *  When true the time spent in the lexer is added up, which costs a
+ *  clock read for every token.
+ */
+extern bool lexer_timed;
+
 /*
  * Function: lexer_islong
  *  Checks for a given string if it's a long-integer-literal.
@@ -143,6 +226,113 @@ bool lexer_isfloat(char *string);
  */
 bool lexer_ispunct(lexer_token_t *token, int c);
 
+/*
+ * Function: lexer_init
+ *  Start reading tokens from the given file.
+ *
+ * Parameters:
+ *  input   - The file to read the translation unit from
+ *  file    - Name of the file, or NULL if it has none
+ *
+ * Remarks:
+ *  Any tokens which were put back and not read again are discarded,
+ *  as are the macros of the previous translation unit. Quoted includes
+ *  are searched for next to *file* first, or in the current directory
+ *  if it has no name.
+ */
+void lexer_init(FILE *input, const char *file);
+
+/*
+ * Function: lexer_include_path
+ *  Add a directory to search for included files in.
+ *
+ * Parameters:
+ *  directory   - The directory to search
+ *
+ * Remarks:
+ *  Directories are searched in the order they were added, before
+ *  the system directories. Must be called before any translation
+ *  unit is compiled since the paths are shared by all of them.
+ */
+void lexer_include_path(const char *directory);
+
+/*
+ * Function: lexer_predefine
+ *  Define a macro in every translation unit.
+ *
+ * Parameters:
+ *  definition  - `name` or `name=value`, like the -D option of cpp
+ *
+ * Remarks:
+ *  Must be called before any translation unit is compiled.
+ */
+void lexer_predefine(const char *definition);
+
+/*
+ * Function: lexer_unit_options
+ *  Set options for the translation units compiled on this thread from
+ *  now on, on top of the ones every unit shares.
+ *
+ * Parameters:
+ *  directory   - Where quoted includes of a unit with no name are
+ *                searched for, or NULL for the current directory
+ *  paths       - Directories to search before those added by
+ *                <lexer_include_path>, terminated by NULL
+ *  defines     - Definitions made after those of <lexer_predefine>,
+ *                terminated by NULL
+ *
+ * Remarks:
+ *  Nothing is copied, the strings must stay around until the options
+ *  are set again. NULL for either array means none.
+ */
+void lexer_unit_options(const char *directory, const char **paths, const char **defines);
+
+/*
+ * Function: lexer_capture
+ *  Record the tokens which are consumed from now on.
+ *
+ * Parameters:
+ *  tokens  - List the tokens are appended to, or NULL to stop
+ *
+ * Remarks:
+ *  A token which is put back is taken off the list again, so the
+ *  list holds exactly the tokens the parser consumed.
+ */
+void lexer_capture(list_t *tokens);
+
+/*
+ * Function: lexer_hash
+ *  Continue a hash over a list of tokens.
+ *
+ * Parameters:
+ *  hash    - The hash of everything before, or HASH_INITIAL
+ *  tokens  - The tokens to hash
+ *
+ * Remarks:
+ *  Only the tokens matter, so whitespace and comments don't change
+ *  the hash.
+ */
+unsigned long lexer_hash(unsigned long hash, list_t *tokens);
+
+/*
+ * Function: lexer_snapshot_save
+ *  Write the macros and the include state of the unit to a snapshot.
+ *
+ * Parameters:
+ *  output  - The snapshot file being written
+ */
+void lexer_snapshot_save(FILE *output);
+
+/*
+ * Function: lexer_snapshot_load
+ *  Restore the macros and the include state written by
+ *  <lexer_snapshot_save>.
+ *
+ * Parameters:
+ *  snapshot    - The snapshot being read
+ */
+void lexer_snapshot_load(snapshot_t *snapshot);
+
 /*
  * Function: lexer_unget
  *  Undo the given token in the token stream.
@@ -159,6 +349,10 @@ void lexer_unget(lexer_token_t *token);
  * Returns:
  *  The next token in the token stream or NULL
  *  on failure or EOF.
+ *
+ * Remarks:
+ *  The stream is preprocessed: directives are carried out as they
+ *  are reached and macros are expanded.
  */
 lexer_token_t *lexer_next(void);
 
@@ -176,6 +370,31 @@ lexer_token_t *lexer_next(void);
  */
 lexer_token_t *lexer_peek(void);
 
+/*
+ * Function: lexer_hash_positions
+ *  Continue a hash over where a list of tokens are.
+ *
+ * Parameters:
+ *  hash    - The hash of everything before, or HASH_INITIAL
+ *  tokens  - The tokens to hash the file, line and column of
+ *
+ * Remarks:
+ *  <lexer_hash> only hashes what the tokens are, code which refers
+ *  to the source lines depends on this too.
+ */
+unsigned long lexer_hash_positions(unsigned long hash, list_t *tokens);
+
+/*
+ * Function: lexer_file_names
+ *  The files the translation unit read so far.
+ *
+ * Returns:
+ *  The paths of the files in the order of their numbers, the first
+ *  is the translation unit itself. One which has no name is called
+ *  `<stdin>'.
+ */
+list_t *lexer_file_names(void);
+
 /*
  * Function: lexer_tokenstr
  *  Convert a token to a human-readable representation
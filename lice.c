@@ -1,13 +1,55 @@
+#define _POSIX_C_SOURCE 200809L /* open_memstream, fmemopen */
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
 #include <stdio.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include "lice.h"
+#include "lexer.h"
+#include "opt.h"
+#include "snapshot.h"
+#include "profile.h"
+
+static bool compile_dump       = false;
+static bool compile_statistics = false;
+
+/* the directory generated functions are kept in across compilations */
+static const char *compile_cache         = NULL;
+static bool        compile_cache_report  = false;
+static int         compile_cache_hits    = 0;
+static int         compile_cache_misses  = 0;
+
+/* where the time goes, --time-report */
+static bool        compile_timed         = false;
+static bool        compile_timed_json    = false;
+static int         compile_timed_top     = 10;
+
+/* where the declarations of a header are written instead of code */
+static const char *compile_snapshot      = NULL;
+
+/* the unit being compiled when there is more than one */
+static COMPILE_LOCAL const char *compile_file = NULL;
+
+/* in server mode errors end the request rather than the process */
+static COMPILE_LOCAL jmp_buf    *compile_recover = NULL;
+static COMPILE_LOCAL char        compile_message[1024];
 
 void compile_error(const char *fmt, ...) {
     va_list  a;
     va_start(a, fmt);
+    if (compile_recover) {
+        vsnprintf(compile_message, sizeof(compile_message), fmt, a);
+        va_end(a);
+        longjmp(*compile_recover, 1);
+    }
+    if (compile_file)
+        fprintf(stderr, "%s: ", compile_file);
     vfprintf(stderr, fmt, a);
     fprintf(stderr, "\n");
     va_end(a);
@@ -15,25 +57,747 @@ void compile_error(const char *fmt, ...) {
     exit(EXIT_FAILURE);
 }
 
-int compile_begin(bool dump) {
-    list_t *block = parse_run();
-    if (!dump) {
-        gen_data_section();
-    }
-    for (list_iterator_t *it = list_iterator(block); !list_iterator_end(it); ) {
-        if (!dump) {
-            gen_function(list_iterator_next(it));
-        } else {
-            printf("%s", ast_string(list_iterator_next(it)));
+static void compile_statistics_print(void) {
+    if (compile_file)
+        fprintf(stderr, "%s:\n", compile_file);
+    fprintf(stderr, "unreachable statements removed:      %d\n", opt_statistics.unreachable);
+    fprintf(stderr, "constant conditions folded:          %d\n", opt_statistics.folded);
+    fprintf(stderr, "unreferenced static symbols dropped: %d\n", opt_statistics.symbols);
+    fprintf(stderr, "recomputations eliminated:           %d\n", opt_statistics.subexpressions);
+    fprintf(stderr, "tail calls:                          %d\n", opt_statistics.tailcalls);
+    fprintf(stderr, "rotates recognised:                  %d\n", opt_statistics.rotates);
+}
+
+/* what generating a single function took */
+typedef struct {
+    char          *name;
+    unsigned long  time;
+    int            instructions;
+    size_t         memory;
+    bool           cached;
+} compile_timing_t;
+
+/*
+ * The pool is never freed within a unit, so what was allocated by the
+ * end of it is the peak. Functions are generated from the pools of
+ * the workers, that is accounted for per function instead.
+ */
+typedef struct {
+    unsigned long     snapshot;
+    unsigned long     lex;
+    unsigned long     parse;
+    unsigned long     optimize;
+    unsigned long     data;
+    unsigned long     codegen;
+    unsigned long     total;
+    int               tokens;
+    int               nodes;
+    int               instructions;
+    size_t            memory;
+    size_t            blocks;
+    compile_timing_t *functions;
+    int               count;
+} compile_report_t;
+
+static int compile_report_compare(const void *a, const void *b) {
+    unsigned long x = ((const compile_timing_t*)a)->time;
+    unsigned long y = ((const compile_timing_t*)b)->time;
+    return (x < y) - (x > y);
+}
+
+static double compile_report_ms(unsigned long time) {
+    return time / 1000000.0;
+}
+
+/* names and paths as JSON strings */
+static void compile_report_string(const char *string) {
+    fputc('"', stderr);
+    for (const unsigned char *p = (const unsigned char*)string; *p; p++) {
+        if (*p == '"' || *p == '\\')
+            fprintf(stderr, "\\%c", *p);
+        else if (*p < 0x20)
+            fprintf(stderr, "\\u%04x", *p);
+        else
+            fputc(*p, stderr);
+    }
+    fputc('"', stderr);
+}
+
+static void compile_report_json(compile_report_t *report, int top) {
+    size_t codegen = 0;
+    for (int i = 0; i < report->count; i++)
+        codegen += report->functions[i].memory;
+
+    fprintf(stderr, "{\"file\":");
+    compile_report_string(compile_file ? compile_file : "<stdin>");
+    fprintf(stderr, ",\"phases\":{\"snapshot\":%.3f,\"lex\":%.3f,\"parse\":%.3f,"
+                    "\"optimize\":%.3f,\"data\":%.3f,\"codegen\":%.3f,\"total\":%.3f}",
+        compile_report_ms(report->snapshot), compile_report_ms(report->lex),
+        compile_report_ms(report->parse),    compile_report_ms(report->optimize),
+        compile_report_ms(report->data),     compile_report_ms(report->codegen),
+        compile_report_ms(report->total));
+    fprintf(stderr, ",\"tokens\":%d,\"nodes\":%d,\"instructions\":%d", report->tokens,
+        report->nodes, report->instructions);
+    fprintf(stderr, ",\"memory\":{\"peak\":%zu,\"blocks\":%zu,\"codegen\":%zu}",
+        report->memory, report->blocks, codegen);
+
+    fprintf(stderr, ",\"functions\":[");
+    for (int i = 0; i < top; i++) {
+        compile_timing_t *timing = &report->functions[i];
+        fprintf(stderr, "%s{\"name\":", i ? "," : "");
+        compile_report_string(timing->name);
+        fprintf(stderr, ",\"time\":%.3f,\"instructions\":%d,\"memory\":%zu,\"cached\":%s}",
+            compile_report_ms(timing->time), timing->instructions, timing->memory,
+            timing->cached ? "true" : "false");
+    }
+    fprintf(stderr, "]}\n");
+}
+
+static void compile_report_print(compile_report_t *report) {
+    int top = MAX(MIN(compile_timed_top, report->count), 0);
+
+    qsort(report->functions, report->count, sizeof(compile_timing_t), &compile_report_compare);
+    if (compile_timed_json) {
+        compile_report_json(report, top);
+        return;
+    }
+
+    size_t codegen = 0;
+    for (int i = 0; i < report->count; i++)
+        codegen += report->functions[i].memory;
+
+    fprintf(stderr, "time report for %s:\n", compile_file ? compile_file : "<stdin>");
+    fprintf(stderr, "  snapshot                  %10.3f ms\n", compile_report_ms(report->snapshot));
+    fprintf(stderr, "  lex and preprocess        %10.3f ms\n", compile_report_ms(report->lex));
+    fprintf(stderr, "  parse                     %10.3f ms\n", compile_report_ms(report->parse));
+    fprintf(stderr, "  optimize                  %10.3f ms\n", compile_report_ms(report->optimize));
+    fprintf(stderr, "  data section              %10.3f ms\n", compile_report_ms(report->data));
+    fprintf(stderr, "  codegen                   %10.3f ms\n", compile_report_ms(report->codegen));
+    fprintf(stderr, "  total                     %10.3f ms\n", compile_report_ms(report->total));
+
+    if (top)
+        fprintf(stderr, "  slowest functions:\n");
+    for (int i = 0; i < top; i++) {
+        compile_timing_t *timing = &report->functions[i];
+        fprintf(stderr, "    %-22s%10.3f ms %8d instructions%s\n", timing->name,
+            compile_report_ms(timing->time), timing->instructions,
+            timing->cached ? " (cached)" : "");
+    }
+
+    fprintf(stderr, "  tokens                    %10d\n", report->tokens);
+    fprintf(stderr, "  ast nodes                 %10d\n", report->nodes);
+    fprintf(stderr, "  instructions              %10d\n", report->instructions);
+    fprintf(stderr, "  peak pool usage           %10zu bytes (%zu in blocks)\n", report->memory, report->blocks);
+    fprintf(stderr, "  codegen pool usage        %10zu bytes\n", codegen);
+}
+
+typedef struct {
+    const char        *file;
+    ast_t            **toplevel;
+    char             **buffers;
+    size_t            *sizes;
+    compile_timing_t  *timings;
+    gen_statistics_t  *statistics;
+} compile_codegen_t;
+
+/*
+ * A cache entry is named by the digest of the function. The compiler
+ * is part of the key too since a rebuilt one may generate different
+ * code for the same tokens, as is the snapshot the unit started from,
+ * the profile the code is instrumented for or laid out by, and whether
+ * it has line tables.
+ */
+static char *compile_cache_path(ast_t *function) {
+    static const char build[] = __DATE__ " " __TIME__;
+    string_t         *path    = string_create();
+    unsigned long     key     = hash_bytes(function->function.digest, build, sizeof(build));
+    unsigned long     start   = snapshot_digest();
+    unsigned long     profile = profile_digest();
+    bool              counted = gen_profile_generate != NULL;
+
+    key = hash_bytes(key, &start, sizeof(start));
+    key = hash_bytes(key, &profile, sizeof(profile));
+    key = hash_bytes(key, &counted, sizeof(counted));
+    key = hash_bytes(key, &gen_debug, sizeof(gen_debug));
+    key = hash_bytes(key, &gen_target, sizeof(gen_target));
+
+    string_catf(path, "%s/%016lx.s", compile_cache, key);
+    return string_buffer(path);
+}
+
+static bool compile_cache_load(const char *path, char **buffer, size_t *size) {
+    FILE  *input = fopen(path, "r");
+    FILE  *output;
+    char   chunk[4096];
+    size_t got;
+
+    if (!input)
+        return false;
+    if (!(output = open_memstream(buffer, size)))
+        compile_error("cannot allocate output buffer");
+
+    while ((got = fread(chunk, 1, sizeof(chunk), input)) > 0)
+        fwrite(chunk, 1, got, output);
+
+    fclose(output);
+    fclose(input);
+    return true;
+}
+
+/*
+ * Entries are written under a name of their own and renamed into
+ * place, so concurrent compilations never see half an entry. Failing
+ * to store one only costs the next compilation a miss.
+ */
+static void compile_cache_store(const char *path, const char *buffer, size_t size) {
+    string_t *temporary = string_create();
+    string_catf(temporary, "%s.%d.%lx", path, (int)getpid(), (unsigned long)pthread_self());
+
+    FILE *output = fopen(string_buffer(temporary), "w");
+    if (!output)
+        return;
+
+    bool wrote = fwrite(buffer, 1, size, output) == size;
+    if (fclose(output) || !wrote || rename(string_buffer(temporary), path))
+        remove(string_buffer(temporary));
+}
+
+static char *compile_codegen_name(ast_t *ast) {
+    if (ast->type == AST_TYPE_FUNCTION)
+        return ast->function.name;
+    return ast->decl.var->variable.name;
+}
+
+/*
+ * Every function and global is generated into a buffer of its own
+ * with labels from a namespace named after it. That makes them
+ * independent of each other and of the order they are generated in,
+ * and lets the code of a function be taken from the cache instead.
+ */
+static void compile_codegen_task(int index, void *data) {
+    compile_codegen_t *codegen = data;
+    ast_t             *ast     = codegen->toplevel[index];
+    compile_timing_t  *timing  = codegen->timings ? &codegen->timings[index] : NULL;
+    char              *path    = NULL;
+    FILE              *output;
+
+    unsigned long start  = timing ? time_monotonic() : 0;
+    size_t        memory = memory_used();
+
+    compile_file = codegen->file;
+    if (timing)
+        timing->name = compile_codegen_name(ast);
+
+    if (compile_cache && ast->type == AST_TYPE_FUNCTION) {
+        path = compile_cache_path(ast);
+        if (compile_cache_load(path, &codegen->buffers[index], &codegen->sizes[index])) {
+            __sync_fetch_and_add(&compile_cache_hits, 1);
+            if (timing) {
+                timing->time   = time_monotonic() - start;
+                timing->cached = true;
+            }
+            return;
+        }
+    }
+
+    if (!(output = open_memstream(&codegen->buffers[index], &codegen->sizes[index])))
+        compile_error("cannot allocate output buffer");
+
+    gen_init(output);
+    ast_label_namespace(compile_codegen_name(ast));
+    gen_function(ast);
+    ast_label_namespace(NULL);
+    fclose(output);
+
+    if (timing) {
+        timing->time         = time_monotonic() - start;
+        timing->instructions = gen_statistics.instructions;
+        timing->memory       = memory_used() - memory;
+    }
+    if (codegen->statistics)
+        codegen->statistics[index] = gen_statistics;
+
+    if (path) {
+        __sync_fetch_and_add(&compile_cache_misses, 1);
+        compile_cache_store(path, codegen->buffers[index], codegen->sizes[index]);
+    }
+}
+
+static void compile_codegen_merge(gen_statistics_t *into, gen_statistics_t *from) {
+    into->instructions += from->instructions;
+    into->memory       += from->memory;
+    into->pushes       += from->pushes;
+    into->pops         += from->pops;
+    into->calls        += from->calls;
+
+    for (int i = 0; i < from->mnemonic_count; i++) {
+        int j;
+        for (j = 0; j < into->mnemonic_count; j++)
+            if (!strcmp(into->mnemonics[j].name, from->mnemonics[i].name))
+                break;
+        if (j == into->mnemonic_count) {
+            if (j == GEN_MNEMONICS)
+                continue;
+            strcpy(into->mnemonics[j].name, from->mnemonics[i].name);
+            into->mnemonic_count++;
+        }
+        into->mnemonics[j].count += from->mnemonics[i].count;
+    }
+}
+
+static int compile_codegen_compare(const void *a, const void *b) {
+    int x = ((const gen_mnemonic_t*)a)->count;
+    int y = ((const gen_mnemonic_t*)b)->count;
+    return (x < y) - (x > y);
+}
+
+static void compile_codegen_row(const char *name, gen_statistics_t *statistics) {
+    fprintf(stderr, "  %-24s%12d %8d %8d %8d %8d\n", name, statistics->instructions,
+        statistics->memory, statistics->pushes, statistics->pops, statistics->calls);
+}
+
+/* functions in source order, then the histogram of the whole unit */
+static void compile_codegen_print(compile_codegen_t *codegen, int count, gen_statistics_t *total) {
+    fprintf(stderr, "codegen statistics for %s:\n", compile_file ? compile_file : "<stdin>");
+    fprintf(stderr, "  %-24s%12s %8s %8s %8s %8s\n", "function", "instructions", "memory",
+        "pushes", "pops", "calls");
+
+    for (int i = 0; i < count; i++) {
+        if (codegen->toplevel[i]->type != AST_TYPE_FUNCTION)
+            continue;
+        if (codegen->timings && codegen->timings[i].cached)
+            fprintf(stderr, "  %-24s%12s\n", compile_codegen_name(codegen->toplevel[i]), "cached");
+        else
+            compile_codegen_row(compile_codegen_name(codegen->toplevel[i]), &codegen->statistics[i]);
+        compile_codegen_merge(total, &codegen->statistics[i]);
+    }
+    compile_codegen_row("total", total);
+
+    qsort(total->mnemonics, total->mnemonic_count, sizeof(gen_mnemonic_t), &compile_codegen_compare);
+    fprintf(stderr, "  mnemonics:\n");
+    for (int i = 0; i < total->mnemonic_count; i++)
+        fprintf(stderr, "    %-12s%10d %6.1f%%\n", total->mnemonics[i].name, total->mnemonics[i].count,
+            100.0 * total->mnemonics[i].count / total->instructions);
+}
+
+/* the buffers are written out in source order whatever order they finish in */
+static void compile_codegen(list_t *block, FILE *output, int workers, compile_report_t *report,
+                            gen_statistics_t *statistics) {
+    int               count   = list_length(block);
+    compile_codegen_t codegen = {
+        .file       = compile_file,
+        .toplevel   = malloc(sizeof(ast_t*) * (count + 1)),
+        .buffers    = calloc(count + 1, sizeof(char*)),
+        .sizes      = calloc(count + 1, sizeof(size_t)),
+        .timings    = report     ? calloc(count + 1, sizeof(compile_timing_t)) : NULL,
+        .statistics = statistics ? calloc(count + 1, sizeof(gen_statistics_t)) : NULL
+    };
+
+    int index = 0;
+    for (list_iterator_t *it = list_iterator(block); !list_iterator_end(it); )
+        codegen.toplevel[index++] = list_iterator_next(it);
+
+    pool_run(workers, count, &compile_codegen_task, &codegen);
+
+    for (int i = 0; i < count; i++) {
+        fwrite(codegen.buffers[i], 1, codegen.sizes[i], output);
+        free(codegen.buffers[i]);
+    }
+
+    if (statistics) {
+        flockfile(stderr);
+        compile_codegen_print(&codegen, count, statistics);
+        funlockfile(stderr);
+    }
+
+    /* declarations are generated too, only functions are reported */
+    if (report) {
+        report->functions = codegen.timings;
+        report->count     = 0;
+        for (int i = 0; i < count; i++) {
+            report->instructions += codegen.timings[i].instructions;
+            if (codegen.toplevel[i]->type == AST_TYPE_FUNCTION)
+                codegen.timings[report->count++] = codegen.timings[i];
         }
     }
+
+    free(codegen.statistics);
+    free(codegen.sizes);
+    free(codegen.buffers);
+    free(codegen.toplevel);
+}
+
+/*
+ * Compiles one translation unit from input to output. Everything the
+ * previous unit on this thread left behind is thrown away first.
+ */
+static void compile_unit(FILE *input, FILE *output, int workers) {
+    compile_report_t report = { 0 };
+    unsigned long    start  = time_monotonic();
+    unsigned long    phase;
+
+    memory_reset();
+    ast_init();
+    lexer_init(input, compile_file);
+    parse_init();
+    gen_init(output);
+
+    phase = time_monotonic();
+    list_t *block = parse_run();
+    report.snapshot = lexer_statistics.snapshot;
+    report.lex      = lexer_statistics.time - report.snapshot;
+    report.parse    = time_monotonic() - phase - lexer_statistics.time;
+    report.tokens   = lexer_statistics.tokens;
+    report.nodes    = ast_nodes;
+
+    if (compile_snapshot) {
+        if (list_length(block))
+            compile_error("only declarations can be precompiled, the header generates code");
+        snapshot_save(compile_snapshot, compile_file);
+        return;
+    }
+    if (compile_dump) {
+        for (list_iterator_t *it = list_iterator(block); !list_iterator_end(it); )
+            fprintf(output, "%s", ast_string(list_iterator_next(it)));
+        return;
+    }
+
+    phase = time_monotonic();
+    block = opt_run(block);
+    report.optimize = time_monotonic() - phase;
+
+    phase = time_monotonic();
+    if (gen_debug)
+        gen_debug_section(lexer_file_names());
+    gen_data_section();
+    report.data         = time_monotonic() - phase;
+    report.instructions = gen_statistics.instructions;
+
+    /* the data section is part of the total */
+    gen_statistics_t statistics = gen_statistics;
+
+    phase = time_monotonic();
+    compile_codegen(block, output, workers, compile_timed ? &report : NULL,
+                    gen_codegen_statistics ? &statistics : NULL);
+    report.codegen = time_monotonic() - phase;
+
+    if (gen_profile_generate) {
+        gen_init(output);
+        gen_profile_section(block);
+    }
+    report.total   = time_monotonic() - start;
+    report.memory  = memory_used();
+    report.blocks  = memory_blocks();
+
+    if (compile_statistics)
+        compile_statistics_print();
+    if (compile_timed) {
+        /* in one piece when units are compiled concurrently */
+        flockfile(stderr);
+        compile_report_print(&report);
+        funlockfile(stderr);
+        free(report.functions);
+    }
+}
+
+/* a.c is compiled to a.s */
+static char *compile_output(const char *file) {
+    size_t length = strlen(file);
+    if (length > 2 && !strcmp(file + length - 2, ".c"))
+        length -= 2;
+
+    char *output = malloc(length + 3);
+    memcpy(output, file, length);
+    strcpy(output + length, ".s");
+    return output;
+}
+
+static void compile_file_unit(const char *file, int workers) {
+    char       *name   = compile_output(file);
+    FILE       *input  = fopen(file, "r");
+    FILE       *output = NULL;
+
+    compile_file = file;
+    if (!input)
+        compile_error("cannot open input");
+
+    /* a header being precompiled has no assembly */
+    if (compile_snapshot)
+        output = stdout;
+    else if (!(output = fopen(name, "w")))
+        compile_error("cannot open output `%s'", name);
+
+    compile_unit(input, output, workers);
+
+    if (output != stdout)
+        fclose(output);
+    fclose(input);
+    free(name);
+    compile_file = NULL;
+}
+
+/* units already run in parallel, their functions don't */
+static void compile_task(int index, void *data) {
+    compile_file_unit(((char**)data)[index], 1);
+}
+
+static bool compile_server_write(int client, const char *data, size_t size) {
+    while (size) {
+        ssize_t wrote = write(client, data, size);
+        if (wrote <= 0)
+            return false;
+        data += wrote;
+        size -= wrote;
+    }
     return true;
 }
 
+/* relative to where the client runs rather than where the server does */
+static char *compile_server_path(const char *directory, const char *name, size_t length) {
+    size_t prefix = (directory && name[0] != '/') ? strlen(directory) + 1 : 0;
+    char  *path   = malloc(prefix + length + 1);
+
+    if (prefix) {
+        strcpy(path, directory);
+        path[prefix - 1] = '/';
+    }
+    memcpy(path + prefix, name, length);
+    path[prefix + length] = '\0';
+    return path;
+}
+
+/*
+ * A request starts with a header of one option per line, ended by an
+ * empty line. `C' is followed by the directory the client runs in,
+ * `F' by the name of the unit, and `I' and `D' by the options of the
+ * same name. The source of the translation unit follows, the client
+ * shuts down its side of the connection to mark the end of it. The
+ * reply is a status byte: '0' followed by the assembly, or '1'
+ * followed by the diagnostic.
+ */
+static void compile_server_request(int client) {
+    char   *source = NULL;
+    size_t  size   = 0;
+    FILE   *stream = open_memstream(&source, &size);
+    char    chunk[4096];
+    ssize_t got;
+
+    while ((got = read(client, chunk, sizeof(chunk))) > 0)
+        fwrite(chunk, 1, got, stream);
+    fclose(stream);
+
+    char  *directory = NULL;
+    char  *file      = NULL;
+    char **paths     = calloc(1, sizeof(char*));
+    char **defines   = calloc(1, sizeof(char*));
+    int    counts[2] = { 0, 0 };
+    size_t header    = 0;
+    bool   complete  = false;
+
+    /* the directory comes first so the paths after it can be made absolute */
+    while (header < size && !complete) {
+        char   *line   = source + header;
+        char   *end    = memchr(line, '\n', size - header);
+        size_t  length = end ? (size_t)(end - line) : size - header;
+
+        header  += length + 1;
+        complete = end && length == 0;
+        if (!end || !length)
+            continue;
+
+        switch (line[0]) {
+            case 'C':
+                free(directory);
+                directory = compile_server_path(NULL, line + 1, length - 1);
+                break;
+            case 'F':
+                free(file);
+                file = compile_server_path(directory, line + 1, length - 1);
+                break;
+            case 'I':
+                paths = realloc(paths, sizeof(char*) * (counts[0] + 2));
+                paths[counts[0]++] = compile_server_path(directory, line + 1, length - 1);
+                paths[counts[0]]   = NULL;
+                break;
+            case 'D':
+                defines = realloc(defines, sizeof(char*) * (counts[1] + 2));
+                defines[counts[1]++] = compile_server_path(NULL, line + 1, length - 1);
+                defines[counts[1]]   = NULL;
+                break;
+        }
+    }
+
+    char    *reply  = NULL;
+    size_t   length = 0;
+    FILE    *input  = (complete && header < size) ? fmemopen(source + header, size - header, "r") : NULL;
+    FILE    *output = open_memstream(&reply, &length);
+    char     status = '0';
+    jmp_buf  recover;
+
+    compile_file = file;
+    lexer_unit_options(directory, (const char**)paths, (const char**)defines);
+
+    /* an empty unit compiles to nothing */
+    compile_recover = &recover;
+    if (!setjmp(recover)) {
+        if (!complete)
+            compile_error("malformed request");
+        if (input)
+            compile_unit(input, output, 1);
+    } else {
+        status = '1';
+    }
+    compile_recover = NULL;
+
+    lexer_unit_options(NULL, NULL, NULL);
+    compile_file = NULL;
+
+    fclose(output);
+    if (input)
+        fclose(input);
+
+    if (compile_server_write(client, &status, 1)) {
+        if (status == '0')
+            compile_server_write(client, reply, length);
+        else
+            compile_server_write(client, compile_message, strlen(compile_message));
+    }
+
+    for (int i = 0; i < counts[0]; i++)
+        free(paths[i]);
+    for (int i = 0; i < counts[1]; i++)
+        free(defines[i]);
+    free(paths);
+    free(defines);
+    free(directory);
+    free(file);
+    free(reply);
+    free(source);
+}
+
+/*
+ * Every worker accepts connections on the same socket and serves
+ * them one at a time, its memory pool stays allocated in between.
+ */
+static void *compile_server_worker(void *data) {
+    int listener = *(int*)data;
+    for (;;) {
+        int client = accept(listener, NULL, NULL);
+        if (client < 0)
+            continue;
+        compile_server_request(client);
+        close(client);
+    }
+    return NULL;
+}
+
+static void compile_server(const char *path, int workers) {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    int                listener;
+
+    if (strlen(path) >= sizeof(address.sun_path))
+        compile_error("socket path `%s' is too long", path);
+    strcpy(address.sun_path, path);
+
+    if ((listener = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        compile_error("cannot create socket");
+    unlink(path);
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(listener, 64) < 0)
+        compile_error("cannot listen on `%s'", path);
+
+    /* a client going away mid reply shouldn't take the server with it */
+    signal(SIGPIPE, SIG_IGN);
+
+    for (int i = 1; i < workers; i++) {
+        pthread_t thread;
+        pthread_create(&thread, NULL, &compile_server_worker, &listener);
+        pthread_detach(thread);
+    }
+    compile_server_worker(&listener);
+}
+
 int main(int argc, char **argv) {
-    argc--;
-    argv++;
-    return compile_begin(!!(argc && !strcmp(*argv, "--dump-ast")))
-            ? EXIT_SUCCESS
-            : EXIT_FAILURE;
+    char **files   = malloc(sizeof(char*) * argc);
+    int    count   = 0;
+    int    workers = 1;
+    char  *server  = NULL;
+
+    for (argc--, argv++; argc; argc--, argv++) {
+        if (!strcmp(*argv, "--dump-ast"))
+            compile_dump = true;
+        else if (!strcmp(*argv, "--opt-stats"))
+            compile_statistics = true;
+        else if (!strcmp(*argv, "--frame-stats"))
+            gen_frame_statistics = true;
+        else if (!strcmp(*argv, "--cache") && argc > 1)
+            argc--, compile_cache = *++argv;
+        else if (!strcmp(*argv, "--cache-stats"))
+            compile_cache_report = true;
+        else if (!strcmp(*argv, "--codegen-stats"))
+            gen_codegen_statistics = true;
+        else if (!strcmp(*argv, "--time-report"))
+            compile_timed = lexer_timed = true;
+        else if (!strcmp(*argv, "--time-report=json"))
+            compile_timed = lexer_timed = compile_timed_json = true;
+        else if (!strcmp(*argv, "--time-report-top") && argc > 1)
+            argc--, compile_timed_top = atoi(*++argv);
+        else if (!strcmp(*argv, "-g"))
+            gen_debug = true;
+        else if (!strncmp(*argv, "-march=", 7)) {
+            if (!gen_target_select(*argv + 7))
+                compile_error("unknown target `%s'", *argv + 7);
+        }
+        else if (!strcmp(*argv, "--profile-generate") && argc > 1)
+            argc--, gen_profile_generate = *++argv;
+        else if (!strcmp(*argv, "--profile-use") && argc > 1)
+            argc--, profile_open(*++argv);
+        else if (!strcmp(*argv, "--pch") && argc > 1)
+            argc--, snapshot_open(*++argv);
+        else if (!strcmp(*argv, "--pch-write") && argc > 1)
+            argc--, compile_snapshot = *++argv;
+        else if (!strcmp(*argv, "--server") && argc > 1)
+            argc--, server = *++argv;
+        else if (!strcmp(*argv, "-I") && argc > 1)
+            argc--, lexer_include_path(*++argv);
+        else if (!strncmp(*argv, "-I", 2))
+            lexer_include_path(*argv + 2);
+        else if (!strcmp(*argv, "-D") && argc > 1)
+            argc--, lexer_predefine(*++argv);
+        else if (!strncmp(*argv, "-D", 2))
+            lexer_predefine(*argv + 2);
+        else if (!strcmp(*argv, "-j") && argc > 1)
+            argc--, workers = atoi(*++argv);
+        else if (!strncmp(*argv, "-j", 2))
+            workers = atoi(*argv + 2);
+        else
+            files[count++] = *argv;
+    }
+
+    atexit(memory_release);
+
+    if (compile_snapshot && count > 1)
+        compile_error("one header at a time can be precompiled");
+
+    /*
+     * Without any files the unit is read from stdin as always. When
+     * there is only the one unit its functions are generated in
+     * parallel instead.
+     */
+    workers = MAX(workers, 1);
+    if (server)
+        compile_server(server, workers);
+    else if (!count)
+        compile_unit(stdin, stdout, workers);
+    else if (count == 1)
+        compile_file_unit(files[0], workers);
+    else
+        pool_run(workers, count, &compile_task, files);
+
+    if (compile_cache_report) {
+        fprintf(stderr, "cache hits:   %d\n", compile_cache_hits);
+        fprintf(stderr, "cache misses: %d\n", compile_cache_misses);
+    }
+
+    free(files);
+    return EXIT_SUCCESS;
 }
@@ -1,5 +1,7 @@
 #ifndef LICE_HDR
 #define LICE_HDR
+#include <stdio.h>
+
 #include "util.h"
 #include "ast.h"
 
@@ -28,8 +30,125 @@
 void compile_error(const char *fmt, ...);
 
 
+/*
+ * Variable: gen_frame_statistics
+ *  When true code generation writes the frame size of every function
+ *  to stderr, next to what it would be without stack slot sharing.
+ */
+extern bool gen_frame_statistics;
+
+/*
+ * Variable: gen_codegen_statistics
+ *  When true the instructions emitted are broken down by mnemonic in
+ *  <gen_statistics>, otherwise only counted.
+ */
+extern bool gen_codegen_statistics;
+
+/*
+ * Variable: gen_debug
+ *  When true code generation says which source line every statement
+ *  came from, for the assembler to build the line table from.
+ */
+extern bool gen_debug;
+
+/*
+ * Variable: gen_profile_generate
+ *  When set every function counts how often it is entered and which
+ *  way its branches go, the program writes the counts to this file
+ *  when it exits.
+ */
+extern const char *gen_profile_generate;
+
+/*
+ * Variable: gen_target
+ *  The instruction set extensions code generation may use, see
+ *  <gen_target_select>.
+ */
+extern int gen_target;
+
+/*
+ * Constant: GEN_MNEMONICS
+ *  Distinct mnemonics counted, the rest are counted as instructions
+ *  only.
+ */
+#define GEN_MNEMONICS 64
+
+/*
+ * Struct: gen_mnemonic_t
+ *  Instructions of one mnemonic which were emitted.
+ */
+typedef struct {
+    char name[16];
+    int  count;
+} gen_mnemonic_t;
+
+/*
+ * Struct: gen_statistics_t
+ *  What code generation emitted.
+ */
+typedef struct {
+    /*
+     * Variable: instructions
+     *  Instructions emitted, directives and labels aren't counted.
+     */
+    int instructions;
+
+    /*
+     * Variable: memory
+     *  Instructions with a memory operand, not counting lea.
+     */
+    int memory;
+
+    /*
+     * Variable: pushes
+     *  Values pushed onto the stack to evaluate expressions.
+     */
+    int pushes;
+
+    /*
+     * Variable: pops
+     *  Values popped off the stack to evaluate expressions.
+     */
+    int pops;
+
+    /*
+     * Variable: calls
+     *  Call instructions.
+     */
+    int calls;
+
+    /*
+     * Variable: mnemonics
+     *  Instructions emitted by mnemonic, in the order they first were.
+     */
+    gen_mnemonic_t mnemonics[GEN_MNEMONICS];
+
+    /*
+     * Variable: mnemonic_count
+     *  Entries of mnemonics in use.
+     */
+    int mnemonic_count;
+} gen_statistics_t;
+
+/*
+ * Variable: gen_statistics
+ *  What was emitted on this thread since the last <gen_init>.
+ */
+extern COMPILE_LOCAL gen_statistics_t gen_statistics;
+
+/*
+ * Variable: parse_typedefs
+ *  The typedef names of the translation unit being parsed.
+ */
+extern COMPILE_LOCAL table_t *parse_typedefs;
+
 /* TODO: eliminate */
+void parse_init(void);
 list_t *parse_run(void);
+void gen_init(FILE *output);
 void gen_data_section(void);
 void gen_function(ast_t *function);
+void gen_profile_section(list_t *toplevel);
+void gen_debug_section(list_t *files);
+bool gen_target_select(const char *name);
 #endif
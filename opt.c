@@ -0,0 +1,1330 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "lice.h"
+#include "opt.h"
+
+COMPILE_LOCAL opt_statistics_t opt_statistics;
+
+/*
+ * Visits every node of a tree in evaluation order, functions which
+ * appear inside of a tree are references and are not descended into.
+ */
+static void opt_walk(ast_t *ast, void (*visit)(ast_t *, void *), void *data);
+
+static void opt_walk_list(list_t *list, void (*visit)(ast_t *, void *), void *data) {
+    if (!list)
+        return;
+    for (list_iterator_t *it = list_iterator(list); !list_iterator_end(it); )
+        opt_walk(list_iterator_next(it), visit, data);
+}
+
+static void opt_walk(ast_t *ast, void (*visit)(ast_t *, void *), void *data) {
+    if (!ast)
+        return;
+
+    visit(ast, data);
+
+    switch (ast->type) {
+        case AST_TYPE_LITERAL:
+        case AST_TYPE_STRING:
+        case AST_TYPE_VAR_GLOBAL:
+        case AST_TYPE_FUNCTION:
+        case AST_TYPE_STATEMENT_CASE:
+        case AST_TYPE_STATEMENT_DEFAULT:
+        case AST_TYPE_STATEMENT_BREAK:
+        case AST_TYPE_STATEMENT_CONTINUE:
+        case AST_TYPE_STATEMENT_GOTO:
+        case AST_TYPE_STATEMENT_LABEL:
+        case AST_TYPE_LABEL_ADDRESS:
+            break;
+
+        case AST_TYPE_VAR_LOCAL:
+            opt_walk_list(ast->variable.init, visit, data);
+            break;
+
+        case AST_TYPE_CALL:
+            opt_walk_list(ast->function.call.args, visit, data);
+            break;
+
+        case AST_TYPE_DECLARATION:
+            opt_walk_list(ast->decl.init, visit, data);
+            break;
+
+        case AST_TYPE_INITIALIZER:
+            opt_walk(ast->init.value, visit, data);
+            break;
+
+        case AST_TYPE_STRUCT:
+            opt_walk(ast->structure, visit, data);
+            break;
+
+        case AST_TYPE_ADDRESS:
+        case AST_TYPE_DEREFERENCE:
+        case AST_TYPE_EXPRESSION_CAST:
+        case AST_TYPE_STATEMENT_GOTO_COMPUTED:
+        case AST_TYPE_POST_INCREMENT:
+        case AST_TYPE_POST_DECREMENT:
+        case AST_TYPE_PRE_INCREMENT:
+        case AST_TYPE_PRE_DECREMENT:
+        case '!':
+        case '~':
+            opt_walk(ast->unary.operand, visit, data);
+            break;
+
+        case AST_TYPE_STATEMENT_IF:
+        case AST_TYPE_EXPRESSION_TERNARY:
+            opt_walk(ast->ifstmt.cond, visit, data);
+            opt_walk(ast->ifstmt.then, visit, data);
+            opt_walk(ast->ifstmt.last, visit, data);
+            break;
+
+        case AST_TYPE_STATEMENT_FOR:
+        case AST_TYPE_STATEMENT_WHILE:
+        case AST_TYPE_STATEMENT_DO:
+            opt_walk(ast->forstmt.init, visit, data);
+            opt_walk(ast->forstmt.cond, visit, data);
+            opt_walk(ast->forstmt.body, visit, data);
+            opt_walk(ast->forstmt.step, visit, data);
+            break;
+
+        case AST_TYPE_STATEMENT_SWITCH:
+            opt_walk(ast->switchstmt.expr, visit, data);
+            opt_walk(ast->switchstmt.body, visit, data);
+            break;
+
+        case AST_TYPE_STATEMENT_RETURN:
+            opt_walk(ast->returnstmt, visit, data);
+            break;
+
+        case AST_TYPE_STATEMENT_COMPOUND:
+            opt_walk_list(ast->compound, visit, data);
+            break;
+
+        default:
+            opt_walk(ast->left,  visit, data);
+            opt_walk(ast->right, visit, data);
+            break;
+    }
+}
+
+/*
+ * Evaluates an integer constant expression, unlike parse_evaluate
+ * this doesn't raise an error when the expression isn't constant.
+ */
+static bool opt_constant(ast_t *ast, long *value) {
+    long left;
+    long right;
+
+    if (!ast)
+        return false;
+
+    switch (ast->type) {
+        case AST_TYPE_LITERAL:
+            if (!ast_type_integer(ast->ctype))
+                return false;
+            *value = ast->integer;
+            return true;
+
+        case AST_TYPE_EXPRESSION_CAST:
+            if (!ast_type_integer(ast->ctype))
+                return false;
+            return opt_constant(ast->unary.operand, value);
+
+        case '!':
+            if (!opt_constant(ast->unary.operand, &left))
+                return false;
+            *value = !left;
+            return true;
+
+        case '~':
+            if (!opt_constant(ast->unary.operand, &left))
+                return false;
+            *value = ~left;
+            return true;
+
+        case AST_TYPE_AND:
+            if (!opt_constant(ast->left, &left))
+                return false;
+            if (!left) {
+                *value = 0;
+                return true;
+            }
+            if (!opt_constant(ast->right, &right))
+                return false;
+            *value = !!right;
+            return true;
+
+        case AST_TYPE_OR:
+            if (!opt_constant(ast->left, &left))
+                return false;
+            if (left) {
+                *value = 1;
+                return true;
+            }
+            if (!opt_constant(ast->right, &right))
+                return false;
+            *value = !!right;
+            return true;
+
+        case '+': case '-': case '*': case '/': case '%':
+        case '<': case '>': case '&': case '|': case '^':
+        case AST_TYPE_LSHIFT: case AST_TYPE_RSHIFT:
+        case AST_TYPE_EQUAL:  case AST_TYPE_NEQUAL:
+        case AST_TYPE_GEQUAL: case AST_TYPE_LEQUAL:
+            if (!ast_type_integer(ast->ctype))
+                return false;
+            if (!opt_constant(ast->left, &left) || !opt_constant(ast->right, &right))
+                return false;
+            break;
+
+        default:
+            return false;
+    }
+
+    switch (ast->type) {
+        case '+':             *value = left +  right; return true;
+        case '-':             *value = left -  right; return true;
+        case '*':             *value = left *  right; return true;
+        case '<':             *value = left <  right; return true;
+        case '>':             *value = left >  right; return true;
+        case '&':             *value = left &  right; return true;
+        case '|':             *value = left |  right; return true;
+        case '^':             *value = left ^  right; return true;
+        case AST_TYPE_LSHIFT: *value = left << right; return true;
+        case AST_TYPE_RSHIFT: *value = left >> right; return true;
+        case AST_TYPE_EQUAL:  *value = left == right; return true;
+        case AST_TYPE_NEQUAL: *value = left != right; return true;
+        case AST_TYPE_GEQUAL: *value = left >= right; return true;
+        case AST_TYPE_LEQUAL: *value = left <= right; return true;
+
+        /* leave the trap for division by zero to runtime */
+        case '/':
+            if (!right)
+                return false;
+            *value = left / right;
+            return true;
+        case '%':
+            if (!right)
+                return false;
+            *value = left % right;
+            return true;
+    }
+    return false;
+}
+
+/*
+ * Dead code elimination
+ *
+ *  Statements which follow a return, break, continue or goto are
+ *  unreachable until the next label which can be jumped to, either by
+ *  goto or through its address; branches
+ *  and loops on constant conditions are folded; static functions and
+ *  variables which nothing references are not emitted at all.
+ */
+static void opt_dead_labelled_visit(ast_t *ast, void *data) {
+    switch (ast->type) {
+        case AST_TYPE_STATEMENT_LABEL:
+            if (!ast->gotostmt.where)
+                break;
+        case AST_TYPE_STATEMENT_CASE:
+        case AST_TYPE_STATEMENT_DEFAULT:
+            *(bool*)data = true;
+            break;
+    }
+}
+
+/* statements which can be entered other than from the top */
+static bool opt_dead_labelled(ast_t *ast) {
+    bool labelled = false;
+    opt_walk(ast, &opt_dead_labelled_visit, &labelled);
+    return labelled;
+}
+
+static ast_t *opt_dead_statement(ast_t *ast, bool *terminates);
+
+static ast_t *opt_dead_compound(ast_t *ast, bool reachable, bool *terminates) {
+    list_t *statements = list_create();
+
+    for (list_iterator_t *it = list_iterator(ast->compound); !list_iterator_end(it); ) {
+        ast_t *statement = list_iterator_next(it);
+        bool   ends      = false;
+
+        if (!statement)
+            continue;
+
+        if (opt_dead_labelled(statement))
+            reachable = true;
+        if (!reachable) {
+            opt_statistics.unreachable++;
+            continue;
+        }
+
+        if ((statement = opt_dead_statement(statement, &ends)))
+            list_push(statements, statement);
+        if (ends)
+            reachable = false;
+    }
+
+    ast->compound = statements;
+    *terminates   = !reachable;
+    return ast;
+}
+
+static ast_t *opt_dead_if(ast_t *ast, bool *terminates) {
+    long  value;
+    bool  then = false;
+    bool  last = false;
+
+    if (opt_constant(ast->ifstmt.cond, &value)) {
+        ast_t *taken   = value ? ast->ifstmt.then : ast->ifstmt.last;
+        ast_t *skipped = value ? ast->ifstmt.last : ast->ifstmt.then;
+
+        if (!opt_dead_labelled(skipped)) {
+            opt_statistics.folded++;
+            return opt_dead_statement(taken, terminates);
+        }
+    }
+
+    ast->ifstmt.then = opt_dead_statement(ast->ifstmt.then, &then);
+    ast->ifstmt.last = opt_dead_statement(ast->ifstmt.last, &last);
+
+    *terminates = ast->ifstmt.then && ast->ifstmt.last && then && last;
+    return ast;
+}
+
+static ast_t *opt_dead_loop(ast_t *ast) {
+    long value;
+    bool ignore;
+
+    if (ast->type != AST_TYPE_STATEMENT_DO && opt_constant(ast->forstmt.cond, &value)) {
+        if (!value && !opt_dead_labelled(ast->forstmt.body)) {
+            opt_statistics.folded++;
+            return ast->forstmt.init;
+        }
+
+        /* while (1) is the same as for (;;) without the test */
+        if (value) {
+            opt_statistics.folded++;
+            ast->type         = AST_TYPE_STATEMENT_FOR;
+            ast->forstmt.cond = NULL;
+        }
+    }
+
+    ast->forstmt.body = opt_dead_statement(ast->forstmt.body, &ignore);
+    return ast;
+}
+
+static ast_t *opt_dead_statement(ast_t *ast, bool *terminates) {
+    bool ignore;
+
+    *terminates = false;
+    if (!ast)
+        return NULL;
+
+    switch (ast->type) {
+        case AST_TYPE_STATEMENT_COMPOUND:
+            return opt_dead_compound(ast, true, terminates);
+
+        case AST_TYPE_STATEMENT_IF:
+            return opt_dead_if(ast, terminates);
+
+        case AST_TYPE_STATEMENT_FOR:
+        case AST_TYPE_STATEMENT_WHILE:
+        case AST_TYPE_STATEMENT_DO:
+            return opt_dead_loop(ast);
+
+        case AST_TYPE_STATEMENT_SWITCH:
+            /* the body is only entered through its case labels */
+            if (ast->switchstmt.body && ast->switchstmt.body->type == AST_TYPE_STATEMENT_COMPOUND)
+                opt_dead_compound(ast->switchstmt.body, false, &ignore);
+            else
+                ast->switchstmt.body = opt_dead_statement(ast->switchstmt.body, &ignore);
+            return ast;
+
+        case AST_TYPE_STATEMENT_RETURN:
+        case AST_TYPE_STATEMENT_BREAK:
+        case AST_TYPE_STATEMENT_CONTINUE:
+        case AST_TYPE_STATEMENT_GOTO:
+        case AST_TYPE_STATEMENT_GOTO_COMPUTED:
+            *terminates = true;
+            return ast;
+    }
+    return ast;
+}
+
+static char *opt_dead_name(ast_t *ast) {
+    return (ast->type == AST_TYPE_FUNCTION)
+                ? ast->function.name
+                : ast->decl.var->variable.name;
+}
+
+static bool opt_dead_static(ast_t *ast) {
+    return (ast->type == AST_TYPE_FUNCTION)
+                ? ast->ctype->isstatic
+                : ast->decl.var->ctype->isstatic;
+}
+
+typedef struct {
+    hashtable_t *statics;
+    hashtable_t *live;
+    list_t      *work;
+} opt_dead_symbols_t;
+
+static void opt_dead_symbols_visit(ast_t *ast, void *data) {
+    opt_dead_symbols_t *symbols = data;
+    char               *name;
+
+    switch (ast->type) {
+        case AST_TYPE_CALL:
+        case AST_TYPE_FUNCTION:
+            name = ast->function.name;
+            break;
+        case AST_TYPE_VAR_GLOBAL:
+            name = ast->variable.name;
+            break;
+        default:
+            return;
+    }
+
+    if (hashtable_find(symbols->live, name))
+        return;
+    hashtable_insert(symbols->live, name, ast);
+
+    list_t *definitions = hashtable_find(symbols->statics, name);
+    if (!definitions)
+        return;
+    for (list_iterator_t *it = list_iterator(definitions); !list_iterator_end(it); )
+        list_push(symbols->work, list_iterator_next(it));
+}
+
+static void opt_dead_symbols_scan(opt_dead_symbols_t *symbols, ast_t *ast) {
+    if (ast->type == AST_TYPE_FUNCTION)
+        opt_walk(ast->function.body, &opt_dead_symbols_visit, symbols);
+    else
+        opt_walk_list(ast->decl.init, &opt_dead_symbols_visit, symbols);
+}
+
+static list_t *opt_dead_symbols(list_t *toplevel) {
+    opt_dead_symbols_t symbols = {
+        .statics = hashtable_create(),
+        .live    = hashtable_create(),
+        .work    = list_create()
+    };
+
+    for (list_iterator_t *it = list_iterator(toplevel); !list_iterator_end(it); ) {
+        ast_t *ast = list_iterator_next(it);
+        if (!opt_dead_static(ast)) {
+            list_push(symbols.work, ast);
+            continue;
+        }
+
+        list_t *definitions = hashtable_find(symbols.statics, opt_dead_name(ast));
+        if (!definitions) {
+            definitions = list_create();
+            hashtable_insert(symbols.statics, opt_dead_name(ast), definitions);
+        }
+        list_push(definitions, ast);
+    }
+
+    while (list_length(symbols.work))
+        opt_dead_symbols_scan(&symbols, list_shift(symbols.work));
+
+    list_t *list = list_create();
+    for (list_iterator_t *it = list_iterator(toplevel); !list_iterator_end(it); ) {
+        ast_t *ast = list_iterator_next(it);
+        if (!opt_dead_static(ast) || hashtable_find(symbols.live, opt_dead_name(ast)))
+            list_push(list, ast);
+        else
+            opt_statistics.symbols++;
+    }
+    return list;
+}
+
+static list_t *opt_dead(list_t *toplevel) {
+    for (list_iterator_t *it = list_iterator(toplevel); !list_iterator_end(it); ) {
+        ast_t *ast = list_iterator_next(it);
+        bool   ignore;
+        if (ast->type == AST_TYPE_FUNCTION)
+            opt_dead_compound(ast->function.body, true, &ignore);
+    }
+    return opt_dead_symbols(toplevel);
+}
+
+/*
+ * Rotates
+ *
+ *  A value shifted left by some amount and right by what that leaves
+ *  of its width, with the two put back together, is rotated. Only an
+ *  unsigned value can be, shifting a signed one right brings in its
+ *  sign, and only a variable since it is evaluated just once after.
+ */
+static bool opt_rotate_same(ast_t *a, ast_t *b) {
+    return a == b && (a->type == AST_TYPE_VAR_LOCAL || a->type == AST_TYPE_VAR_GLOBAL);
+}
+
+static bool opt_rotate_amounts(ast_t *amount, ast_t *rest, int width) {
+    long left;
+    long right;
+
+    if (opt_constant(amount, &left) && opt_constant(rest, &right))
+        return left > 0 && right > 0 && left + right == width;
+
+    return rest->type == '-'
+        && opt_constant(rest->left, &left) && left == width
+        && opt_rotate_same(rest->right, amount);
+}
+
+static void opt_rotate_visit(ast_t *ast, void *data) {
+    if (ast->type != '|' && ast->type != '+' && ast->type != '^')
+        return;
+
+    ast_t *left  = ast->left;
+    ast_t *right = ast->right;
+    if (left->type == AST_TYPE_RSHIFT) {
+        left  = ast->right;
+        right = ast->left;
+    }
+    if (left->type != AST_TYPE_LSHIFT || right->type != AST_TYPE_RSHIFT)
+        return;
+    if (!opt_rotate_same(left->left, right->left))
+        return;
+
+    data_type_t *type  = left->left->ctype;
+    int          width = type->size * 8;
+    if (!ast_type_integer(type) || type->sign || (width != 32 && width != 64))
+        return;
+
+    if (opt_rotate_amounts(left->right, right->right, width)) {
+        ast->type  = AST_TYPE_ROTATE_LEFT;
+        ast->right = left->right;
+    } else if (opt_rotate_amounts(right->right, left->right, width)) {
+        ast->type  = AST_TYPE_ROTATE_RIGHT;
+        ast->right = right->right;
+    } else {
+        return;
+    }
+
+    ast->ctype = type;
+    ast->left  = left->left;
+    opt_statistics.rotates++;
+}
+
+static void opt_rotate(list_t *toplevel) {
+    for (list_iterator_t *it = list_iterator(toplevel); !list_iterator_end(it); ) {
+        ast_t *ast = list_iterator_next(it);
+        if (ast->type == AST_TYPE_FUNCTION)
+            opt_walk(ast->function.body, &opt_rotate_visit, NULL);
+    }
+}
+
+/*
+ * Common subexpression elimination
+ *
+ *  Local value numbering over the structured control flow: every pure
+ *  expression evaluated is remembered as available until a store or
+ *  call may change what it reads. When the same expression is computed
+ *  again while available, its first evaluation is made to save the
+ *  value in a temporary and the recomputation becomes a reload of it.
+ *  The branches of an if and the body of a loop start with what is
+ *  available before them, so the reuse is scoped by dominance; labels
+ *  can be reached from anywhere and forget everything.
+ */
+typedef struct {
+    ast_t        *value;
+    ast_t       **site;
+    ast_t        *temporary;
+    list_t       *variables;
+    bool          memory;
+    bool          killed;
+    unsigned int  hash;
+} opt_cse_entry_t;
+
+/*
+ * What is available is found by its hash, and indexed by the variables
+ * it reads and whether it reads memory so that a store only has to
+ * look at what it changes. A branch starts a table of its own on top
+ * of the one before it. What the branch stores to is forgotten for the
+ * entries from before by noting it in the branch rather than by taking
+ * them out, as they are still available once the branch is over.
+ */
+typedef struct opt_cse_table_s opt_cse_table_t;
+
+struct opt_cse_table_s {
+    opt_cse_table_t *parent;
+    hashtable_t     *values;
+    hashtable_t     *readers;
+    list_t          *memory;
+    hashtable_t     *forgotten;
+    bool             forgotten_memory;
+};
+
+static COMPILE_LOCAL ast_t       *opt_cse_function  = NULL;
+static COMPILE_LOCAL hashtable_t *opt_cse_addressed = NULL;
+
+static opt_cse_table_t *opt_cse_table(opt_cse_table_t *parent) {
+    opt_cse_table_t *table  = memory_allocate(sizeof(opt_cse_table_t));
+    table->parent           = parent;
+    table->values           = hashtable_create();
+    table->readers          = hashtable_create();
+    table->memory           = list_create();
+    table->forgotten        = hashtable_create();
+    table->forgotten_memory = false;
+    return table;
+}
+
+static void opt_cse_clear(opt_cse_table_t *table) {
+    *table = *opt_cse_table(NULL);
+}
+
+static char *opt_cse_key(unsigned int hash) {
+    string_t *key = string_create();
+    string_catf(key, "%x", hash);
+    return string_buffer(key);
+}
+
+/*
+ * Locals which have their address taken (and arrays) live in memory
+ * which can be written through any pointer.
+ */
+static bool opt_cse_memory_variable(ast_t *var) {
+    return var->ctype->type == TYPE_ARRAY
+        || hashtable_find(opt_cse_addressed, var->variable.name);
+}
+
+/* the address of a member is one into the variable it is a member of */
+static void opt_cse_addressed_visit(ast_t *ast, void *data) {
+    if (ast->type != AST_TYPE_ADDRESS)
+        return;
+
+    ast_t *base = ast->unary.operand;
+    while (base->type == AST_TYPE_STRUCT)
+        base = base->structure;
+    if (base->type == AST_TYPE_VAR_LOCAL)
+        hashtable_insert(opt_cse_addressed, base->variable.name, ast);
+}
+
+static void opt_cse_impure_visit(ast_t *ast, void *data) {
+    switch (ast->type) {
+        case '=':
+        case AST_TYPE_CALL:
+        case AST_TYPE_POST_INCREMENT:
+        case AST_TYPE_POST_DECREMENT:
+        case AST_TYPE_PRE_INCREMENT:
+        case AST_TYPE_PRE_DECREMENT:
+        case AST_TYPE_DECLARATION:
+            *(bool*)data = true;
+            break;
+
+        /* compound literals are stored on first use */
+        case AST_TYPE_VAR_LOCAL:
+            if (ast->variable.init)
+                *(bool*)data = true;
+            break;
+    }
+}
+
+static bool opt_cse_candidate(ast_t *ast) {
+    bool impure = false;
+
+    if (!ast->ctype)
+        return false;
+
+    switch (ast->ctype->type) {
+        case TYPE_CHAR:
+        case TYPE_SHORT:
+        case TYPE_INT:
+        case TYPE_LONG:
+        case TYPE_LLONG:
+        case TYPE_POINTER:
+        case TYPE_DOUBLE:
+            break;
+        default:
+            return false;
+    }
+
+    switch (ast->type) {
+        case AST_TYPE_DEREFERENCE:
+        case AST_TYPE_STRUCT:
+        case '!': case '~':
+        case AST_TYPE_POPCOUNT: case AST_TYPE_CLZ:
+        case AST_TYPE_CTZ:      case AST_TYPE_BSWAP:
+        case AST_TYPE_ROTATE_LEFT: case AST_TYPE_ROTATE_RIGHT:
+        case '+': case '-': case '*': case '/': case '%':
+        case '<': case '>': case '&': case '|': case '^':
+        case AST_TYPE_LSHIFT: case AST_TYPE_RSHIFT:
+        case AST_TYPE_EQUAL:  case AST_TYPE_NEQUAL:
+        case AST_TYPE_GEQUAL: case AST_TYPE_LEQUAL:
+            break;
+        default:
+            return false;
+    }
+
+    opt_walk(ast, &opt_cse_impure_visit, &impure);
+    return !impure;
+}
+
+static ast_t *opt_cse_strip(ast_t *ast) {
+    while (ast && (ast->type == AST_TYPE_EXPRESSION_SAVE || ast->type == AST_TYPE_EXPRESSION_RELOAD))
+        ast = ast->right;
+    return ast;
+}
+
+static bool opt_cse_type_equal(data_type_t *a, data_type_t *b) {
+    if (a == b)
+        return true;
+    if (!a || !b || a->type != b->type || a->size != b->size || a->sign != b->sign)
+        return false;
+    if (a->type == TYPE_POINTER || a->type == TYPE_ARRAY)
+        return opt_cse_type_equal(a->pointer, b->pointer);
+    return a->type != TYPE_STRUCTURE && a->type != TYPE_FUNCTION;
+}
+
+static bool opt_cse_equal(ast_t *a, ast_t *b) {
+    a = opt_cse_strip(a);
+    b = opt_cse_strip(b);
+
+    if (a == b)
+        return true;
+    if (!a || !b || a->type != b->type || !opt_cse_type_equal(a->ctype, b->ctype))
+        return false;
+
+    switch (a->type) {
+        case AST_TYPE_LITERAL:
+            if (ast_type_integer(a->ctype))
+                return a->integer == b->integer;
+            return !memcmp(&a->floating.value, &b->floating.value, sizeof(double));
+
+        case AST_TYPE_VAR_GLOBAL:
+            return !strcmp(a->variable.name, b->variable.name);
+
+        case AST_TYPE_STRUCT:
+            return !strcmp(a->field, b->field)
+                && opt_cse_equal(a->structure, b->structure);
+
+        case AST_TYPE_ADDRESS:
+        case AST_TYPE_DEREFERENCE:
+        case AST_TYPE_EXPRESSION_CAST:
+        case AST_TYPE_POPCOUNT:
+        case AST_TYPE_CLZ:
+        case AST_TYPE_CTZ:
+        case AST_TYPE_BSWAP:
+        case '!':
+        case '~':
+            return opt_cse_equal(a->unary.operand, b->unary.operand);
+
+        case AST_TYPE_EXPRESSION_TERNARY:
+            return opt_cse_equal(a->ifstmt.cond, b->ifstmt.cond)
+                && opt_cse_equal(a->ifstmt.then, b->ifstmt.then)
+                && opt_cse_equal(a->ifstmt.last, b->ifstmt.last);
+
+        case AST_TYPE_AND:    case AST_TYPE_OR:
+        case '+': case '-': case '*': case '/': case '%':
+        case '<': case '>': case '&': case '|': case '^':
+        case AST_TYPE_LSHIFT: case AST_TYPE_RSHIFT:
+        case AST_TYPE_EQUAL:  case AST_TYPE_NEQUAL:
+        case AST_TYPE_GEQUAL: case AST_TYPE_LEQUAL:
+        case AST_TYPE_ROTATE_LEFT: case AST_TYPE_ROTATE_RIGHT:
+            return opt_cse_equal(a->left,  b->left)
+                && opt_cse_equal(a->right, b->right);
+    }
+
+    /* variables are shared by all their uses, so only identity counts */
+    return false;
+}
+
+static unsigned int opt_cse_hash(ast_t *ast) {
+    unsigned int hash;
+
+    if (!(ast = opt_cse_strip(ast)))
+        return 0;
+
+    hash = ast->type;
+    switch (ast->type) {
+        case AST_TYPE_STRING:
+        case AST_TYPE_FUNCTION:
+            return hash;
+        case AST_TYPE_LITERAL:
+            return hash * 31 + (unsigned int)ast->integer;
+        case AST_TYPE_VAR_LOCAL:
+        case AST_TYPE_VAR_GLOBAL:
+            for (const char *p = ast->variable.name; *p; p++)
+                hash = hash * 31 + *p;
+            return hash;
+        case AST_TYPE_STRUCT:
+            return hash * 31 + opt_cse_hash(ast->structure);
+        case AST_TYPE_ADDRESS:
+        case AST_TYPE_DEREFERENCE:
+        case AST_TYPE_EXPRESSION_CAST:
+        case AST_TYPE_POPCOUNT:
+        case AST_TYPE_CLZ:
+        case AST_TYPE_CTZ:
+        case AST_TYPE_BSWAP:
+        case '!':
+        case '~':
+            return hash * 31 + opt_cse_hash(ast->unary.operand);
+        case AST_TYPE_EXPRESSION_TERNARY:
+            return hash * 31 + opt_cse_hash(ast->ifstmt.cond);
+    }
+    return (hash * 31 + opt_cse_hash(ast->left)) * 31 + opt_cse_hash(ast->right);
+}
+
+static void opt_cse_reads_visit(ast_t *ast, void *data) {
+    opt_cse_entry_t *entry = data;
+
+    switch (ast->type) {
+        case AST_TYPE_VAR_LOCAL:
+            /* an array's value is its address which never changes */
+            if (ast->ctype->type == TYPE_ARRAY)
+                break;
+            if (opt_cse_memory_variable(ast))
+                entry->memory = true;
+            else
+                list_push(entry->variables, ast);
+            break;
+
+        case AST_TYPE_VAR_GLOBAL:
+        case AST_TYPE_DEREFERENCE:
+            entry->memory = true;
+            break;
+    }
+}
+
+static list_t *opt_cse_list(hashtable_t *table, char *key) {
+    list_t *list = hashtable_find(table, key);
+    if (!list)
+        hashtable_insert(table, key, (list = list_create()));
+    return list;
+}
+
+static void opt_cse_record(opt_cse_table_t *table, ast_t **site) {
+    if (!site || !opt_cse_candidate(*site))
+        return;
+
+    opt_cse_entry_t *entry = memory_allocate(sizeof(opt_cse_entry_t));
+    entry->value           = *site;
+    entry->site            = site;
+    entry->temporary       = NULL;
+    entry->variables       = list_create();
+    entry->memory          = false;
+    entry->killed          = false;
+    entry->hash            = opt_cse_hash(*site);
+
+    opt_walk(*site, &opt_cse_reads_visit, entry);
+
+    list_push(opt_cse_list(table->values, opt_cse_key(entry->hash)), entry);
+    for (list_iterator_t *it = list_iterator(entry->variables); !list_iterator_end(it); )
+        list_push(opt_cse_list(table->readers, ((ast_t*)list_iterator_next(it))->variable.name), entry);
+    if (entry->memory)
+        list_push(table->memory, entry);
+}
+
+/* an entry of a table further out is gone when a branch since stored to what it reads */
+static bool opt_cse_forgotten(opt_cse_table_t *table, opt_cse_table_t *owner, opt_cse_entry_t *entry) {
+    for (; table != owner; table = table->parent) {
+        if (entry->memory && table->forgotten_memory)
+            return true;
+        for (list_iterator_t *it = list_iterator(entry->variables); !list_iterator_end(it); )
+            if (hashtable_find(table->forgotten, ((ast_t*)list_iterator_next(it))->variable.name))
+                return true;
+    }
+    return false;
+}
+
+/* killed entries are dropped from their bucket once they are come across */
+static list_t *opt_cse_live(hashtable_t *values, char *key, list_t *entries) {
+    bool killed = false;
+    for (list_iterator_t *it = list_iterator(entries); !killed && !list_iterator_end(it); )
+        killed = ((opt_cse_entry_t*)list_iterator_next(it))->killed;
+    if (!killed)
+        return entries;
+
+    list_t *live = list_create();
+    for (list_iterator_t *it = list_iterator(entries); !list_iterator_end(it); ) {
+        opt_cse_entry_t *entry = list_iterator_next(it);
+        if (!entry->killed)
+            list_push(live, entry);
+    }
+    hashtable_insert(values, key, live);
+    return live;
+}
+
+static opt_cse_entry_t *opt_cse_find(opt_cse_table_t *table, ast_t *ast) {
+    unsigned int  hash = opt_cse_hash(ast);
+    char         *key  = opt_cse_key(hash);
+
+    for (opt_cse_table_t *owner = table; owner; owner = owner->parent) {
+        list_t *entries = hashtable_find(owner->values, key);
+        if (!entries)
+            continue;
+
+        entries = opt_cse_live(owner->values, key, entries);
+
+        for (list_iterator_t *it = list_iterator(entries); !list_iterator_end(it); ) {
+            opt_cse_entry_t *entry = list_iterator_next(it);
+            if (entry->hash == hash && opt_cse_equal(entry->value, ast) && !opt_cse_forgotten(table, owner, entry))
+                return entry;
+        }
+    }
+    return NULL;
+}
+
+static void opt_cse_reuse(opt_cse_entry_t *entry, ast_t **site) {
+    if (!entry->temporary) {
+        data_type_t *type = ast_type_floating(entry->value->ctype)
+                                ? ast_data_table[AST_DATA_DOUBLE]
+                                : ast_data_table[AST_DATA_LONG];
+
+        entry->temporary = ast_variable_local(type, "__cse");
+        list_push(opt_cse_function->function.locals, entry->temporary);
+        *entry->site = ast_save(entry->temporary, *entry->site);
+    }
+    *site = ast_reload(entry->temporary, *site);
+    opt_statistics.subexpressions++;
+}
+
+static void opt_cse_kill_entries(list_t *entries) {
+    for (list_iterator_t *it = list_iterator(entries); !list_iterator_end(it); )
+        ((opt_cse_entry_t*)list_iterator_next(it))->killed = true;
+}
+
+/* forget everything which reads a variable, or reads memory when NULL */
+static void opt_cse_kill(opt_cse_table_t *table, ast_t *var) {
+    if (!var) {
+        opt_cse_kill_entries(table->memory);
+        table->memory           = list_create();
+        table->forgotten_memory = (table->parent != NULL);
+        return;
+    }
+
+    char *name = var->variable.name;
+    if (hashtable_find(table->readers, name)) {
+        opt_cse_kill_entries(hashtable_find(table->readers, name));
+        hashtable_insert(table->readers, name, list_create());
+    }
+    if (table->parent)
+        hashtable_insert(table->forgotten, name, var);
+}
+
+static void opt_cse_kill_store(opt_cse_table_t *table, ast_t *lvalue) {
+    ast_t *base = lvalue;
+    while (base->type == AST_TYPE_STRUCT)
+        base = base->structure;
+
+    if (base->type == AST_TYPE_VAR_LOCAL && !opt_cse_memory_variable(base))
+        opt_cse_kill(table, base);
+    else
+        opt_cse_kill(table, NULL);
+}
+
+static void opt_cse_kill_visit(ast_t *ast, void *data) {
+    opt_cse_table_t *table = data;
+
+    switch (ast->type) {
+        case '=':
+            opt_cse_kill_store(table, ast->left);
+            break;
+        case AST_TYPE_POST_INCREMENT:
+        case AST_TYPE_POST_DECREMENT:
+        case AST_TYPE_PRE_INCREMENT:
+        case AST_TYPE_PRE_DECREMENT:
+            opt_cse_kill_store(table, ast->unary.operand);
+            break;
+        case AST_TYPE_DECLARATION:
+            opt_cse_kill_store(table, ast->decl.var);
+            break;
+        case AST_TYPE_VAR_LOCAL:
+            if (ast->variable.init)
+                opt_cse_kill_store(table, ast);
+            break;
+        case AST_TYPE_CALL:
+            opt_cse_kill(table, NULL);
+            break;
+    }
+}
+
+/* forget everything a piece of code which may or may not run could change */
+static void opt_cse_kill_code(opt_cse_table_t *table, ast_t *ast) {
+    opt_walk(ast, &opt_cse_kill_visit, table);
+}
+
+static void opt_cse_jumped_visit(ast_t *ast, void *data) {
+    if (ast->type == AST_TYPE_STATEMENT_LABEL && ast->gotostmt.where)
+        *(bool*)data = true;
+}
+
+/* statements which goto can enter other than from the top */
+static bool opt_cse_jumped(ast_t *ast) {
+    bool jumped = false;
+    opt_walk(ast, &opt_cse_jumped_visit, &jumped);
+    return jumped;
+}
+
+static void opt_cse_expression(opt_cse_table_t *table, ast_t **site);
+
+/* a compound assignment is the assignment of an operation on itself */
+static bool opt_cse_compound(ast_t *ast) {
+    switch (ast->right->type) {
+        case '+': case '-': case '*': case '/': case '%':
+        case '&': case '|': case '^':
+        case AST_TYPE_LSHIFT: case AST_TYPE_RSHIFT:
+            return ast->right->left == ast->left;
+    }
+    return false;
+}
+
+/* an assigned location is only evaluated for its address */
+static void opt_cse_lvalue(opt_cse_table_t *table, ast_t *lvalue) {
+    while (lvalue->type == AST_TYPE_STRUCT)
+        lvalue = lvalue->structure;
+    if (lvalue->type == AST_TYPE_DEREFERENCE)
+        opt_cse_expression(table, &lvalue->unary.operand);
+}
+
+static void opt_cse_expression(opt_cse_table_t *table, ast_t **site) {
+    ast_t           *ast = *site;
+    opt_cse_entry_t *entry;
+
+    if (!ast)
+        return;
+
+    if (opt_cse_candidate(ast) && (entry = opt_cse_find(table, ast))) {
+        opt_cse_reuse(entry, site);
+        return;
+    }
+
+    switch (ast->type) {
+        case AST_TYPE_LITERAL:
+        case AST_TYPE_STRING:
+        case AST_TYPE_VAR_LOCAL:
+        case AST_TYPE_VAR_GLOBAL:
+        case AST_TYPE_FUNCTION:
+        case AST_TYPE_LABEL_ADDRESS:
+        case AST_TYPE_EXPRESSION_SAVE:
+        case AST_TYPE_EXPRESSION_RELOAD:
+            break;
+
+        case '=':
+            /*
+             * A compound assignment shares the assigned location with
+             * the left of the operation, which is evaluated first.
+             */
+            if (opt_cse_compound(ast)) {
+                opt_cse_lvalue(table, ast->left);
+                if (opt_cse_candidate(ast->right) && (entry = opt_cse_find(table, ast->right)))
+                    opt_cse_reuse(entry, &ast->right);
+                else {
+                    opt_cse_expression(table, &ast->right->right);
+                    opt_cse_record(table, &ast->right);
+                }
+            } else {
+                opt_cse_expression(table, &ast->right);
+                opt_cse_lvalue(table, ast->left);
+            }
+            opt_cse_kill_store(table, ast->left);
+            return;
+
+        case AST_TYPE_POST_INCREMENT:
+        case AST_TYPE_POST_DECREMENT:
+        case AST_TYPE_PRE_INCREMENT:
+        case AST_TYPE_PRE_DECREMENT:
+            opt_cse_lvalue(table, ast->unary.operand);
+            opt_cse_kill_store(table, ast->unary.operand);
+            return;
+
+        case AST_TYPE_CALL:
+            for (list_iterator_t *it = list_iterator(ast->function.call.args); !list_iterator_end(it); ) {
+                list_iterator_next(it);
+                opt_cse_expression(table, (ast_t**)list_iterator_site(it));
+            }
+            opt_cse_kill(table, NULL);
+            return;
+
+        case AST_TYPE_AND:
+        case AST_TYPE_OR:
+            opt_cse_expression(table, &ast->left);
+            opt_cse_expression(opt_cse_table(table), &ast->right);
+            opt_cse_kill_code(table, ast->right);
+            break;
+
+        case AST_TYPE_EXPRESSION_TERNARY:
+            opt_cse_expression(table, &ast->ifstmt.cond);
+            opt_cse_expression(opt_cse_table(table), &ast->ifstmt.then);
+            opt_cse_expression(opt_cse_table(table), &ast->ifstmt.last);
+            opt_cse_kill_code(table, ast->ifstmt.then);
+            opt_cse_kill_code(table, ast->ifstmt.last);
+            break;
+
+        case AST_TYPE_ADDRESS:
+            if (ast->unary.operand->type == AST_TYPE_DEREFERENCE)
+                opt_cse_expression(table, &ast->unary.operand->unary.operand);
+            break;
+
+        case AST_TYPE_DEREFERENCE:
+        case AST_TYPE_EXPRESSION_CAST:
+        case '!':
+        case '~':
+            opt_cse_expression(table, &ast->unary.operand);
+            break;
+
+        case AST_TYPE_STRUCT:
+            opt_cse_expression(table, &ast->structure);
+            break;
+
+        default:
+            opt_cse_expression(table, &ast->left);
+            opt_cse_expression(table, &ast->right);
+            break;
+    }
+
+    opt_cse_record(table, site);
+}
+
+static void opt_cse_statement(opt_cse_table_t *table, ast_t **site) {
+    ast_t           *ast = *site;
+    opt_cse_table_t *inner;
+
+    if (!ast)
+        return;
+
+    switch (ast->type) {
+        case AST_TYPE_STATEMENT_COMPOUND:
+            for (list_iterator_t *it = list_iterator(ast->compound); !list_iterator_end(it); ) {
+                list_iterator_next(it);
+                opt_cse_statement(table, (ast_t**)list_iterator_site(it));
+            }
+            break;
+
+        case AST_TYPE_STATEMENT_LABEL:
+        case AST_TYPE_STATEMENT_CASE:
+        case AST_TYPE_STATEMENT_DEFAULT:
+            opt_cse_clear(table);
+            break;
+
+        case AST_TYPE_STATEMENT_GOTO:
+        case AST_TYPE_STATEMENT_BREAK:
+        case AST_TYPE_STATEMENT_CONTINUE:
+            break;
+
+        case AST_TYPE_STATEMENT_GOTO_COMPUTED:
+            opt_cse_expression(table, &ast->unary.operand);
+            break;
+
+        case AST_TYPE_DECLARATION:
+            if (ast->decl.init) {
+                for (list_iterator_t *it = list_iterator(ast->decl.init); !list_iterator_end(it); ) {
+                    ast_t *init = list_iterator_next(it);
+                    opt_cse_expression(table, &init->init.value);
+                }
+            }
+            opt_cse_kill_store(table, ast->decl.var);
+            break;
+
+        case AST_TYPE_STATEMENT_RETURN:
+            opt_cse_expression(table, &ast->returnstmt);
+            break;
+
+        case AST_TYPE_STATEMENT_IF:
+            opt_cse_expression(table, &ast->ifstmt.cond);
+            opt_cse_statement(opt_cse_table(table), &ast->ifstmt.then);
+            opt_cse_statement(opt_cse_table(table), &ast->ifstmt.last);
+            opt_cse_kill_code(table, ast->ifstmt.then);
+            opt_cse_kill_code(table, ast->ifstmt.last);
+            if (opt_dead_labelled(ast))
+                opt_cse_clear(table);
+            break;
+
+        case AST_TYPE_STATEMENT_FOR:
+        case AST_TYPE_STATEMENT_WHILE:
+        case AST_TYPE_STATEMENT_DO:
+            opt_cse_statement(table, &ast->forstmt.init);
+
+            /* what is available must survive every iteration */
+            opt_cse_kill_code(table, ast->forstmt.cond);
+            opt_cse_kill_code(table, ast->forstmt.body);
+            opt_cse_kill_code(table, ast->forstmt.step);
+            if (opt_dead_labelled(ast))
+                opt_cse_clear(table);
+
+            if (ast->type == AST_TYPE_STATEMENT_DO) {
+                opt_cse_statement(opt_cse_table(table), &ast->forstmt.body);
+                opt_cse_expression(opt_cse_table(table), &ast->forstmt.cond);
+                break;
+            }
+
+            /* continue goes straight to the step */
+            inner = opt_cse_table(table);
+            opt_cse_expression(inner, &ast->forstmt.cond);
+            opt_cse_statement(opt_cse_table(inner), &ast->forstmt.body);
+            opt_cse_expression(opt_cse_table(inner), &ast->forstmt.step);
+            break;
+
+        case AST_TYPE_STATEMENT_SWITCH:
+            opt_cse_expression(table, &ast->switchstmt.expr);
+            opt_cse_statement(opt_cse_table(table), &ast->switchstmt.body);
+            opt_cse_kill_code(table, ast->switchstmt.body);
+
+            /* case labels are only reached from the switch itself */
+            if (opt_cse_jumped(ast->switchstmt.body))
+                opt_cse_clear(table);
+            break;
+
+        default:
+            opt_cse_expression(table, site);
+            break;
+    }
+}
+
+static void opt_cse(list_t *toplevel) {
+    for (list_iterator_t *it = list_iterator(toplevel); !list_iterator_end(it); ) {
+        ast_t *ast = list_iterator_next(it);
+        if (ast->type != AST_TYPE_FUNCTION)
+            continue;
+
+        opt_cse_function  = ast;
+        opt_cse_addressed = hashtable_create();
+        opt_walk(ast->function.body, &opt_cse_addressed_visit, NULL);
+        opt_cse_statement(opt_cse_table(NULL), &ast->function.body);
+    }
+    opt_cse_function  = NULL;
+    opt_cse_addressed = NULL;
+}
+
+/*
+ * Escape analysis
+ *
+ *  Locals and parameters whose address is never taken can't be seen
+ *  through a pointer, so they are free to be kept in registers. Each
+ *  also gets a use count, weighted by how deeply it is inside loops,
+ *  for choosing which of them are worth a register.
+ */
+#define OPT_ESCAPE_LOOP 8
+
+static void opt_escape_variable(ast_t *var) {
+    var->variable.escapes = var->ctype->type == TYPE_ARRAY
+                         || var->ctype->type == TYPE_STRUCTURE
+                         || var->variable.init;
+    var->variable.uses    = 0;
+}
+
+static void opt_escape_visit(ast_t *ast, void *data) {
+    if (ast->type == AST_TYPE_ADDRESS && ast->unary.operand->type == AST_TYPE_VAR_LOCAL)
+        ast->unary.operand->variable.escapes = true;
+    if (ast->type == AST_TYPE_VAR_LOCAL)
+        ast->variable.uses += *(int*)data;
+}
+
+static void opt_escape_loop_visit(ast_t *ast, void *data) {
+    int weight = OPT_ESCAPE_LOOP;
+
+    switch (ast->type) {
+        case AST_TYPE_STATEMENT_FOR:
+        case AST_TYPE_STATEMENT_WHILE:
+        case AST_TYPE_STATEMENT_DO:
+            opt_walk(ast->forstmt.cond, &opt_escape_visit, &weight);
+            opt_walk(ast->forstmt.body, &opt_escape_visit, &weight);
+            opt_walk(ast->forstmt.step, &opt_escape_visit, &weight);
+            break;
+    }
+}
+
+static void opt_escape(list_t *toplevel) {
+    for (list_iterator_t *it = list_iterator(toplevel); !list_iterator_end(it); ) {
+        ast_t *ast    = list_iterator_next(it);
+        int    weight = 1;
+
+        if (ast->type != AST_TYPE_FUNCTION)
+            continue;
+
+        for (list_iterator_t *jt = list_iterator(ast->function.params); !list_iterator_end(jt); )
+            opt_escape_variable(list_iterator_next(jt));
+        for (list_iterator_t *jt = list_iterator(ast->function.locals); !list_iterator_end(jt); )
+            opt_escape_variable(list_iterator_next(jt));
+
+        opt_walk(ast->function.body, &opt_escape_visit, &weight);
+        opt_walk(ast->function.body, &opt_escape_loop_visit, NULL);
+    }
+}
+
+/*
+ * Tail calls
+ *
+ *  A call which is returned directly can leave through the callee
+ *  instead of coming back, as long as nothing in the caller's frame
+ *  can still be referenced and the value is returned unconverted.
+ */
+static bool opt_tail_escapes(ast_t *function) {
+    for (list_iterator_t *it = list_iterator(function->function.params); !list_iterator_end(it); )
+        if (((ast_t*)list_iterator_next(it))->variable.escapes)
+            return true;
+    for (list_iterator_t *it = list_iterator(function->function.locals); !list_iterator_end(it); )
+        if (((ast_t*)list_iterator_next(it))->variable.escapes)
+            return true;
+    return false;
+}
+
+static bool opt_tail_compatible(data_type_t *returntype, data_type_t *type) {
+    if (returntype->type != type->type)
+        return false;
+
+    switch (type->type) {
+        case TYPE_VOID:
+        case TYPE_DOUBLE:
+        case TYPE_POINTER:
+            return true;
+        case TYPE_CHAR:
+        case TYPE_SHORT:
+        case TYPE_INT:
+        case TYPE_LONG:
+        case TYPE_LLONG:
+            return returntype->size == type->size && returntype->sign == type->sign;
+        default:
+            break;
+    }
+    return false;
+}
+
+/* every argument has to be passed in a register */
+static bool opt_tail_registers(ast_t *call) {
+    int integers = 0;
+    int floats   = 0;
+
+    for (list_iterator_t *it = list_iterator(call->function.call.args); !list_iterator_end(it); ) {
+        if (ast_type_floating(((ast_t*)list_iterator_next(it))->ctype))
+            floats++;
+        else
+            integers++;
+    }
+    return integers <= 6 && floats <= 8;
+}
+
+static void opt_tail_visit(ast_t *ast, void *data) {
+    ast_t *function = data;
+    ast_t *call     = ast->returnstmt;
+
+    if (ast->type != AST_TYPE_STATEMENT_RETURN || !call || call->type != AST_TYPE_CALL)
+        return;
+    if (!opt_tail_compatible(function->ctype->returntype, call->ctype) || !opt_tail_registers(call))
+        return;
+
+    call->function.call.tail = true;
+    opt_statistics.tailcalls++;
+}
+
+static void opt_tail(list_t *toplevel) {
+    for (list_iterator_t *it = list_iterator(toplevel); !list_iterator_end(it); ) {
+        ast_t *ast = list_iterator_next(it);
+        if (ast->type == AST_TYPE_FUNCTION && !opt_tail_escapes(ast))
+            opt_walk(ast->function.body, &opt_tail_visit, ast);
+    }
+}
+
+list_t *opt_run(list_t *toplevel) {
+    memset(&opt_statistics, 0, sizeof(opt_statistics));
+    toplevel = opt_dead(toplevel);
+    opt_rotate(toplevel);
+    opt_cse(toplevel);
+    opt_escape(toplevel);
+    opt_tail(toplevel);
+    return toplevel;
+}
@@ -0,0 +1,79 @@
+#ifndef LICE_OPT_HDR
+#define LICE_OPT_HDR
+/*
+ * File: opt.h
+ *  Implements the interface to LICE's optimization passes
+ */
+
+/*
+ * Struct: opt_statistics_t
+ *  Counts of what the optimization passes did to a translation unit.
+ */
+typedef struct {
+    /*
+     * Variable: unreachable
+     *  Statements removed because they could never be executed.
+     */
+    int unreachable;
+
+    /*
+     * Variable: folded
+     *  Branches and loops with a constant condition that were folded.
+     */
+    int folded;
+
+    /*
+     * Variable: symbols
+     *  Internal linkage functions and variables which were dropped.
+     */
+    int symbols;
+
+    /*
+     * Variable: subexpressions
+     *  Recomputations of common subexpressions which were eliminated.
+     */
+    int subexpressions;
+
+    /*
+     * Variable: tailcalls
+     *  Calls in tail position which reuse the caller's frame.
+     */
+    int tailcalls;
+
+    /*
+     * Variable: rotates
+     *  Shifts put back together which were turned into rotates.
+     */
+    int rotates;
+} opt_statistics_t;
+
+extern COMPILE_LOCAL opt_statistics_t opt_statistics;
+
+/*
+ * Function: opt_run
+ *  Run all optimization passes over a translation unit
+ *
+ * Parameters:
+ *  toplevel - The list of functions and global declarations as
+ *             returned by <parse_run>
+ *
+ * Returns:
+ *  The list of functions and global declarations which still need
+ *  code generation.
+ *
+ * Remarks:
+ *  The passes rewrite the abstract syntax tree in place. Dead code
+ *  elimination removes unreachable statements, folds branches on
+ *  constant conditions and drops internal linkage functions and
+ *  variables which are never referenced. Shifts of a value which put
+ *  it back together are made rotates. Common subexpression
+ *  elimination then keeps the value of a pure expression in a
+ *  temporary when it is computed again while still available.
+ *  Escape analysis marks the locals which have to live in memory and
+ *  counts the uses of the others, which the code generator may keep
+ *  in registers. Finally calls which are returned directly are marked
+ *  as tail calls. What each pass did is counted in <opt_statistics>.
+ */
+list_t *opt_run(list_t *toplevel);
+
+#endif
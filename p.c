@@ -0,0 +1,30 @@
+#include "h.h"
+#include "h.h"
+int printf(const char *, ...);
+#define STR(x) #x
+#define XSTR(x) STR(x)
+#define CAT(a, b) a ## b
+#define N 10
+#define F(x) ((x) * N)
+#define EMPTY
+#define V(...) printf(__VA_ARGS__)
+#if defined(N) && N > 5 && !defined(NOPE)
+int ok1 = 1;
+#elif 1
+int ok1 = 2;
+#else
+int ok1 = 3;
+#endif
+#if 0
+#error should not
+#if garbage (
+#endif
+#endif
+#define f(a) a + f(a)
+int main() {
+    int CAT(x, y) = F(2);
+    int z = 5;
+    printf("%s %s %d %d %d\n", STR(a  +  b), XSTR(N), xy, ok1, from_header);
+    V("%d\n", z);
+    return 0;
+}
@@ -0,0 +1,101 @@
+.section .rodata.str1.1,"aMS",@progbits,1 #  1981
+.LSe223da09ebd5bc3f:                   #  1992
+	.string "a + b"                #  1993
+.LS07f89207b4ba08a4:                   #  1992
+	.string "10"                   #  1993
+.LS6365bbe3ed5add60:                   #  1992
+	.string "%s %s %d %d %d\n"     #  1993
+.set .LS9a221d17b7a812d2, .LS6365bbe3ed5add60+12 #  1987
+.data                                  #  1904
+.global from_header                    #  1906
+	.type from_header, @object     #  1908
+	.size from_header, 4           #  1909
+from_header:                           #  1910
+	.long 3                        #  1869
+	.align 8                       #  1880
+.data                                  #  1904
+.global ok1                            #  1906
+	.type ok1, @object             #  1908
+	.size ok1, 4                   #  1909
+ok1:                                   #  1910
+	.long 1                        #  1869
+	.align 8                       #  1880
+.text                                  #  2186
+.global main                           #  2188
+	.type main, @function          #  2189
+main:                                  #  2190
+	.cfi_startproc                 #  2191
+	push %rbp                      #  2195
+	.cfi_def_cfa_offset 16         #  2196
+	.cfi_offset %rbp, -16          #  2197
+	mov %rsp, %rbp                 #  2198
+	.cfi_def_cfa_register %rbp     #  2199
+.Lmain.0:                              #  1063
+	sub $16, %rsp                  #  2265
+	mov $2, %rax                   #  1339
+	push %rax                      #  566
+	mov $10, %rax                  #  1339
+	mov %rax, %rcx                 #  577
+	pop %rax                       #  578
+	imul %rcx, %rax                #  595
+	mov %eax, -4(%rbp)             #  244
+	movl $5, -8(%rbp)              #  851
+	push %rdi                      #  1382
+	push %rsi                      #  1382
+	push %rdx                      #  1382
+	push %rcx                      #  1382
+	push %r8                       #  1382
+	push %r9                       #  1382
+	lea .LS6365bbe3ed5add60(%rip), %rax #  1359
+	push %rax                      #  1396
+	lea .LSe223da09ebd5bc3f(%rip), %rax #  1359
+	push %rax                      #  1396
+	lea .LS07f89207b4ba08a4(%rip), %rax #  1359
+	push %rax                      #  1396
+	mov -4(%rbp), %ecx             #  220
+	mov %rcx, %rax                 #  221
+	push %rax                      #  1396
+	mov ok1(%rip), %eax            #  194
+	push %rax                      #  1396
+	mov from_header(%rip), %eax    #  194
+	push %rax                      #  1396
+	pop %r9                        #  1406
+	pop %r8                        #  1406
+	pop %rcx                       #  1406
+	pop %rdx                       #  1406
+	pop %rsi                       #  1406
+	pop %rdi                       #  1406
+	mov $0, %eax                   #  1409
+	call printf                    #  1432
+	pop %r9                        #  1443
+	pop %r8                        #  1443
+	pop %rcx                       #  1443
+	pop %rdx                       #  1443
+	pop %rsi                       #  1443
+	pop %rdi                       #  1443
+	push %rdi                      #  1382
+	push %rsi                      #  1382
+	lea .LS9a221d17b7a812d2(%rip), %rax #  1359
+	push %rax                      #  1396
+	mov -8(%rbp), %ecx             #  220
+	mov %rcx, %rax                 #  221
+	push %rax                      #  1396
+	pop %rsi                       #  1406
+	pop %rdi                       #  1406
+	mov $0, %eax                   #  1409
+	call printf                    #  1432
+	pop %rsi                       #  1443
+	pop %rdi                       #  1443
+	mov $0, %rax                   #  1339
+	.cfi_remember_state            #  1076
+	leave                          #  1079
+	.cfi_def_cfa %rsp, 8           #  1080
+	ret                            #  1607
+	.cfi_restore_state             #  1084
+	.cfi_remember_state            #  1076
+	leave                          #  1079
+	.cfi_def_cfa %rsp, 8           #  1080
+	ret                            #  2271
+	.cfi_restore_state             #  1084
+	.cfi_endproc                   #  2273
+	.size main, .-main             #  2274
@@ -15,7 +15,7 @@ static void         parse_statement_declaration(list_t *);
 static ast_t       *parse_statement(void);
 
 
-static data_type_t *parse_declaration_specification(storage_t *);
+static data_type_t *parse_declaration_specification(storage_t *, int *);
 static list_t      *parse_initializer_declaration(data_type_t *type);
 static data_type_t *parse_declarator(char **, data_type_t *, list_t *, cdecl_t);
 static void         parse_declaration(list_t *, ast_t *(*)(data_type_t *, char *));
@@ -23,7 +23,11 @@ static void         parse_declaration(list_t *, ast_t *(*)(data_type_t *, char *
 static void         parse_function_parameter(data_type_t **, char **, bool);
 static data_type_t *parse_function_parameters(list_t *, data_type_t *);
 
-table_t *parse_typedefs = &SENTINEL_TABLE;
+COMPILE_LOCAL table_t *parse_typedefs = &SENTINEL_TABLE;
+
+/* the last __builtin_expect parsed, which an if statement may be conditioned on */
+static COMPILE_LOCAL ast_t *parse_expected       = NULL;
+static COMPILE_LOCAL long   parse_expected_value = 0;
 
 static bool parse_type_check(lexer_token_t *token);
 
@@ -176,7 +180,7 @@ static void parse_function_typecheck(const char *name, list_t *parameters, list_
     }
 }
 
-static ast_t *parse_function_call(char *name) {
+static list_t *parse_function_arguments(void) {
     list_t *list = list_create();
     for (;;) {
 
@@ -192,26 +196,140 @@ static ast_t *parse_function_call(char *name) {
         if (!lexer_ispunct(token, ','))
             compile_error("unexpected token `%s'", lexer_tokenstr(token));
     }
+    return list;
+}
+
+static int parse_function_attributes(ast_t *func) {
+    if (!func)
+        return 0;
+    if (func->type == AST_TYPE_FUNCTION)
+        return func->function.attributes;
+    if (func->type == AST_TYPE_VAR_GLOBAL)
+        return func->variable.attributes;
+    return 0;
+}
 
-    ast_t *func = table_find(ast_localenv, name);
+static ast_t *parse_function_call(char *name) {
+    list_t *list = parse_function_arguments();
+    ast_t  *func = table_find(ast_localenv, name);
     if (func) {
         data_type_t *declaration = func->ctype;
         if (declaration->type != TYPE_FUNCTION)
             compile_error("expected a function name, `%s' isn't a function", name);
         parse_function_typecheck(name, declaration->parameters, parse_parameter_types(list));
-        return ast_call(declaration->returntype, name, list, declaration->parameters);
+        ast_t *call = ast_call(declaration->returntype, name, list, declaration->parameters);
+        call->function.attributes = parse_function_attributes(func);
+        return call;
     }
     /* TODO: warn about implicit int return */
     return ast_call(ast_data_table[AST_DATA_INT], name, list, list_create());
 }
 
 
+/*
+ * A hint is the value of the expression it is given, an if statement
+ * conditioned on that picks the hint up.
+ */
+static ast_t *parse_builtin_expect(void) {
+    list_t *arguments = parse_function_arguments();
+    if (list_length(arguments) != 2)
+        compile_error("__builtin_expect takes two arguments");
+
+    ast_t *value = list_shift(arguments);
+    parse_expected       = value;
+    parse_expected_value = parse_evaluate(list_shift(arguments));
+    return value;
+}
+
+/*
+ * The bit builtins work at the width of their parameter, the operand
+ * is converted to it. Those which don't count something give a value
+ * of that type back.
+ */
+static const struct {
+    const char *name;
+    int         type;
+    type_t      parameter;
+    bool        returns;
+} parse_builtin_bits_table[] = {
+    { "__builtin_popcount",   AST_TYPE_POPCOUNT, TYPE_INT,   false },
+    { "__builtin_popcountl",  AST_TYPE_POPCOUNT, TYPE_LONG,  false },
+    { "__builtin_popcountll", AST_TYPE_POPCOUNT, TYPE_LLONG, false },
+    { "__builtin_clz",        AST_TYPE_CLZ,      TYPE_INT,   false },
+    { "__builtin_clzl",       AST_TYPE_CLZ,      TYPE_LONG,  false },
+    { "__builtin_clzll",      AST_TYPE_CLZ,      TYPE_LLONG, false },
+    { "__builtin_ctz",        AST_TYPE_CTZ,      TYPE_INT,   false },
+    { "__builtin_ctzl",       AST_TYPE_CTZ,      TYPE_LONG,  false },
+    { "__builtin_ctzll",      AST_TYPE_CTZ,      TYPE_LLONG, false },
+    { "__builtin_bswap16",    AST_TYPE_BSWAP,    TYPE_SHORT, true  },
+    { "__builtin_bswap32",    AST_TYPE_BSWAP,    TYPE_INT,   true  },
+    { "__builtin_bswap64",    AST_TYPE_BSWAP,    TYPE_LONG,  true  }
+};
+
+static ast_t *parse_builtin_bits(int index) {
+    const char *name      = parse_builtin_bits_table[index].name;
+    list_t     *arguments = parse_function_arguments();
+
+    if (list_length(arguments) != 1)
+        compile_error("%s takes one argument", name);
+
+    ast_t       *value     = list_shift(arguments);
+    data_type_t *parameter = ast_type_create(parse_builtin_bits_table[index].parameter, false);
+
+    if (!ast_type_integer(value->ctype))
+        compile_error("%s takes an integer, `%s' isn't one", name, ast_string(value));
+
+    return ast_new_unary(
+        parse_builtin_bits_table[index].type,
+        parse_builtin_bits_table[index].returns ? parameter : ast_data_table[AST_DATA_INT],
+        ast_new_unary(AST_TYPE_EXPRESSION_CAST, parameter, value)
+    );
+}
+
+/*
+ * Whether the prefetch is for a write is only a hint there is nothing
+ * to do with, the locality picks the instruction.
+ */
+static ast_t *parse_builtin_prefetch(void) {
+    list_t *arguments = parse_function_arguments();
+    int     length    = list_length(arguments);
+    int     locality  = 3;
+
+    if (length < 1 || length > 3)
+        compile_error("__builtin_prefetch takes one to three arguments");
+
+    ast_t *address = list_shift(arguments);
+    if (ast_array_convert(address->ctype)->type != TYPE_POINTER)
+        compile_error("expected pointer type, `%s' isn't pointer type", ast_string(address));
+
+    if (length > 1)
+        parse_evaluate(list_shift(arguments));
+    if (length > 2)
+        locality = parse_evaluate(list_shift(arguments));
+    if (locality < 0 || locality > 3)
+        compile_error("__builtin_prefetch locality must be between 0 and 3");
+
+    return ast_prefetch(address, locality);
+}
+
+/* builtins look like calls but aren't, NULL when the name isn't one */
+static ast_t *parse_builtin(char *name) {
+    if (!strcmp(name, "__builtin_expect"))
+        return parse_builtin_expect();
+    if (!strcmp(name, "__builtin_prefetch"))
+        return parse_builtin_prefetch();
+    for (size_t i = 0; i < sizeof(parse_builtin_bits_table) / sizeof(*parse_builtin_bits_table); i++)
+        if (!strcmp(name, parse_builtin_bits_table[i].name))
+            return parse_builtin_bits(i);
+    return NULL;
+}
+
 static ast_t *parse_generic(char *name) {
     ast_t         *var   = NULL;
     lexer_token_t *token = lexer_next();
 
     if (lexer_ispunct(token, '('))
-        return parse_function_call(name);
+        return (var = parse_builtin(name)) ? var : parse_function_call(name);
 
     lexer_unget(token);
 
@@ -364,7 +482,7 @@ static ast_t *parse_expression_compound_literal(data_type_t *type) {
 }
 
 static ast_t *parse_expression_unary_cast(void) {
-    data_type_t *basetype = parse_declaration_specification(NULL);
+    data_type_t *basetype = parse_declaration_specification(NULL, NULL);
     data_type_t *casttype = parse_declarator(NULL, basetype, NULL, CDECL_CAST);
 
     parse_expect(')');
@@ -395,6 +513,16 @@ static ast_t *parse_expression_unary(void) {
         parse_expect(')');
         return next;
     }
+    if (lexer_ispunct(token, LEXER_TOKEN_AND)) {
+        lexer_token_t *label = lexer_next();
+        if (!label || label->type != LEXER_TOKEN_IDENTIFIER)
+            compile_error("expected label name after &&");
+        if (!ast_localenv)
+            compile_error("label address `%s' outside of a function", label->string);
+        ast_t *node = ast_label_address(label->string);
+        list_push(ast_gotos, node);
+        return node;
+    }
     if (lexer_ispunct(token, '&')) {
         ast_t *operand = parse_expression_intermediate(3);
         parse_semantic_lvalue(operand);
@@ -593,7 +721,7 @@ static bool parse_type_check(lexer_token_t *token) {
         "char",     "short",  "int",     "long",     "float",    "double",
         "struct",   "union",  "signed",  "unsigned", "enum",     "void",
         "typedef",  "extern", "static",  "auto",     "register", "const",
-        "volatile", "inline", "restrict"
+        "volatile", "inline", "restrict", "__attribute__"
     };
 
     for (int i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++)
@@ -644,7 +772,7 @@ static table_t *parse_memory_fields(int *rsize, bool isstruct) {
         if (!parse_type_check(lexer_peek()))
             break;
 
-        data_type_t *basetype = parse_declaration_specification(NULL);
+        data_type_t *basetype = parse_declaration_specification(NULL, NULL);
 
         if (basetype->type == TYPE_STRUCTURE && lexer_ispunct(lexer_peek(), ';')) {
             lexer_next(); /* Skip */
@@ -976,6 +1104,15 @@ static void parse_initializer_list(list_t *init, data_type_t *type, int offset)
 
 static list_t *parse_initializer_declaration(data_type_t *type) {
     list_t *list = list_create();
+
+    /* initialized by copying another structure */
+    if (type->type == TYPE_STRUCTURE && !lexer_ispunct(lexer_peek(), '{')) {
+        ast_t *expression = parse_expression();
+        ast_result_type('=', type, expression->ctype);
+        list_push(list, ast_initializer(expression, type, 0));
+        return list;
+    }
+
     if (type->type == TYPE_ARRAY || type->type == TYPE_STRUCTURE)
         parse_initializer_list(list, type, 0);
     else
@@ -983,10 +1120,78 @@ static list_t *parse_initializer_declaration(data_type_t *type) {
     return list;
 }
 
+static int parse_attribute_name(const char *name) {
+    static const struct {
+        const char *name;
+        int         attribute;
+    } attributes[] = {
+        { "hot",      ATTRIBUTE_HOT      },
+        { "cold",     ATTRIBUTE_COLD     },
+        { "noinline", ATTRIBUTE_NOINLINE }
+    };
+
+    /* __cold__ is cold too */
+    size_t length = strlen(name);
+    if (length > 4 && !strncmp(name, "__", 2) && !strcmp(name + length - 2, "__")) {
+        name   += 2;
+        length -= 4;
+    }
+    for (size_t i = 0; i < sizeof(attributes) / sizeof(*attributes); i++)
+        if (strlen(attributes[i].name) == length && !strncmp(attributes[i].name, name, length))
+            return attributes[i].attribute;
+    return 0;
+}
+
+/*
+ * The list of an __attribute__ in double parentheses. Attributes which
+ * aren't understood are skipped along with their arguments.
+ */
+static int parse_attribute(void) {
+    int attributes = 0;
+
+    parse_expect('(');
+    parse_expect('(');
+    for (;;) {
+        lexer_token_t *token = lexer_next();
+        if (lexer_ispunct(token, ')'))
+            break;
+        if (lexer_ispunct(token, ','))
+            continue;
+        if (!token || token->type != LEXER_TOKEN_IDENTIFIER)
+            compile_error("expected attribute name, got %s instead", lexer_tokenstr(token));
+        attributes |= parse_attribute_name(token->string);
+
+        if (!lexer_ispunct(lexer_peek(), '('))
+            continue;
+        for (int nests = 0; ; ) {
+            if (!(token = lexer_next()))
+                compile_error("attribute with unexpected ending");
+            if (lexer_ispunct(token, '('))
+                nests++;
+            if (lexer_ispunct(token, ')') && --nests == 0)
+                break;
+        }
+    }
+    parse_expect(')');
+    return attributes;
+}
+
+/* attributes may follow a declarator too */
+static int parse_attribute_trailing(void) {
+    int            attributes = 0;
+    lexer_token_t *token;
+
+    while ((token = lexer_next()) && parse_identifer_check(token, "__attribute__"))
+        attributes |= parse_attribute();
+    lexer_unget(token);
+    return attributes;
+}
+
 /* declarator */
-static data_type_t *parse_declaration_specification(storage_t *rstorage) {
-    storage_t      storage = 0;
-    lexer_token_t *token   = lexer_peek();
+static data_type_t *parse_declaration_specification(storage_t *rstorage, int *rattributes) {
+    storage_t      storage    = 0;
+    int            attributes = 0;
+    lexer_token_t *token      = lexer_peek();
     if (!token || token->type != LEXER_TOKEN_IDENTIFIER)
         compile_error("internal error in declaration specification parsing");
 
@@ -1116,6 +1321,8 @@ static data_type_t *parse_declaration_specification(storage_t *rstorage) {
         else state_machine_try("volatile") kvolatile = true;
         else state_machine_try("inline")   kinline   = true;
 
+        else state_machine_try("__attribute__") attributes |= parse_attribute();
+
         else state_machine_try("typedef")  set_class(STORAGE_TYPEDEF);
         else state_machine_try("extern")   set_class(STORAGE_EXTERN);
         else state_machine_try("static")   set_class(STORAGE_STATIC);
@@ -1161,6 +1368,8 @@ static data_type_t *parse_declaration_specification(storage_t *rstorage) {
 
     if (rstorage)
         *rstorage = storage;
+    if (rattributes)
+        *rattributes = attributes;
 
     if (user)
         return user;
@@ -1235,32 +1444,77 @@ static void parse_function_parameter(data_type_t **rtype, char **name, bool next
     data_type_t *basetype;
     storage_t    storage;
 
-    basetype = parse_declaration_specification(&storage);
+    basetype = parse_declaration_specification(&storage, NULL);
     basetype = parse_declarator(name, basetype, NULL, next ? CDECL_TYPEONLY : CDECL_PARAMETER);
     *rtype = parse_array_dimensions(basetype);
 }
 
+/* a statement which calls a cold function is unlikely to run */
+static bool parse_statement_cold(ast_t *ast) {
+    if (!ast)
+        return false;
+
+    switch (ast->type) {
+        case AST_TYPE_CALL:
+            return ast->function.attributes & ATTRIBUTE_COLD;
+        case AST_TYPE_STATEMENT_RETURN:
+            return parse_statement_cold(ast->returnstmt);
+        case AST_TYPE_STATEMENT_COMPOUND:
+            for (list_iterator_t *it = list_iterator(ast->compound); !list_iterator_end(it); )
+                if (parse_statement_cold(list_iterator_next(it)))
+                    return true;
+            return false;
+        default:
+            return false;
+    }
+}
+
+/*
+ * The branch a __builtin_expect hints at is the likely one, otherwise
+ * a branch calling a cold function is unlikely.
+ */
+static int parse_statement_if_expect(ast_t *cond, ast_t *then, ast_t *last) {
+    if (parse_expected && parse_expected == cond)
+        return parse_expected_value ? 1 : -1;
+    if (parse_statement_cold(then) && !parse_statement_cold(last))
+        return -1;
+    if (parse_statement_cold(last) && !parse_statement_cold(then))
+        return 1;
+    return 0;
+}
+
 static ast_t *parse_statement_if(void) {
     lexer_token_t *token;
     ast_t  *cond;
     ast_t *then;
-    ast_t *last;
+    ast_t *last   = NULL;
+    ast_t *expect;
+    long   value;
 
     parse_expect('(');
-    cond = parse_expression();
+    parse_expected = NULL;
+    cond           = parse_expression();
+    expect         = parse_expected;
+    value          = parse_expected_value;
     parse_expect(')');
 
 
     then  = parse_statement();
     token = lexer_next();
 
-    if (!token || token->type != LEXER_TOKEN_IDENTIFIER || strcmp(token->string, "else")) {
+    if (!token || token->type != LEXER_TOKEN_IDENTIFIER || strcmp(token->string, "else"))
         lexer_unget(token);
-        return ast_if(cond, then, NULL);
-    }
+    else
+        last = parse_statement();
+
+    /* the branches may have hints of their own */
+    parse_expected       = expect;
+    parse_expected_value = value;
 
-    last = parse_statement();
-    return ast_if(cond, then, last);
+    ast_t *node = ast_if(cond, then, last);
+    node->ifstmt.expect = parse_statement_if_expect(cond, then, last);
+    parse_expected = NULL;
+    return node;
 }
 
 static ast_t *parse_statement_declaration_semicolon(void) {
@@ -1358,6 +1612,13 @@ static ast_t *parse_statement_return(void) {
 
 static ast_t *parse_statement_goto(void) {
     lexer_token_t *token = lexer_next();
+    if (lexer_ispunct(token, '*')) {
+        ast_t *target = parse_expression();
+        if (ast_array_convert(target->ctype)->type != TYPE_POINTER)
+            compile_error("expected pointer type, `%s' isn't pointer type", ast_string(target));
+        parse_expect(';');
+        return ast_goto_computed(target);
+    }
     if (!token || token->type != LEXER_TOKEN_IDENTIFIER)
         compile_error("expected identifier in goto statement");
     parse_expect(';');
@@ -1368,7 +1629,11 @@ static ast_t *parse_statement_goto(void) {
     return node;
 }
 
-static void parse_label_backfill(void) {
+/*
+ * Labels are named after the function and the label itself, a label
+ * whose address is taken is resolved the same as one gone to.
+ */
+static void parse_label_backfill(char *function) {
     for (list_iterator_t *it = list_iterator(ast_gotos); !list_iterator_end(it); ) {
         ast_t *source      = list_iterator_next(it);
         char  *label       = source->gotostmt.label;
@@ -1376,10 +1641,12 @@ static void parse_label_backfill(void) {
 
         if (!destination)
             compile_error("undefined label: %s", label);
-        if (destination->gotostmt.where)
-            source->gotostmt.where = destination->gotostmt.where;
-        else
-            source->gotostmt.where = destination->gotostmt.where = ast_label();
+        if (!destination->gotostmt.where) {
+            string_t *where = string_create();
+            string_catf(where, ".L%s.%s", function, label);
+            destination->gotostmt.where = string_buffer(where);
+        }
+        source->gotostmt.where = destination->gotostmt.where;
     }
 }
 
@@ -1395,7 +1662,7 @@ static ast_t *parse_label(lexer_token_t *token) {
     return node;
 }
 
-static ast_t *parse_statement(void) {
+static ast_t *parse_statement_node(void) {
     lexer_token_t *token = lexer_next();
     ast_t         *ast;
 
@@ -1423,14 +1690,37 @@ static ast_t *parse_statement(void) {
     return ast;
 }
 
+static void parse_position(ast_t *ast, lexer_token_t *token) {
+    ast->file   = token->file;
+    ast->line   = token->line;
+    ast->column = token->column;
+}
+
+/* a statement is where its first token is */
+static ast_t *parse_statement(void) {
+    lexer_token_t *token = lexer_peek();
+    ast_t         *ast   = parse_statement_node();
+    if (ast && token)
+        parse_position(ast, token);
+    return ast;
+}
+
 static void parse_statement_declaration(list_t *list){
     lexer_token_t *token = lexer_peek();
     if (!token)
         compile_error("statement declaration with unexpected ending");
-    if (parse_type_check(token))
-        parse_declaration(list, ast_variable_local);
-    else
+    if (!parse_type_check(token)) {
         list_push(list, parse_statement());
+        return;
+    }
+
+    int declared = list_length(list);
+    parse_declaration(list, ast_variable_local);
+    for (list_iterator_t *it = list_iterator(list); !list_iterator_end(it); ) {
+        ast_t *ast = list_iterator_next(it);
+        if (declared-- <= 0 && ast)
+            parse_position(ast, token);
+    }
 }
 
 static ast_t *parse_statement_compound(void) {
@@ -1553,19 +1843,35 @@ static bool parse_function_definition_check(void) {
 
 static ast_t *parse_function_definition_intermediate(void) {
     data_type_t *basetype;
+    storage_t    storage;
+    int          attributes;
     char        *name;
     list_t      *parameters = list_create();
 
-    basetype     = parse_declaration_specification(NULL);
+    basetype     = parse_declaration_specification(&storage, &attributes);
     ast_localenv = table_create(ast_globalenv);
     ast_labels   = table_create(NULL);
     ast_gotos    = list_create();
 
     data_type_t *functype = parse_declarator(&name, basetype, parameters, CDECL_BODY);
+    ast_t       *previous = table_find(ast_globalenv, name);
+
+    /* a static prototype gives the definition internal linkage too */
+    if (storage == STORAGE_STATIC || (previous && previous->ctype->isstatic))
+        functype->isstatic = true;
+
+    /* so a recursive call sees the real return type */
+    if (!previous)
+        ast_variable_global(functype, name);
+
+    /* attributes of every declaration before hold for the definition */
+    attributes |= parse_function_attributes(previous);
+
     parse_expect('{');
     ast_t *value = parse_function_definition(functype, name, parameters);
+    value->function.attributes = attributes;
 
-    parse_label_backfill();
+    parse_label_backfill(name);
 
     ast_localenv = NULL;
     return value;
@@ -1667,7 +1973,8 @@ static data_type_t *parse_declarator(char **rname, data_type_t *basetype, list_t
 
 static void parse_declaration(list_t *list, ast_t *(*make)(data_type_t *, char *)) {
     storage_t      storage;
-    data_type_t   *basetype = parse_declaration_specification(&storage);
+    int            attributes;
+    data_type_t   *basetype = parse_declaration_specification(&storage, &attributes);
     lexer_token_t *token    = lexer_next();
 
     if (lexer_ispunct(token, ';'))
@@ -1678,6 +1985,7 @@ static void parse_declaration(list_t *list, ast_t *(*make)(data_type_t *, char *
     for (;;) {
         char        *name = NULL;
         data_type_t *type = parse_declarator(&name, ast_type_copy_incomplete(basetype), NULL, CDECL_BODY);
+        int          also = parse_attribute_trailing();
 
         if (storage == STORAGE_STATIC)
             type->isstatic = true;
@@ -1693,7 +2001,8 @@ static void parse_declaration(list_t *list, ast_t *(*make)(data_type_t *, char *
         } else if (storage == STORAGE_TYPEDEF) {
             table_insert(parse_typedefs, name, type);
         } else if (type->type == TYPE_FUNCTION) {
-            make(type, name);
+            int previous = parse_function_attributes(table_find(ast_globalenv, name));
+            make(type, name)->variable.attributes = previous | attributes | also;
         } else {
             ast_t *var = make(type, name);
             if (storage != STORAGE_EXTERN)
@@ -1706,15 +2015,65 @@ static void parse_declaration(list_t *list, ast_t *(*make)(data_type_t *, char *
     }
 }
 
+/* the tokens of a function definition up to the braces of its body */
+static list_t *parse_signature(list_t *tokens) {
+    list_t *reverse   = list_reverse(tokens);
+    list_t *signature = list_create();
+    int     nests     = 0;
+
+    for (list_iterator_t *it = list_iterator(reverse); !list_iterator_end(it); ) {
+        lexer_token_t *token = list_iterator_next(it);
+        if (lexer_ispunct(token, '}'))
+            nests++;
+        if (lexer_ispunct(token, '{') && --nests == 0) {
+            while (!list_iterator_end(it))
+                list_push(signature, list_iterator_next(it));
+            break;
+        }
+    }
+    return list_reverse(signature);
+}
+
+void parse_init(void) {
+    parse_typedefs = table_create(NULL);
+}
+
+/*
+ * The tokens of every toplevel declaration are hashed into a context
+ * which a function definition is digested in. A definition only adds
+ * its signature to the context, so a change to the body of one
+ * function leaves the digest of every other function the same.
+ */
 list_t *parse_run(void) {
-    list_t *list = list_create();
+    list_t       *list    = list_create();
+    unsigned long context = HASH_INITIAL;
+
     for (;;) {
         if (!lexer_peek())
             return list;
-        if (parse_function_definition_check())
-            list_push(list, parse_function_definition_intermediate());
-        else
+
+        list_t *tokens = list_create();
+        lexer_capture(tokens);
+
+        if (parse_function_definition_check()) {
+            ast_t *function = parse_function_definition_intermediate();
+
+            function->function.digest = lexer_hash(context, tokens);
+            list_push(list, function);
+
+            /* line tables refer to where every token is */
+            if (list_length(tokens))
+                parse_position(function, list_iterator_next(list_iterator(tokens)));
+            if (gen_debug)
+                function->function.digest = lexer_hash_positions(function->function.digest, tokens);
+
+            context = lexer_hash(context, parse_signature(tokens));
+        } else {
             parse_declaration(list, &ast_variable_global);
+            context = lexer_hash(context, tokens);
+        }
+
+        lexer_capture(NULL);
     }
     return NULL;
 }
@@ -0,0 +1,91 @@
+#define _POSIX_C_SOURCE 200809L /* strdup */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "lice.h"
+#include "profile.h"
+
+/*
+ * The profile is a line of `function counter count' for every counter
+ * of every function, a program appends one set of lines per run. It
+ * is kept sorted so a counter is found with a binary search.
+ */
+typedef struct {
+    char *function;
+    long  index;
+    long  count;
+} profile_entry_t;
+
+/* read once before any unit and shared by all of them */
+static profile_entry_t *profile_entries = NULL;
+static size_t           profile_length  = 0;
+static unsigned long    profile_hash    = 0;
+
+static int profile_compare(const void *a, const void *b) {
+    const profile_entry_t *x = a;
+    const profile_entry_t *y = b;
+    int                    c = strcmp(x->function, y->function);
+    if (c)
+        return c;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+void profile_open(const char *file) {
+    FILE  *input    = fopen(file, "r");
+    size_t capacity = 256;
+    char   function[256];
+    long   index;
+    long   count;
+
+    if (!input)
+        compile_error("cannot open profile `%s'", file);
+
+    profile_entries = malloc(sizeof(profile_entry_t) * capacity);
+    profile_hash    = HASH_INITIAL;
+
+    while (fscanf(input, "%255s %ld %ld", function, &index, &count) == 3) {
+        if (profile_length == capacity)
+            profile_entries = realloc(profile_entries, sizeof(profile_entry_t) * (capacity *= 2));
+        profile_entries[profile_length++] = (profile_entry_t){
+            .function = strdup(function),
+            .index    = index,
+            .count    = count
+        };
+    }
+    if (!feof(input))
+        compile_error("corrupt profile `%s'", file);
+    fclose(input);
+
+    qsort(profile_entries, profile_length, sizeof(profile_entry_t), &profile_compare);
+
+    /* every run of the program added its own lines */
+    size_t merged = 0;
+    for (size_t i = 0; i < profile_length; i++) {
+        if (merged && !profile_compare(&profile_entries[merged - 1], &profile_entries[i])) {
+            profile_entries[merged - 1].count += profile_entries[i].count;
+            free(profile_entries[i].function);
+            continue;
+        }
+        profile_entries[merged++] = profile_entries[i];
+    }
+    profile_length = merged;
+
+    for (size_t i = 0; i < profile_length; i++) {
+        profile_hash = hash_bytes(profile_hash, profile_entries[i].function, strlen(profile_entries[i].function) + 1);
+        profile_hash = hash_bytes(profile_hash, &profile_entries[i].index, sizeof(long));
+        profile_hash = hash_bytes(profile_hash, &profile_entries[i].count, sizeof(long));
+    }
+}
+
+long profile_count(const char *function, int index) {
+    profile_entry_t  key   = { .function = (char*)function, .index = index };
+    profile_entry_t *entry = profile_length
+        ? bsearch(&key, profile_entries, profile_length, sizeof(profile_entry_t), &profile_compare)
+        : NULL;
+    return entry ? entry->count : -1;
+}
+
+unsigned long profile_digest(void) {
+    return profile_hash;
+}
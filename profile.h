@@ -0,0 +1,43 @@
+#ifndef LICE_PROFILE_HDR
+#define LICE_PROFILE_HDR
+/*
+ * File: profile.h
+ *  Implements the interface for reading LICE's execution profiles
+ */
+
+/*
+ * Function: profile_open
+ *  Read the profile code generation is guided by.
+ *
+ * Parameters:
+ *  file    - The profile written by a program compiled with
+ *            --profile-generate
+ *
+ * Remarks:
+ *  Must be called before any translation unit is compiled, the
+ *  profile is shared by all of them. A program which ran more than
+ *  once appends to the profile, the counts of every run are summed.
+ */
+void profile_open(const char *file);
+
+/*
+ * Function: profile_count
+ *  How often a counter of a function was reached.
+ *
+ * Parameters:
+ *  function    - Name of the function
+ *  index       - Which of its counters
+ *
+ * Returns:
+ *  The count, or -1 when there is no profile or the function isn't
+ *  in it.
+ */
+long profile_count(const char *function, int index);
+
+/*
+ * Function: profile_digest
+ *  Hash of the profile read, or 0 when there is none.
+ */
+unsigned long profile_digest(void);
+
+#endif
@@ -0,0 +1,22 @@
+int printf(const char *, ...);
+#define A 1
+#if A == 1 ? 2 : 3
+int t = 1;
+#else
+int t = 0;
+#endif
+#define LPAREN (
+#define G(x) x+1
+#define H G
+int r = H(2);
+#if (1 << 40) > 0
+int big = 1;
+#else
+int big = 0;
+#endif
+#if -1 > 0u
+int u = 1;
+#else
+int u = 0;
+#endif
+int main() { printf("%d %d %d %d\n", t, r, big, u); return 0; }
@@ -0,0 +1,84 @@
+.section .rodata.str1.1,"aMS",@progbits,1 #  1981
+.LS9c006c9c5e4b7ac3:                   #  1992
+	.string "%d %d %d %d\n"        #  1993
+.data                                  #  1904
+.global t                              #  1906
+	.type t, @object               #  1908
+	.size t, 4                     #  1909
+t:                                     #  1910
+	.long 1                        #  1869
+	.align 8                       #  1880
+.data                                  #  1904
+.global r                              #  1906
+	.type r, @object               #  1908
+	.size r, 4                     #  1909
+r:                                     #  1910
+	.long 3                        #  1869
+	.align 8                       #  1880
+.data                                  #  1904
+.global big                            #  1906
+	.type big, @object             #  1908
+	.size big, 4                   #  1909
+big:                                   #  1910
+	.long 1                        #  1869
+	.align 8                       #  1880
+.data                                  #  1904
+.global u                              #  1906
+	.type u, @object               #  1908
+	.size u, 4                     #  1909
+u:                                     #  1910
+	.zero 4                        #  1862
+	.align 8                       #  1880
+.text                                  #  2186
+.global main                           #  2188
+	.type main, @function          #  2189
+main:                                  #  2190
+	.cfi_startproc                 #  2191
+	push %rbp                      #  2195
+	.cfi_def_cfa_offset 16         #  2196
+	.cfi_offset %rbp, -16          #  2197
+	mov %rsp, %rbp                 #  2198
+	.cfi_def_cfa_register %rbp     #  2199
+.Lmain.0:                              #  1063
+	push %rdi                      #  1382
+	push %rsi                      #  1382
+	push %rdx                      #  1382
+	push %rcx                      #  1382
+	push %r8                       #  1382
+	lea .LS9c006c9c5e4b7ac3(%rip), %rax #  1359
+	push %rax                      #  1396
+	mov t(%rip), %eax              #  194
+	push %rax                      #  1396
+	mov r(%rip), %eax              #  194
+	push %rax                      #  1396
+	mov big(%rip), %eax            #  194
+	push %rax                      #  1396
+	mov u(%rip), %eax              #  194
+	push %rax                      #  1396
+	pop %r8                        #  1406
+	pop %rcx                       #  1406
+	pop %rdx                       #  1406
+	pop %rsi                       #  1406
+	pop %rdi                       #  1406
+	mov $0, %eax                   #  1409
+	sub $8, %rsp                   #  1430
+	call printf                    #  1432
+	add $8, %rsp                   #  1435
+	pop %r8                        #  1443
+	pop %rcx                       #  1443
+	pop %rdx                       #  1443
+	pop %rsi                       #  1443
+	pop %rdi                       #  1443
+	mov $0, %rax                   #  1339
+	.cfi_remember_state            #  1076
+	leave                          #  1079
+	.cfi_def_cfa %rsp, 8           #  1080
+	ret                            #  1607
+	.cfi_restore_state             #  1084
+	.cfi_remember_state            #  1076
+	leave                          #  1079
+	.cfi_def_cfa %rsp, 8           #  1080
+	ret                            #  2271
+	.cfi_restore_state             #  1084
+	.cfi_endproc                   #  2273
+	.size main, .-main             #  2274
@@ -0,0 +1,406 @@
+#define _XOPEN_SOURCE 700 /* realpath */
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "lice.h"
+#include "lexer.h"
+#include "snapshot.h"
+
+/*
+ * A snapshot is only good for the compiler which wrote it, the data
+ * types are written as they are laid out in memory.
+ */
+static const char snapshot_magic[] = "LICEPCH";
+static const char snapshot_build[] = __DATE__ " " __TIME__;
+
+/* shared by every unit and mapped until exit */
+static snapshot_t    snapshot_mapped;
+static bool          snapshot_opened = false;
+static unsigned long snapshot_hash   = 0;
+static const char   *snapshot_header = NULL;
+
+void snapshot_write_int(FILE *output, long value) {
+    /* zigzag so small negatives stay small */
+    unsigned long bits = ((unsigned long)value << 1) ^ (unsigned long)(value >> 63);
+    while (bits >= 0x80) {
+        fputc((bits & 0x7F) | 0x80, output);
+        bits >>= 7;
+    }
+    fputc(bits, output);
+}
+
+void snapshot_write_string(FILE *output, const char *string) {
+    if (!string) {
+        snapshot_write_int(output, 0);
+        return;
+    }
+    size_t length = strlen(string);
+    snapshot_write_int(output, length + 1);
+    fwrite(string, 1, length + 1, output);
+}
+
+long snapshot_read_int(snapshot_t *snapshot) {
+    unsigned long bits  = 0;
+    int           shift = 0;
+
+    for (;;) {
+        if (snapshot->position >= snapshot->size || shift > 63)
+            compile_error("corrupt snapshot");
+        unsigned char byte = snapshot->data[snapshot->position++];
+        bits |= (unsigned long)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            break;
+        shift += 7;
+    }
+    return (long)(bits >> 1) ^ -(long)(bits & 1);
+}
+
+char *snapshot_read_string(snapshot_t *snapshot) {
+    long length = snapshot_read_int(snapshot);
+    if (length == 0)
+        return NULL;
+
+    /* written with the terminator so it can be used in place */
+    if (length < 0 || (size_t)length > snapshot->size - snapshot->position
+                   || snapshot->data[snapshot->position + length - 1])
+        compile_error("corrupt snapshot");
+
+    char *string = (char*)snapshot->data + snapshot->position;
+    snapshot->position += length;
+    return string;
+}
+
+/*
+ * Data types form a graph, every one reachable from the declarations
+ * is numbered and written once. The builtin types are not written at
+ * all since every unit has its own.
+ */
+typedef struct {
+    list_t      *types;
+    hashtable_t *index;
+} snapshot_types_t;
+
+static long snapshot_type_index(snapshot_types_t *types, data_type_t *type) {
+    if (!type)
+        return -1;
+    for (int i = 0; i < AST_DATA_FUNCTION; i++)
+        if (type == ast_data_table[i])
+            return -2 - i;
+
+    string_t *key = string_create();
+    string_catf(key, "%p", (void*)type);
+    long *index = hashtable_find(types->index, string_buffer(key));
+    return index ? *index : -1;
+}
+
+static void snapshot_type_collect(snapshot_types_t *types, data_type_t *type) {
+    if (!type || snapshot_type_index(types, type) != -1)
+        return;
+
+    string_t *key   = string_create();
+    long     *index = memory_allocate(sizeof(long));
+
+    string_catf(key, "%p", (void*)type);
+    *index = list_length(types->types);
+    hashtable_insert(types->index, string_buffer(key), index);
+    list_push(types->types, type);
+
+    snapshot_type_collect(types, type->pointer);
+    snapshot_type_collect(types, type->returntype);
+    if (type->fields)
+        for (list_iterator_t *it = list_iterator(table_values(type->fields)); !list_iterator_end(it); )
+            snapshot_type_collect(types, list_iterator_next(it));
+    if (type->parameters)
+        for (list_iterator_t *it = list_iterator(type->parameters); !list_iterator_end(it); )
+            snapshot_type_collect(types, list_iterator_next(it));
+}
+
+static void snapshot_types_save(FILE *output, snapshot_types_t *types) {
+    snapshot_write_int(output, list_length(types->types));
+    for (list_iterator_t *it = list_iterator(types->types); !list_iterator_end(it); ) {
+        data_type_t *type = list_iterator_next(it);
+
+        snapshot_write_int(output, type->type);
+        snapshot_write_int(output, type->size);
+        snapshot_write_int(output, type->sign);
+        snapshot_write_int(output, type->isstatic);
+        snapshot_write_int(output, type->length);
+        snapshot_write_int(output, snapshot_type_index(types, type->pointer));
+        snapshot_write_int(output, type->offset);
+        snapshot_write_int(output, type->isstruct);
+
+        if (!type->fields)
+            snapshot_write_int(output, -1);
+        else {
+            list_t *names  = table_keys(type->fields);
+            list_t *fields = table_values(type->fields);
+            snapshot_write_int(output, list_length(names));
+            for (list_iterator_t *jt = list_iterator(names), *kt = list_iterator(fields); !list_iterator_end(jt); ) {
+                snapshot_write_string(output, list_iterator_next(jt));
+                snapshot_write_int(output, snapshot_type_index(types, list_iterator_next(kt)));
+            }
+        }
+
+        snapshot_write_int(output, snapshot_type_index(types, type->returntype));
+        if (!type->parameters)
+            snapshot_write_int(output, -1);
+        else {
+            snapshot_write_int(output, list_length(type->parameters));
+            for (list_iterator_t *jt = list_iterator(type->parameters); !list_iterator_end(jt); )
+                snapshot_write_int(output, snapshot_type_index(types, list_iterator_next(jt)));
+        }
+        snapshot_write_int(output, type->hasdots);
+    }
+}
+
+static data_type_t *snapshot_type_find(snapshot_t *snapshot, data_type_t **types, long count) {
+    long index = snapshot_read_int(snapshot);
+    if (index == -1)
+        return NULL;
+    if (index <= -2 && index > -2 - AST_DATA_FUNCTION)
+        return ast_data_table[-2 - index];
+    if (index < 0 || index >= count)
+        compile_error("corrupt snapshot");
+    return types[index];
+}
+
+static data_type_t **snapshot_types_load(snapshot_t *snapshot, long *count) {
+    *count = snapshot_read_int(snapshot);
+    if (*count < 0)
+        compile_error("corrupt snapshot");
+
+    /* everything exists before anything is linked up */
+    data_type_t **types = memory_allocate(sizeof(data_type_t*) * (*count + 1));
+    for (long i = 0; i < *count; i++)
+        types[i] = memset(memory_allocate(sizeof(data_type_t)), 0, sizeof(data_type_t));
+
+    for (long i = 0; i < *count; i++) {
+        data_type_t *type = types[i];
+
+        type->type     = snapshot_read_int(snapshot);
+        type->size     = snapshot_read_int(snapshot);
+        type->sign     = snapshot_read_int(snapshot);
+        type->isstatic = snapshot_read_int(snapshot);
+        type->length   = snapshot_read_int(snapshot);
+        type->pointer  = snapshot_type_find(snapshot, types, *count);
+        type->offset   = snapshot_read_int(snapshot);
+        type->isstruct = snapshot_read_int(snapshot);
+
+        long fields = snapshot_read_int(snapshot);
+        if (fields >= 0) {
+            type->fields = table_create(NULL);
+            for (; fields > 0; fields--) {
+                char *name = snapshot_read_string(snapshot);
+                table_insert(type->fields, name, snapshot_type_find(snapshot, types, *count));
+            }
+        }
+
+        type->returntype = snapshot_type_find(snapshot, types, *count);
+
+        long parameters = snapshot_read_int(snapshot);
+        if (parameters >= 0) {
+            type->parameters = list_create();
+            for (; parameters > 0; parameters--)
+                list_push(type->parameters, snapshot_type_find(snapshot, types, *count));
+        }
+        type->hasdots = snapshot_read_int(snapshot);
+    }
+    return types;
+}
+
+/*
+ * The tables written, in this order. None of them have a parent at
+ * the point a snapshot is written since no function was defined.
+ */
+static table_t **snapshot_tables(void) {
+    static COMPILE_LOCAL table_t *tables[5];
+    tables[0] = ast_globalenv;
+    tables[1] = parse_typedefs;
+    tables[2] = ast_structures;
+    tables[3] = ast_unions;
+    tables[4] = NULL;
+    return tables;
+}
+
+/* the environment holds declarations and enumeration constants */
+static bool snapshot_table_environment(int table) {
+    return table == 0;
+}
+
+/*
+ * The contents of the header are hashed rather than its time checked,
+ * a header which is only touched doesn't spoil the snapshot.
+ */
+static unsigned long snapshot_header_hash(const char *header, long *size) {
+    int           fd   = open(header, O_RDONLY);
+    unsigned long hash = HASH_INITIAL;
+    struct stat   st;
+
+    if (fd == -1 || fstat(fd, &st) == -1) {
+        if (fd != -1)
+            close(fd);
+        *size = -1;
+        return 0;
+    }
+
+    *size = st.st_size;
+    if (st.st_size) {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+            compile_error("cannot map `%s'", header);
+        hash = hash_bytes(hash, data, st.st_size);
+        munmap(data, st.st_size);
+    }
+    close(fd);
+    return hash;
+}
+
+void snapshot_save(const char *file, const char *header) {
+    if (!header)
+        compile_error("only a header read from a file can be precompiled");
+
+    char *path = realpath(header, NULL);
+    long  size;
+    if (!path)
+        compile_error("cannot open `%s'", header);
+    unsigned long hash = snapshot_header_hash(path, &size);
+
+    FILE *output = fopen(file, "w");
+    if (!output)
+        compile_error("cannot open output `%s'", file);
+
+    snapshot_types_t types = {
+        .types = list_create(),
+        .index = hashtable_create()
+    };
+
+    table_t **tables = snapshot_tables();
+    for (int i = 0; tables[i]; i++) {
+        for (list_iterator_t *it = list_iterator(table_values(tables[i])); !list_iterator_end(it); ) {
+            void *value = list_iterator_next(it);
+            snapshot_type_collect(&types, snapshot_table_environment(i)
+                                              ? ((ast_t*)value)->ctype
+                                              : value);
+        }
+    }
+
+    snapshot_write_string(output, snapshot_magic);
+    snapshot_write_string(output, snapshot_build);
+    snapshot_write_string(output, path);
+    snapshot_write_int(output, size);
+    snapshot_write_int(output, hash);
+    free(path);
+
+    snapshot_types_save(output, &types);
+
+    for (int i = 0; tables[i]; i++) {
+        list_t *keys   = table_keys(tables[i]);
+        list_t *values = table_values(tables[i]);
+
+        snapshot_write_int(output, list_length(keys));
+        for (list_iterator_t *it = list_iterator(keys), *jt = list_iterator(values); !list_iterator_end(it); ) {
+            char *name  = list_iterator_next(it);
+            void *value = list_iterator_next(jt);
+
+            snapshot_write_string(output, name);
+            if (!snapshot_table_environment(i)) {
+                snapshot_write_int(output, snapshot_type_index(&types, value));
+                continue;
+            }
+
+            ast_t *ast = value;
+            if (ast->type != AST_TYPE_VAR_GLOBAL && ast->type != AST_TYPE_LITERAL)
+                compile_error("ICE: %s", __func__);
+            snapshot_write_int(output, ast->type);
+            snapshot_write_int(output, snapshot_type_index(&types, ast->ctype));
+            if (ast->type == AST_TYPE_LITERAL)
+                snapshot_write_int(output, ast->integer);
+            else
+                snapshot_write_int(output, ast->variable.attributes);
+        }
+    }
+
+    lexer_snapshot_save(output);
+    fclose(output);
+}
+
+void snapshot_open(const char *file) {
+    int         fd = open(file, O_RDONLY);
+    struct stat st;
+
+    if (fd == -1 || fstat(fd, &st) == -1)
+        compile_error("cannot open snapshot `%s'", file);
+
+    snapshot_mapped.size     = st.st_size;
+    snapshot_mapped.position = 0;
+    snapshot_mapped.data     = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (snapshot_mapped.data == MAP_FAILED)
+        compile_error("cannot map snapshot `%s'", file);
+
+    char *magic = snapshot_read_string(&snapshot_mapped);
+    char *build = snapshot_read_string(&snapshot_mapped);
+    if (!magic || strcmp(magic, snapshot_magic))
+        compile_error("`%s' is not a snapshot", file);
+    if (!build || strcmp(build, snapshot_build))
+        compile_error("`%s' was written by a different compiler", file);
+
+    char          *header = snapshot_read_string(&snapshot_mapped);
+    long           size   = snapshot_read_int(&snapshot_mapped);
+    unsigned long  hash   = snapshot_read_int(&snapshot_mapped);
+    long           actual;
+    if (!header)
+        compile_error("corrupt snapshot");
+    if (snapshot_header_hash(header, &actual) != hash || actual != size)
+        compile_error("`%s' is out of date, `%s' changed since it was written", file, header);
+
+    snapshot_header = header;
+    snapshot_opened = true;
+    snapshot_hash   = hash_bytes(HASH_INITIAL, snapshot_mapped.data, snapshot_mapped.size);
+}
+
+bool snapshot_match(const char *header) {
+    return snapshot_opened && !strcmp(header, snapshot_header);
+}
+
+void snapshot_load(void) {
+    if (!snapshot_opened)
+        return;
+
+    /* every unit reads the mapping from after the header */
+    snapshot_t    snapshot = snapshot_mapped;
+    long          count;
+    data_type_t **types    = snapshot_types_load(&snapshot, &count);
+    table_t     **tables   = snapshot_tables();
+
+    for (int i = 0; tables[i]; i++) {
+        for (long entries = snapshot_read_int(&snapshot); entries > 0; entries--) {
+            char *name = snapshot_read_string(&snapshot);
+            if (!snapshot_table_environment(i)) {
+                table_insert(tables[i], name, snapshot_type_find(&snapshot, types, count));
+                continue;
+            }
+
+            int          kind  = snapshot_read_int(&snapshot);
+            data_type_t *ctype = snapshot_type_find(&snapshot, types, count);
+
+            if (kind == AST_TYPE_VAR_GLOBAL)
+                ast_variable_global(ctype, name)->variable.attributes = snapshot_read_int(&snapshot);
+            else if (kind == AST_TYPE_LITERAL)
+                table_insert(tables[i], name, ast_new_integer(ctype, snapshot_read_int(&snapshot)));
+            else
+                compile_error("corrupt snapshot");
+        }
+    }
+
+    lexer_snapshot_load(&snapshot);
+}
+
+unsigned long snapshot_digest(void) {
+    return snapshot_hash;
+}
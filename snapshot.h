@@ -0,0 +1,114 @@
+#ifndef LICE_SNAPSHOT_HDR
+#define LICE_SNAPSHOT_HDR
+/*
+ * File: snapshot.h
+ *  Implements the interface for LICE's precompiled header snapshots
+ */
+#include <stdio.h>
+#include <stdbool.h>
+
+/*
+ * Struct: snapshot_t
+ *  A snapshot being read.
+ *
+ * Remarks:
+ *  The data is the mapped snapshot file, strings read from it point
+ *  into the mapping rather than being copied.
+ */
+typedef struct {
+    /*
+     * Variable: data
+     *  Contents of the snapshot file
+     */
+    const char *data;
+
+    /*
+     * Variable: size
+     *  Size of the snapshot file
+     */
+    size_t size;
+
+    /*
+     * Variable: position
+     *  Where the next value is read from
+     */
+    size_t position;
+} snapshot_t;
+
+/*
+ * Function: snapshot_open
+ *  Map a snapshot to start every translation unit from.
+ *
+ * Parameters:
+ *  file    - The snapshot file written by <snapshot_save>
+ *
+ * Remarks:
+ *  Must be called before any translation unit is compiled, the
+ *  mapping is shared by all of them. A snapshot of a header which
+ *  changed since it was written is an error.
+ */
+void snapshot_open(const char *file);
+
+/*
+ * Function: snapshot_match
+ *  Checks if the mapped snapshot was written from a header.
+ *
+ * Parameters:
+ *  header  - The real path of the header
+ */
+bool snapshot_match(const char *header);
+
+/*
+ * Function: snapshot_load
+ *  Restore the declarations and macros of the mapped snapshot into
+ *  the translation unit being compiled.
+ *
+ * Remarks:
+ *  Does nothing when no snapshot was opened. It is loaded by the
+ *  lexer in place of the header it was written from, when that is
+ *  the first thing the unit includes.
+ */
+void snapshot_load(void);
+
+/*
+ * Function: snapshot_save
+ *  Write the declarations and macros of the translation unit just
+ *  parsed to a snapshot file.
+ *
+ * Parameters:
+ *  file    - The snapshot file to write
+ *  header  - The header which was parsed
+ */
+void snapshot_save(const char *file, const char *header);
+
+/*
+ * Function: snapshot_digest
+ *  Hash of the mapped snapshot, or 0 when there is none.
+ */
+unsigned long snapshot_digest(void);
+
+/*
+ * Function: snapshot_write_int
+ *  Write an integer to a snapshot being saved
+ */
+void snapshot_write_int(FILE *output, long value);
+
+/*
+ * Function: snapshot_write_string
+ *  Write a string, or NULL, to a snapshot being saved
+ */
+void snapshot_write_string(FILE *output, const char *string);
+
+/*
+ * Function: snapshot_read_int
+ *  Read an integer written by <snapshot_write_int>
+ */
+long snapshot_read_int(snapshot_t *snapshot);
+
+/*
+ * Function: snapshot_read_string
+ *  Read a string written by <snapshot_write_string>
+ */
+char *snapshot_read_string(snapshot_t *snapshot);
+
+#endif
@@ -0,0 +1,120 @@
+struct aggregate_point {
+    int x;
+    int y;
+};
+
+struct aggregate_shape {
+    char                   tag;
+    struct aggregate_point origin;
+    long                   area;
+    short                  sides;
+};
+
+struct aggregate_large {
+    int  values[50];
+    char name[7];
+};
+
+struct aggregate_shape aggregate_global;
+
+int aggregate_sum(int *values, int count) {
+    int sum = 0;
+    for (int i = 0; i < count; i++)
+        sum += values[i];
+    return sum;
+}
+
+void aggregate_dirty(void) {
+    int  garbage[100];
+    for (int i = 0; i < 100; i++)
+        garbage[i] = -1;
+    expecti(aggregate_sum(garbage, 100), -100);
+}
+
+void aggregate_small(void) {
+    int values[5] = { 1, 2 };
+    expecti(aggregate_sum(values, 5), 3);
+    expecti(values[4], 0);
+
+    struct aggregate_shape shape = { 's', { 0, 4 } };
+    expecti(shape.tag, 's');
+    expecti(shape.origin.x, 0);
+    expecti(shape.origin.y, 4);
+    expectl(shape.area, 0);
+    expecti(shape.sides, 0);
+}
+
+void aggregate_big(void) {
+    int values[100] = { 7 };
+    expecti(aggregate_sum(values, 100), 7);
+
+    char text[40] = "abc";
+    expects(text, "abc");
+    expecti(text[39], 0);
+}
+
+void test_initialization() {
+    /* stale values on the stack must not leak through */
+    aggregate_dirty();
+    aggregate_small();
+    aggregate_dirty();
+    aggregate_big();
+}
+
+void test_assignment() {
+    struct aggregate_shape a = { 'a', { 1, 2 }, 300, 4 };
+    struct aggregate_shape b;
+    struct aggregate_shape *p = &b;
+
+    b = a;
+    expecti(b.tag, 'a');
+    expecti(b.origin.x, 1);
+    expecti(b.origin.y, 2);
+    expectl(b.area, 300);
+    expecti(b.sides, 4);
+
+    a.origin.y = 20;
+    expecti(p->origin.y, 2);
+
+    struct aggregate_point point = a.origin;
+    expecti(point.x, 1);
+    expecti(point.y, 20);
+
+    p->origin = point;
+    expecti(b.origin.y, 20);
+    expecti(b.sides, 4);
+
+    aggregate_global = b;
+    expecti(aggregate_global.origin.y, 20);
+    expectl(aggregate_global.area, 300);
+
+    int *y = &b.origin.y;
+    expecti(*y, 20);
+}
+
+void test_large() {
+    struct aggregate_large a;
+    struct aggregate_large b;
+
+    for (int i = 0; i < 50; i++)
+        a.values[i] = i;
+    a.name[0] = 'l';
+    a.name[6] = 0;
+
+    b = a;
+    expecti(aggregate_sum(b.values, 50), 1225);
+    expecti(b.name[0], 'l');
+
+    struct aggregate_large c = b;
+    expecti(c.values[49], 49);
+}
+
+int main() {
+    init("aggregate initialization and copy");
+
+    test_initialization();
+    test_assignment();
+    test_large();
+
+    return ok();
+}
@@ -0,0 +1,50 @@
+int attribute_fail(int code) __attribute__((cold, noreturn));
+int attribute_log(const char *format, int value) __attribute__((format(printf, 1, 2), __cold__));
+
+__attribute__((hot)) int attribute_add(int a, int b) {
+    return a + b;
+}
+
+static __attribute__((noinline)) int attribute_twice(int value) {
+    return value * 2;
+}
+
+int attribute_fail(int code) {
+    exit(code);
+    return code;
+}
+
+int attribute_log(const char *format, int value) {
+    return value;
+}
+
+int attribute_check(int value) {
+    if (__builtin_expect(value > 100, 0))
+        return attribute_fail(2);
+    if (value < 0)
+        return attribute_log("negative %d", value);
+    if (__builtin_expect(value == 7, 1))
+        value = attribute_twice(value);
+    else
+        value = attribute_add(value, 1);
+    return value;
+}
+
+int main() {
+    init("function attributes and hints");
+
+    expecti(attribute_add(2, 3), 5);
+    expecti(attribute_twice(21), 42);
+    expecti(attribute_check(7), 14);
+    expecti(attribute_check(8), 9);
+    expecti(attribute_check(50), 51);
+    expecti(__builtin_expect(3 + 4, 7), 7);
+
+    int hits = 0;
+    for (int i = 0; i < 10; i++)
+        if (__builtin_expect(i == 9, 0))
+            hits++;
+    expecti(hits, 1);
+
+    return ok();
+}
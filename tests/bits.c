@@ -0,0 +1,76 @@
+unsigned int bits_rotl(unsigned int value, int count) {
+    return (value << count) | (value >> (32 - count));
+}
+
+unsigned int bits_rotr(unsigned int value, int count) {
+    return (value >> count) | (value << (32 - count));
+}
+
+unsigned long bits_rotl64(unsigned long value) {
+    return (value << 13) | (value >> 51);
+}
+
+unsigned int bits_hash(const char *string) {
+    unsigned int hash = 0x9E3779B9;
+    for (; *string; string++) {
+        hash = hash ^ *string;
+        hash = (hash << 5) + (hash >> 27);
+    }
+    return hash;
+}
+
+/* long literals are kept in an int, so wide values are built up */
+unsigned long bits_wide(unsigned long high, unsigned long low) {
+    return (high << 32) | low;
+}
+
+int bits_lowest(unsigned long set) {
+    return set ? __builtin_ctzl(set) : -1;
+}
+
+int main() {
+    init("bit builtins");
+
+    expecti(__builtin_popcount(0), 0);
+    expecti(__builtin_popcount(0xFF), 8);
+    expecti(__builtin_popcount(0xFFFFFFFF), 32);
+    expecti(__builtin_popcountl(bits_wide(0x0F0F0F0F, 0x0F0F0F0F)), 32);
+    expecti(__builtin_popcountll(~0UL), 64);
+    expecti(__builtin_popcountl(1), 1);
+
+    expecti(__builtin_clz(1), 31);
+    expecti(__builtin_clz(0x80000000), 0);
+    expecti(__builtin_clzl(1), 63);
+    expecti(__builtin_clzll(bits_wide(1, 0)), 31);
+
+    expecti(__builtin_ctz(8), 3);
+    expecti(__builtin_ctz(0x80000000), 31);
+    expecti(__builtin_ctzl(bits_wide(1, 0)), 32);
+    expecti(bits_lowest(0), -1);
+    expecti(bits_lowest(0x50), 4);
+
+    /* masked and shifted words are as wide as what they are made of */
+    unsigned long all = ~0;
+    unsigned long one = 1;
+    expecti(__builtin_ctzl(all & (all << 36)), 36);
+    expecti(__builtin_ctzll(one << 40), 40);
+    expecti(__builtin_clzl(one << 40), 23);
+    expecti(__builtin_popcountl(all & (one << 50)), 1);
+
+    expecti(__builtin_bswap16(0x1234), 0x3412);
+    expecti(__builtin_bswap32(0x12345678), 0x78563412);
+    expectl(__builtin_bswap64(bits_wide(0x01020304, 0x05060708)), bits_wide(0x08070605, 0x04030201));
+
+    expecti(bits_rotl(0x80000001, 1), 3);
+    expecti(bits_rotl(0x12345678, 8), 0x34567812);
+    expecti(bits_rotr(3, 1), 0x80000001);
+    expectl(bits_rotl64(bits_wide(0x80000000, 1)), 0x3000);
+    expecti(bits_hash("lice"), -1653808169);
+
+    int table[4] = { 1, 2, 3, 4 };
+    __builtin_prefetch(table);
+    __builtin_prefetch(table + 2, 1, 0);
+    expecti(table[2], 3);
+
+    return ok();
+}
@@ -0,0 +1,74 @@
+enum {
+    OP_PUSH,
+    OP_ACCUMULATE,
+    OP_DEC,
+    OP_JNZ,
+    OP_HALT
+};
+
+int computedgoto_run(int *code) {
+    void *dispatch[] = { &&push, &&accumulate, &&dec, &&jnz, &&halt };
+    int   stack[8];
+    int   sp = 0;
+    int   pc = 0;
+
+    goto *dispatch[code[pc]];
+
+push:
+    stack[sp++] = code[pc + 1];
+    pc += 2;
+    goto *dispatch[code[pc]];
+
+accumulate:
+    stack[sp - 2] += stack[sp - 1];
+    pc++;
+    goto *dispatch[code[pc]];
+
+dec:
+    stack[sp - 1]--;
+    pc++;
+    goto *dispatch[code[pc]];
+
+jnz:
+    if (stack[sp - 1]) {
+        pc = code[pc + 1];
+        goto *dispatch[code[pc]];
+    }
+    pc += 2;
+    goto *dispatch[code[pc]];
+
+halt:
+    return stack[0];
+}
+
+int computedgoto_select(int which) {
+    void *target = &&zero;
+    if (which)
+        target = &&one;
+    goto *target;
+
+zero:
+    return 10;
+one:
+    return 20;
+}
+
+int main() {
+    init("computed goto");
+
+    /* sums 10 down to 1 */
+    int program[] = {
+        OP_PUSH, 0,
+        OP_PUSH, 10,
+        OP_ACCUMULATE,
+        OP_DEC,
+        OP_JNZ,  4,
+        OP_HALT
+    };
+
+    expecti(computedgoto_run(program), 55);
+    expecti(computedgoto_select(0), 10);
+    expecti(computedgoto_select(1), 20);
+
+    return ok();
+}
@@ -0,0 +1,158 @@
+struct point {
+    int x;
+    int y;
+};
+
+int cse_global = 3;
+
+int cse_bump(void) {
+    cse_global++;
+    return 0;
+}
+
+void cse_store(int *p, int value) {
+    *p = value;
+}
+
+int cse_length(struct point *p) {
+    return p->x * p->x + p->y * p->y;
+}
+
+void test_expression() {
+    struct point p;
+    int a = 6;
+    int b = 7;
+    int c;
+
+    p.x = 3;
+    p.y = 4;
+    expecti(cse_length(&p), 25);
+
+    c = a * b + a * b;
+    expecti(c, 84);
+    c = (a + b) * (a + b) - (a + b);
+    expecti(c, 156);
+
+    double d;
+    double e;
+    d = 1.5;
+    e = d * d + d * d;
+    expectd(e, 4.5);
+}
+
+void test_array() {
+    int values[4];
+    int i = 2;
+
+    values[0] = 1;
+    values[1] = 2;
+    values[2] = 3;
+    values[3] = 4;
+
+    expecti(values[i] + values[i], 6);
+
+    /* the store through values must not reuse the earlier load */
+    int before = values[i];
+    values[i] = 10;
+    expecti(values[i] + before, 13);
+
+    /* nor a load through a pointer which aliases it */
+    int *alias = &values[2];
+    before = values[i];
+    *alias = 20;
+    expecti(values[i], 20);
+    expecti(before, 10);
+
+    /* nor a change of the index */
+    before = values[i];
+    i++;
+    expecti(values[i], 4);
+    expecti(before, 20);
+}
+
+void test_alias() {
+    int a = 5;
+    int b = 2;
+
+    int before = a * b;
+    cse_store(&a, 7);
+    expecti(a * b, 14);
+    expecti(before, 10);
+
+    int g = cse_global * 2;
+    cse_bump();
+    expecti(cse_global * 2, 8);
+    expecti(g, 6);
+
+    b = 3;
+    before = b * b;
+    b += 1;
+    expecti(b * b, 16);
+    expecti(before, 9);
+
+    struct point v;
+    v.x = 1;
+    int *p = &v.x;
+    int t = v.x + 1;
+    *p = 5;
+    int u = v.x + 1;
+    expecti(t, 2);
+    expecti(u, 6);
+}
+
+void test_control() {
+    int a = 3;
+    int b = 4;
+    int c = 0;
+    int i;
+
+    int before = a * b;
+    if (a > 5)
+        a = 10;
+    expecti(a * b, 12);
+    if (a < 5)
+        a = 10;
+    expecti(a * b, 40);
+    expecti(before, 12);
+
+    a = 3;
+    for (i = 0; i < 3; i++)
+        c += a * b;
+    expecti(c, 36);
+
+    c = 0;
+    for (i = 0; i < 3; i++) {
+        c += a * b;
+        a++;
+    }
+    expecti(c, 12 + 16 + 20);
+
+    a = 2;
+    c = a * b > 5 ? a * b : 0;
+    expecti(c, 8);
+    c = (a > 5 && (a = 1)) ? 0 : a * b;
+    expecti(c, 8);
+
+    c = 0;
+    i = 0;
+    a = 1;
+    goto skip;
+again:
+    a = 5;
+skip:
+    c += a * b;
+    if (i++ == 0)
+        goto again;
+    expecti(c, 4 + 20);
+}
+
+int main() {
+    init("common subexpression elimination");
+
+    test_expression();
+    test_array();
+    test_alias();
+    test_control();
+
+    return ok();
+}
@@ -0,0 +1,64 @@
+struct data_record {
+    char   tag;
+    int    value;
+    long   big;
+    short  small;
+    double real;
+};
+
+int                data_table[4096] = { 1, 2, 3 };
+int                data_tail[64]    = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 7 };
+char               data_name[16]    = "tab\there \"q\"";
+struct data_record data_record      = { 'r', 42, 100000, 12, 2.5 };
+double             data_reals[3]    = { 1.5, 0, 3.25 };
+float              data_floats[2]   = { 0.5, 8 };
+long               data_longs[2]    = { 0, 1 };
+char               data_bytes[12]   = { 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2 };
+
+void test_scalars() {
+    expecti(data_table[0], 1);
+    expecti(data_table[2], 3);
+    expecti(data_table[3], 0);
+    expecti(data_table[4095], 0);
+    expecti(data_tail[9], 0);
+    expecti(data_tail[10], 7);
+    expecti(data_tail[11], 0);
+    expectl(data_longs[0], 0);
+    expectl(data_longs[1], 1);
+}
+
+void test_bytes() {
+    expects(data_name, "tab\there \"q\"");
+    expecti(data_name[15], 0);
+    expecti(data_bytes[0], 1);
+    expecti(data_bytes[5], 0);
+    expecti(data_bytes[11], 2);
+}
+
+void test_record() {
+    expecti(data_record.tag, 'r');
+    expecti(data_record.value, 42);
+    expectl(data_record.big, 100000);
+    expecti(data_record.small, 12);
+}
+
+void test_floating() {
+    double *reals  = data_reals;
+    float  *floats = data_floats;
+    expectd(reals[0], 1.5);
+    expectd(reals[1], 0);
+    expectd(reals[2], 3.25);
+    expectf(floats[0], 0.5);
+    expectf(floats[1], 8);
+}
+
+int main() {
+    init("global data");
+
+    test_scalars();
+    test_bytes();
+    test_record();
+    test_floating();
+
+    return ok();
+}
@@ -0,0 +1,114 @@
+// these are never defined, referencing them from code that
+// survives dead code elimination will fail to link.
+void dead_undefined(void);
+int  dead_undefined_value(void);
+
+static int dead_unused(void) {
+    return dead_undefined_value();
+}
+
+static int dead_helper(void);
+static int dead_counter = 0;
+
+int dead_helper(void) {
+    return ++dead_counter;
+}
+
+static int dead_used(int a) {
+    return a + dead_helper();
+}
+
+int dead_return(int a) {
+    if (a > 10)
+        return 1;
+    return 2;
+    dead_undefined();
+    return 3;
+}
+
+void test_unreachable() {
+    int i = 0;
+
+    expecti(dead_return(20), 1);
+    expecti(dead_return(5), 2);
+
+    while (1) {
+        if (i == 5)
+            break;
+        i++;
+        continue;
+        dead_undefined();
+    }
+    expecti(i, 5);
+
+    goto skip;
+    dead_undefined();
+skip:
+    i++;
+    expecti(i, 6);
+}
+
+void test_constant() {
+    int i = 0;
+
+    if (0)
+        dead_undefined();
+    if (1)
+        i++;
+    else
+        dead_undefined();
+    if (2 - 2 == 0 && sizeof(int) == 4)
+        i++;
+    expecti(i, 2);
+
+    while (0)
+        dead_undefined();
+
+    for (i = 10; 0; )
+        dead_undefined();
+    expecti(i, 10);
+
+    do {
+        i++;
+    } while (0);
+    expecti(i, 11);
+}
+
+void test_labelled() {
+    int i = 0;
+
+    goto inside;
+    if (0) {
+inside:
+        i = 1;
+    }
+    expecti(i, 1);
+
+    switch (i) {
+        dead_undefined();
+    case 1:
+        i = 2;
+        break;
+        dead_undefined();
+    default:
+        i = 3;
+    }
+    expecti(i, 2);
+}
+
+void test_static() {
+    expecti(dead_used(1), 2);
+    expecti(dead_used(1), 3);
+    expecti(dead_counter, 2);
+}
+
+int main() {
+    init("dead code elimination");
+
+    test_unreachable();
+    test_constant();
+    test_labelled();
+    test_static();
+
+    return ok();
+}
@@ -0,0 +1,26 @@
+#include "tests/include/debug.h"
+
+int debug_sum(int n) {
+    int sum = 0;
+    for (int i = 0; i < n; i++)
+        sum += DEBUG_SQUARE(i);
+    return sum;
+}
+
+int debug_tail(int n) {
+    if (n <= 0)
+        return 0;
+    return debug_tail(n - 1);
+}
+
+int main() {
+    init("line tables and call frames");
+
+    expecti(debug_sum(4), 14);
+    expecti(debug_clamp(5, 10, 20), 10);
+    expecti(debug_clamp(50, 0, 10), 10);
+    expecti(debug_clamp(5, 0, 10), 5);
+    expecti(debug_tail(100), 0);
+
+    return ok();
+}
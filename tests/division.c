@@ -0,0 +1,335 @@
+// division and modulo by constants against the idiv path
+void sweep_int(int x, int i) {
+    int d;
+    d = 1;
+    expecti(x / 1, x / d);
+    expecti(x % 1, x % d);
+    if (i < 17) {
+        d = -1;
+        expecti(x / -1, x / d);
+        expecti(x % -1, x % d);
+    }
+    d = 2;
+    expecti(x / 2, x / d);
+    expecti(x % 2, x % d);
+    d = -2;
+    expecti(x / -2, x / d);
+    expecti(x % -2, x % d);
+    d = 3;
+    expecti(x / 3, x / d);
+    expecti(x % 3, x % d);
+    d = -3;
+    expecti(x / -3, x / d);
+    expecti(x % -3, x % d);
+    d = 5;
+    expecti(x / 5, x / d);
+    expecti(x % 5, x % d);
+    d = 7;
+    expecti(x / 7, x / d);
+    expecti(x % 7, x % d);
+    d = -7;
+    expecti(x / -7, x / d);
+    expecti(x % -7, x % d);
+    d = 10;
+    expecti(x / 10, x / d);
+    expecti(x % 10, x % d);
+    d = 16;
+    expecti(x / 16, x / d);
+    expecti(x % 16, x % d);
+    d = -16;
+    expecti(x / -16, x / d);
+    expecti(x % -16, x % d);
+    d = 25;
+    expecti(x / 25, x / d);
+    expecti(x % 25, x % d);
+    d = 100;
+    expecti(x / 100, x / d);
+    expecti(x % 100, x % d);
+    d = 641;
+    expecti(x / 641, x / d);
+    expecti(x % 641, x % d);
+    d = 1000;
+    expecti(x / 1000, x / d);
+    expecti(x % 1000, x % d);
+    d = -1000;
+    expecti(x / -1000, x / d);
+    expecti(x % -1000, x % d);
+    d = 4096;
+    expecti(x / 4096, x / d);
+    expecti(x % 4096, x % d);
+    d = 65536;
+    expecti(x / 65536, x / d);
+    expecti(x % 65536, x % d);
+    d = 1000000;
+    expecti(x / 1000000, x / d);
+    expecti(x % 1000000, x % d);
+    d = 2147483647;
+    expecti(x / 2147483647, x / d);
+    expecti(x % 2147483647, x % d);
+}
+
+void sweep_long(long x, int i) {
+    long d;
+    d = 1;
+    expectl(x / 1, x / d);
+    expectl(x % 1, x % d);
+    if (i < 13) {
+        d = -1;
+        expectl(x / -1, x / d);
+        expectl(x % -1, x % d);
+    }
+    d = 2;
+    expectl(x / 2, x / d);
+    expectl(x % 2, x % d);
+    d = -2;
+    expectl(x / -2, x / d);
+    expectl(x % -2, x % d);
+    d = 3;
+    expectl(x / 3, x / d);
+    expectl(x % 3, x % d);
+    d = -3;
+    expectl(x / -3, x / d);
+    expectl(x % -3, x % d);
+    d = 5;
+    expectl(x / 5, x / d);
+    expectl(x % 5, x % d);
+    d = 7;
+    expectl(x / 7, x / d);
+    expectl(x % 7, x % d);
+    d = -7;
+    expectl(x / -7, x / d);
+    expectl(x % -7, x % d);
+    d = 10;
+    expectl(x / 10, x / d);
+    expectl(x % 10, x % d);
+    d = 16;
+    expectl(x / 16, x / d);
+    expectl(x % 16, x % d);
+    d = -16;
+    expectl(x / -16, x / d);
+    expectl(x % -16, x % d);
+    d = 25;
+    expectl(x / 25, x / d);
+    expectl(x % 25, x % d);
+    d = 100;
+    expectl(x / 100, x / d);
+    expectl(x % 100, x % d);
+    d = 641;
+    expectl(x / 641, x / d);
+    expectl(x % 641, x % d);
+    d = 1000;
+    expectl(x / 1000, x / d);
+    expectl(x % 1000, x % d);
+    d = -1000;
+    expectl(x / -1000, x / d);
+    expectl(x % -1000, x % d);
+    d = 4096;
+    expectl(x / 4096, x / d);
+    expectl(x % 4096, x % d);
+    d = 65536;
+    expectl(x / 65536, x / d);
+    expectl(x % 65536, x % d);
+    d = 1000000;
+    expectl(x / 1000000, x / d);
+    expectl(x % 1000000, x % d);
+    d = 2147483647;
+    expectl(x / 2147483647, x / d);
+    expectl(x % 2147483647, x % d);
+}
+
+void test_int() {
+    int values[] = {
+        0, 1, -1, 2, -2, 3, -3, 7, -7, 100, -100, 12345, -12345,
+        65535, -65536, 2147483647, -2147483647, 0
+    };
+    values[17] = -2147483647 - 1;
+    for (int i = 0; i < 18; i++)
+        sweep_int(values[i], i);
+
+    expecti(7 / 2, 3);
+    expecti(-7 / 2, -3);
+    expecti(7 / -2, -3);
+    expecti(-7 % 2, -1);
+    expecti(7 % -2, 1);
+    expecti(100 / 10, 10);
+    expecti(-100 / 7, -14);
+    expecti(-100 % 7, -2);
+}
+
+void test_long() {
+    long one = 1;
+    long max = (one << 62) - 1 + (one << 62);
+    long big = 1234567;
+    big = big * 1000000 + 890123;
+
+    long values[14];
+    values[0]  = 0;
+    values[1]  = 1;
+    values[2]  = -1;
+    values[3]  = 7;
+    values[4]  = -7;
+    values[5]  = one << 32;
+    values[6]  = 0 - (one << 32);
+    values[7]  = big;
+    values[8]  = 0 - big;
+    values[9]  = (one << 32) - 1;
+    values[10] = one << 31;
+    values[11] = 0 - (one << 31);
+    values[12] = max;
+    values[13] = 0 - max - 1;
+    for (int i = 0; i < 14; i++)
+        sweep_long(values[i], i);
+
+    expectl(big / 1000, 1234567890);
+    expectl(big % 1000, 123);
+    expectl((0 - big) / 1000, -1234567890);
+    expectl((0 - big) % 1000, -123);
+}
+
+void sweep_unsigned(unsigned int x) {
+    unsigned int d;
+    d = 1;
+    expecti(x / 1, x / d);
+    expecti(x % 1, x % d);
+    d = 2;
+    expecti(x / 2, x / d);
+    expecti(x % 2, x % d);
+    d = 3;
+    expecti(x / 3, x / d);
+    expecti(x % 3, x % d);
+    d = 5;
+    expecti(x / 5, x / d);
+    expecti(x % 5, x % d);
+    d = 7;
+    expecti(x / 7, x / d);
+    expecti(x % 7, x % d);
+    d = 10;
+    expecti(x / 10, x / d);
+    expecti(x % 10, x % d);
+    d = 16;
+    expecti(x / 16, x / d);
+    expecti(x % 16, x % d);
+    d = 25;
+    expecti(x / 25, x / d);
+    expecti(x % 25, x % d);
+    d = 100;
+    expecti(x / 100, x / d);
+    expecti(x % 100, x % d);
+    d = 641;
+    expecti(x / 641, x / d);
+    expecti(x % 641, x % d);
+    d = 1000;
+    expecti(x / 1000, x / d);
+    expecti(x % 1000, x % d);
+    d = 4096;
+    expecti(x / 4096, x / d);
+    expecti(x % 4096, x % d);
+    d = 65536;
+    expecti(x / 65536, x / d);
+    expecti(x % 65536, x % d);
+    d = 1000000;
+    expecti(x / 1000000, x / d);
+    expecti(x % 1000000, x % d);
+    d = 2147483647;
+    expecti(x / 2147483647, x / d);
+    expecti(x % 2147483647, x % d);
+}
+
+void sweep_unsigned_long(unsigned long x) {
+    unsigned long d;
+    d = 1;
+    expectl(x / 1, x / d);
+    expectl(x % 1, x % d);
+    d = 2;
+    expectl(x / 2, x / d);
+    expectl(x % 2, x % d);
+    d = 3;
+    expectl(x / 3, x / d);
+    expectl(x % 3, x % d);
+    d = 5;
+    expectl(x / 5, x / d);
+    expectl(x % 5, x % d);
+    d = 7;
+    expectl(x / 7, x / d);
+    expectl(x % 7, x % d);
+    d = 10;
+    expectl(x / 10, x / d);
+    expectl(x % 10, x % d);
+    d = 16;
+    expectl(x / 16, x / d);
+    expectl(x % 16, x % d);
+    d = 25;
+    expectl(x / 25, x / d);
+    expectl(x % 25, x % d);
+    d = 100;
+    expectl(x / 100, x / d);
+    expectl(x % 100, x % d);
+    d = 641;
+    expectl(x / 641, x / d);
+    expectl(x % 641, x % d);
+    d = 1000;
+    expectl(x / 1000, x / d);
+    expectl(x % 1000, x % d);
+    d = 4096;
+    expectl(x / 4096, x / d);
+    expectl(x % 4096, x % d);
+    d = 65536;
+    expectl(x / 65536, x / d);
+    expectl(x % 65536, x % d);
+    d = 1000000;
+    expectl(x / 1000000, x / d);
+    expectl(x % 1000000, x % d);
+    d = 2147483647;
+    expectl(x / 2147483647, x / d);
+    expectl(x % 2147483647, x % d);
+}
+
+void test_unsigned() {
+    unsigned int values[8];
+    values[0] = 0;
+    values[1] = 1;
+    values[2] = 7;
+    values[3] = 2147483647;
+    values[4] = 2147483648;
+    values[5] = 3000000001;
+    values[6] = 4000000000;
+    values[7] = 4294967295;
+    for (int i = 0; i < 8; i++)
+        sweep_unsigned(values[i]);
+
+    unsigned int a = 4000000000;
+    unsigned int b = 7;
+    expecti(a / 2, 2000000000);
+    expecti(a % 7, 3);
+    expecti(a / b, 571428571);
+    expecti(a % b, 3);
+}
+
+void test_unsigned_long() {
+    unsigned long one = 1;
+    unsigned long values[6];
+    values[0] = 0;
+    values[1] = 7;
+    values[2] = one << 32;
+    values[3] = one << 63;
+    values[4] = (one << 63) + (one << 62) + 12345;
+    values[5] = 0 - one;
+    for (int i = 0; i < 6; i++)
+        sweep_unsigned_long(values[i]);
+
+    unsigned long top = one << 63;
+    unsigned long ten = 10;
+    expectl(top / 10 * 10 + top % 10, top);
+    expectl(top % 10, 8);
+    expectl(top / ten, top / 10);
+    expectl(top % ten, 8);
+}
+
+int main() {
+    init("division by constants");
+    test_int();
+    test_long();
+    test_unsigned();
+    test_unsigned_long();
+    return ok();
+}
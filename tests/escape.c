@@ -0,0 +1,78 @@
+void escape_set(int *p, int value) {
+    *p = value;
+}
+
+int escape_fib(int n) {
+    int a = 0;
+    int b = 1;
+    int t;
+    for (int i = 0; i < n; i++) {
+        t = a + b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* more candidates than callee saved registers, used across calls */
+int escape_many(int n) {
+    int a = 1;
+    int b = 2;
+    int c = 3;
+    int d = 4;
+    int e = 5;
+    int f = 6;
+    int g = 7;
+    for (int i = 0; i < n; i++) {
+        a += escape_fib(i);
+        b += a;
+        c += b;
+        d += c;
+        e += d;
+        f += e;
+        g += f;
+    }
+    return a + b + c + d + e + f + g;
+}
+
+int escape_address(int n) {
+    int counted = 0;
+    int kept    = 0;
+    for (int i = 0; i < n; i++) {
+        kept++;
+        escape_set(&counted, counted + 2);
+    }
+    return counted + kept;
+}
+
+int escape_narrow() {
+    char  c = 0;
+    short s = 0;
+    for (int i = 0; i < 300; i++) {
+        c++;
+        s += 300;
+    }
+    expecti(c, 44);
+    expecti(s, 24464);
+    return 0;
+}
+
+int escape_count(int n, int total) {
+    if (n == 0)
+        return total;
+    total = total + n;
+    total = total + 0;
+    return escape_count(n - 1, total);
+}
+
+int main() {
+    init("escape analysis");
+
+    expecti(escape_fib(20), 6765);
+    expecti(escape_many(5), 2087);
+    expecti(escape_address(10), 30);
+    escape_narrow();
+    expecti(escape_count(100, 0), 5050);
+
+    return ok();
+}
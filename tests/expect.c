@@ -11,6 +11,16 @@ void expecti(int a, int b) {
     }
 }
 
+void expectl(long a, long b) {
+    if (a != b) {
+        printf(" [ERROR]\n");
+        printf("    Expected: %ld\n", b);
+        printf("    Result:   %ld\n", a);
+
+        exit(1);
+    }
+}
+
 void expectf(float a, float b) {
     if (a != b) {
         printf(" [ERROR]\n");
@@ -0,0 +1,109 @@
+struct frame_pair {
+    char  tag;
+    short count;
+    int   value;
+};
+
+int frame_sum(int *values, int count) {
+    int sum = 0;
+    for (int i = 0; i < count; i++)
+        sum += values[i];
+    return sum;
+}
+
+void frame_fill(char *p, int count, char value) {
+    for (int i = 0; i < count; i++)
+        p[i] = value;
+}
+
+void test_packed() {
+    char  a = 1;
+    short b = 2;
+    char  c = 3;
+    int   d = 4;
+    long  e = 5;
+    float f = 1.5;
+    double g = 2.5;
+
+    /* writes through pointers must not touch the neighbours */
+    char  *pa = &a;
+    short *pb = &b;
+    char  *pc = &c;
+    int   *pd = &d;
+    *pa = 127;
+    *pb = 32767;
+    *pc = 100;
+    *pd = 2000000;
+
+    expecti(a, 127);
+    expecti(b, 32767);
+    expecti(c, 100);
+    expecti(d, 2000000);
+    expectl(e, 5);
+    expectf(f, 1.5);
+    expectd(g, 2.5);
+
+    char buffer[3];
+    frame_fill(buffer, 3, 9);
+    expecti(a + c, 227);
+    expecti(buffer[0] + buffer[1] + buffer[2], 27);
+}
+
+void test_disjoint() {
+    int total = 0;
+
+    if (total == 0) {
+        int values[4];
+        values[0] = 1;
+        values[1] = 2;
+        values[2] = 3;
+        values[3] = 4;
+        total += frame_sum(values, 4);
+    } else {
+        int other[4];
+        other[0] = 100;
+        total += frame_sum(other, 1);
+    }
+    expecti(total, 10);
+
+    for (int i = 0; i < 3; i++) {
+        int values[2];
+        values[0] = i;
+        values[1] = total;
+        {
+            int inner = values[0] + values[1];
+            total = inner;
+        }
+        {
+            char bytes[8];
+            frame_fill(bytes, 8, 1);
+            expecti(values[0], i);
+        }
+    }
+    expecti(total, 13);
+
+    {
+        struct frame_pair pair;
+        pair.tag   = 'x';
+        pair.count = 300;
+        pair.value = 70000;
+        expecti(pair.tag, 'x');
+        expecti(pair.count, 300);
+        expecti(pair.value, 70000);
+    }
+    {
+        long first  = 11;
+        long second = 22;
+        expectl(first + second, 33);
+    }
+    expecti(total, 13);
+}
+
+int main() {
+    init("stack slot sharing");
+
+    test_packed();
+    test_disjoint();
+
+    return ok();
+}
@@ -0,0 +1,10 @@
+#define DEBUG_SQUARE(x) \
+    ((x) * (x))
+
+static int debug_clamp(int value, int low, int high) {
+    if (value < low)
+        return low;
+    if (value > high)
+        return high;
+    return value;
+}
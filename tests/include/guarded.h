@@ -0,0 +1,9 @@
+/* included twice, read once */
+#ifndef PREPROCESS_GUARDED_H
+#define PREPROCESS_GUARDED_H
+
+static int guarded_count = 0;
+
+#define GUARDED_VALUE 42
+
+#endif
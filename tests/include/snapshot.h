@@ -0,0 +1,38 @@
+/* precompiled with -DSNAPSHOT_WRITTEN, only the snapshot knows it */
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#ifdef SNAPSHOT_WRITTEN
+#   define SNAPSHOT_PRECOMPILED 1
+#else
+#   define SNAPSHOT_PRECOMPILED 0
+#endif
+
+#define SNAPSHOT_SCALE     3
+#define SNAPSHOT_MUL(x, y) ((x) * (y) * SNAPSHOT_SCALE)
+
+typedef int snapshot_int_t;
+typedef struct snapshot_pair_s snapshot_pair_t;
+
+struct snapshot_pair_s {
+    snapshot_int_t   first;
+    long             second;
+    snapshot_pair_t *next;
+    char             name[8];
+};
+
+union snapshot_value {
+    int  integer;
+    char bytes[4];
+};
+
+enum {
+    SNAPSHOT_RED,
+    SNAPSHOT_GREEN = 5,
+    SNAPSHOT_BLUE
+};
+
+int snapshot_sum(snapshot_pair_t *pair);
+long snapshot_twice(long value, ...);
+
+#endif
@@ -0,0 +1,49 @@
+double march_fused(double a, double b, double c) {
+    return a * b + c;
+}
+
+double march_fused_subtract(double a, double b, double c) {
+    return a * b - c;
+}
+
+double march_fused_negated(double a, double b, double c) {
+    return c - a * b;
+}
+
+double march_divide(double a, double b) {
+    return a / b;
+}
+
+long march_clear(long set, long mask) {
+    return set & ~mask;
+}
+
+long march_keep(long mask, long set) {
+    return ~mask & set;
+}
+
+int march_shift(int value, int count) {
+    return (value << count) >> 1;
+}
+
+int main() {
+    init("target selection");
+
+    expectd(march_fused(2.0, 3.0, 1.0), 7.0);
+    expectd(march_fused_subtract(2.0, 3.0, 1.0), 5.0);
+    expectd(march_fused_negated(2.0, 3.0, 1.0), -5.0);
+    expectd(march_divide(1.0, 4.0), 0.25);
+
+    float scale = 1.5;
+    expectf(scale * 4 + 1, 7.0);
+
+    expectl(march_clear(0xFF, 0x0F), 0xF0);
+    expectl(march_keep(0x0F, 0xFF), 0xF0);
+    expecti(march_shift(3, 4), 24);
+
+#ifdef __POPCNT__
+    expecti(__builtin_popcount(0x1010), 2);
+#endif
+
+    return ok();
+}
@@ -0,0 +1,38 @@
+void test_strings() {
+    char *a = "pooled";
+    char *b = "pooled";
+    char *c = "a longer pooled";
+    char *d = "er pooled";
+
+    expects(a, "pooled");
+    expects(c, "a longer pooled");
+    expects(d, "er pooled");
+
+    /* identical literals share storage, as do tails of longer ones */
+    expecti(a == b, 1);
+    expecti(c + 9 == a, 1);
+    expecti(c + 6 == d, 1);
+    expecti(a[6], 0);
+}
+
+void test_floats() {
+    double a;
+    double b;
+    double c;
+
+    a = 2.5;
+    b = 2.5;
+    c = 0.25;
+    expectd(a, 2.5);
+    expectd(b + c, 2.75);
+    expectd(a * b, 6.25);
+}
+
+int main() {
+    init("literal pooling");
+
+    test_strings();
+    test_floats();
+
+    return ok();
+}
@@ -0,0 +1,131 @@
+#include "tests/include/guarded.h"
+#include "tests/include/guarded.h"
+#include "tests/include/once.h"
+#include "tests/include/once.h"
+
+#define ZERO  0
+#define ONE   (ZERO + 1)
+#define TWO   (ONE + ONE)
+#define SELF  SELF
+
+#define ADD(a, b)      ((a) + (b))
+#define SQUARE(x)      ((x) * (x))
+#define STRING(x)      #x
+#define XSTRING(x)     STRING(x)
+#define PASTE(a, b)    a ## b
+#define FIRST(x, ...)  x
+#define REST(x, ...)   ADD(__VA_ARGS__)
+#define EMPTY()        5
+#define LONG_MACRO(a, \
+                   b) \
+    ((a) - (b))
+
+void test_object() {
+    int SELF = 3;
+
+    expecti(ZERO, 0);
+    expecti(ONE, 1);
+    expecti(TWO * TWO, 4);
+    expecti(SELF, 3);
+    expecti(GUARDED_VALUE, 42);
+    expecti(guarded_count, 0);
+    expecti(once_value, 7);
+}
+
+void test_function() {
+    int value  = 3;
+    int PASTE(paste, d) = 9;
+
+    expecti(ADD(1, 2), 3);
+    expecti(ADD(ADD(1, 2), SQUARE(value)), 12);
+    expecti(SQUARE(ADD(1, 1)), 4);
+    expecti(pasted, 9);
+    expecti(FIRST(1, 2, 3), 1);
+    expecti(REST(1, 2, 3), 5);
+    expecti(EMPTY(), 5);
+    expecti(LONG_MACRO(10, 4), 6);
+    expecti(ADD(SQUARE((2)), (1)), 5);
+    expects(STRING(hello world), "hello world");
+    expects(STRING("quoted"), "\"quoted\"");
+    expects(XSTRING(TWO), "((0 + 1) + (0 + 1))");
+}
+
+void test_conditional() {
+    int i = 0;
+
+#if ONE + 1 == 2 && defined(ADD) && !defined UNDEFINED
+    i += 1;
+#else
+    i += 100;
+#endif
+
+#if 0
+    this isn't compiled, so even an unmatched ' is fine
+#   if 1
+    nor is this
+#   endif
+#elif TWO > 3
+    i += 100;
+#elif SQUARE(3) == 9
+    i += 2;
+#else
+    i += 100;
+#endif
+
+#ifdef ADD
+    i += 4;
+#endif
+#ifndef ADD
+    i += 100;
+#endif
+
+#undef ADD
+#ifdef ADD
+    i += 100;
+#elif 1 ? UNDEFINED_NAME : 1
+    i += 100;
+#else
+    i += 8;
+#endif
+
+    expecti(i, 15);
+}
+
+void test_unsigned() {
+    int i = 0;
+
+#if -1 > 0u
+    i += 1;
+#endif
+#if -1 > 0
+    i += 100;
+#endif
+#if 0u - 1 == 18446744073709551615
+    i += 2;
+#endif
+#if (-1 < 0 ? 1 : 0u) - 2 > 0
+    i += 4;
+#endif
+#if -8 >> 1 == -4 && 1 - 2 < 0
+    i += 8;
+#endif
+#if (0u - 8) / 2 > 0 && 18446744073709551615 > 0
+    i += 16;
+#endif
+#if (ZERO && 1 / ZERO) || (ONE || 1 % ZERO) && (ZERO ? 1 / 0 : ONE)
+    i += 32;
+#endif
+
+    expecti(i, 63);
+}
+
+int main() {
+    init("preprocessor");
+
+    test_object();
+    test_function();
+    test_conditional();
+    test_unsigned();
+
+    return ok();
+}
@@ -0,0 +1,63 @@
+int profile_classify(int value) {
+    if (value % 16 == 0)
+        return 1;
+    else
+        return 2;
+}
+
+int profile_dispatch(int value) {
+    int result = 0;
+    switch (value % 8) {
+        case 1:
+            result = 10;
+            break;
+        case 3:
+            result = 30;
+        case 4:
+            result += 40;
+            break;
+        case 6:
+            switch (value % 3) {
+                case 0:  result = 600; break;
+                default: result = 601; break;
+            }
+            break;
+        default:
+            result = -1;
+    }
+    return result;
+}
+
+int profile_never(int value) {
+    return value * 3;
+}
+
+int main() {
+    init("profile guided layout");
+
+    int ones = 0;
+    int twos = 0;
+    for (int i = 0; i < 1000; i++) {
+        if (profile_classify(i) == 1)
+            ones++;
+        else
+            twos++;
+    }
+    expecti(ones, 63);
+    expecti(twos, 937);
+
+    int sum = 0;
+    for (int i = 0; i < 1000; i++)
+        sum += (i % 8 == 3) ? profile_dispatch(i) : 0;
+    expecti(sum, 125 * 70);
+
+    expecti(profile_dispatch(1), 10);
+    expecti(profile_dispatch(3), 70);
+    expecti(profile_dispatch(4), 40);
+    expecti(profile_dispatch(6), 600);
+    expecti(profile_dispatch(14), 601);
+    expecti(profile_dispatch(7), -1);
+    expecti(profile_dispatch(0), -1);
+
+    return ok();
+}
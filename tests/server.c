@@ -0,0 +1,13 @@
+/* compiled by lice --server through lice-client, which runs in tests */
+#include "include/debug.h"
+#include <snapshot.h>
+
+int main() {
+    init("compile server");
+
+    expecti(SERVER_DEFINED, 7);
+    expecti(debug_clamp(50, 0, 10), 10);
+    expecti(SNAPSHOT_MUL(2, 5), 30);
+
+    return ok();
+}
@@ -0,0 +1,41 @@
+#include "tests/include/snapshot.h"
+
+int snapshot_sum(snapshot_pair_t *pair) {
+    int sum = 0;
+    for (; pair; pair = pair->next)
+        sum += pair->first + pair->second;
+    return sum;
+}
+
+long snapshot_twice(long value, ...) {
+    return value * 2;
+}
+
+int main() {
+    init("precompiled headers");
+
+    expecti(SNAPSHOT_PRECOMPILED, 1);
+    expecti(SNAPSHOT_MUL(2, 5), 30);
+    expecti(SNAPSHOT_GREEN, 5);
+    expecti(SNAPSHOT_BLUE, 6);
+
+    snapshot_pair_t a;
+    snapshot_pair_t b;
+    a.first  = 1;
+    a.second = 2;
+    a.next   = &b;
+    b.first  = 3;
+    b.second = 4;
+    b.next   = 0;
+    expecti(snapshot_sum(&a), 10);
+    expecti(sizeof(snapshot_pair_t), 32);
+
+    union snapshot_value value;
+    value.integer = 0;
+    value.bytes[0] = 7;
+    expecti(value.integer, 7);
+    expecti(sizeof(snapshot_int_t), 4);
+    expectl(snapshot_twice(21, 0), 42);
+
+    return ok();
+}
@@ -0,0 +1,17 @@
+/* compiled with the snapshot of tests/include/snapshot.h, which is never included */
+typedef long snapshot_int_t;
+
+#ifdef SNAPSHOT_SCALE
+#   define SNAPSHOT_LEAKED 1
+#else
+#   define SNAPSHOT_LEAKED 0
+#endif
+
+int main() {
+    init("precompiled headers not included");
+
+    expecti(SNAPSHOT_LEAKED, 0);
+    expecti(sizeof(snapshot_int_t), 8);
+
+    return ok();
+}
@@ -0,0 +1,49 @@
+long tail_sum(long n, long total) {
+    if (n == 0)
+        return total;
+    return tail_sum(n - 1, total + n);
+}
+
+int tail_odd(int n);
+int tail_even(int n) {
+    if (n == 0)
+        return 1;
+    return tail_odd(n - 1);
+}
+
+int tail_odd(int n) {
+    if (n == 0)
+        return 0;
+    return tail_even(n - 1);
+}
+
+int tail_read(int *p) {
+    return *p;
+}
+
+int tail_escape(int n) {
+    int local = n * 2;
+    return tail_read(&local);
+}
+
+double tail_halve(double value, int n) {
+    if (n == 0)
+        return value;
+    return tail_halve(value / 2, n - 1);
+}
+
+int main() {
+    long n = 10000000;
+
+    init("tail calls");
+
+    /* each of these would need far more than the default stack */
+    expectl(tail_sum(n, 0), n * (n + 1) / 2);
+    expecti(tail_even(10000000), 1);
+    expecti(tail_odd(10000001), 1);
+
+    expecti(tail_escape(21), 42);
+    expectd(tail_halve(8.0, 3), 1.0);
+
+    return ok();
+}
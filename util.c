@@ -1,34 +1,94 @@
+#define _POSIX_C_SOURCE 200809L /* clock_gettime */
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "util.h"
 
 #define MEMORY 0x800000
 
-static unsigned char *memory_pool = NULL;
-static size_t         memory_next = 0;
+/*
+ * The pool is a chain of blocks, each starting with a pointer to the
+ * one before it. A new block is started when the current one runs
+ * out, so big translation units don't run off the end.
+ */
+#define MEMORY_HEADER 16
+
+static COMPILE_LOCAL unsigned char *memory_pool = NULL;
+static COMPILE_LOCAL size_t         memory_next = 0;
+static COMPILE_LOCAL size_t         memory_size = 0;
+
+/* since the last reset, for reports */
+static COMPILE_LOCAL size_t         memory_bytes    = 0;
+static COMPILE_LOCAL size_t         memory_reserved = 0;
+
+static void memory_free(unsigned char *block) {
+    while (block) {
+        unsigned char *previous = *(unsigned char **)block;
+        free(block);
+        block = previous;
+    }
+}
+
+void memory_reset(void) {
+    if (!memory_pool)
+        return;
+    memory_free(*(unsigned char **)memory_pool);
+    *(unsigned char **)memory_pool = NULL;
+    memory_next     = MEMORY_HEADER;
+    memory_bytes    = 0;
+    memory_reserved = memory_size;
+}
 
-static void memory_cleanup(void) {
-    free(memory_pool);
+void memory_release(void) {
+    memory_free(memory_pool);
+    memory_pool     = NULL;
+    memory_next     = 0;
+    memory_size     = 0;
+    memory_bytes    = 0;
+    memory_reserved = 0;
 }
 
 void *memory_allocate(size_t bytes) {
     void *value;
 
-    if (!memory_pool) {
-        memory_pool = malloc(MEMORY);
-        atexit(memory_cleanup);
+    if (!memory_pool || memory_next + bytes > memory_size) {
+        size_t         size  = MAX(MEMORY, bytes + MEMORY_HEADER);
+        unsigned char *block = malloc(size);
+
+        *(unsigned char **)block = memory_pool;
+        memory_pool = block;
+        memory_next = MEMORY_HEADER;
+        memory_size = size;
+
+        memory_reserved += size;
     }
 
     value = &memory_pool[memory_next];
-    memory_next += bytes;
+    memory_next  += bytes;
+    memory_bytes += bytes;
 
     return value;
 }
 
+size_t memory_used(void) {
+    return memory_bytes;
+}
+
+size_t memory_blocks(void) {
+    return memory_reserved;
+}
+
+unsigned long time_monotonic(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000UL + now.tv_nsec;
+}
+
 struct string_s {
     char *buffer;
     int   allocated;
@@ -105,6 +165,7 @@ struct list_node_s {
 
 struct list_iterator_s {
     list_node_t *pointer;
+    list_node_t *current;
 };
 
 list_t *list_create(void) {
@@ -169,6 +230,7 @@ int list_length(list_t *list) {
 list_iterator_t *list_iterator(list_t *list) {
     list_iterator_t *iter = memory_allocate(sizeof(list_iterator_t));
     iter->pointer         = list->head;
+    iter->current         = NULL;
     return iter;
 }
 
@@ -179,11 +241,16 @@ void *list_iterator_next(list_iterator_t *iter) {
         return NULL;
 
     ret           = iter->pointer->element;
+    iter->current = iter->pointer;
     iter->pointer = iter->pointer->next;
 
     return ret;
 }
 
+void **list_iterator_site(list_iterator_t *iter) {
+    return iter->current ? &iter->current->element : NULL;
+}
+
 bool list_iterator_end(list_iterator_t *iter) {
     return !iter->pointer;
 }
@@ -207,14 +274,9 @@ list_t *list_reverse(list_t *list) {
 }
 
 void *list_tail(list_t *list) {
-    if (!list->head)
+    if (!list->tail)
         return NULL;
-
-    list_node_t *node = list->head;
-    while (node->next)
-        node = node->next;
-
-    return node->element;
+    return list->tail->element;
 }
 
 typedef struct {
@@ -269,6 +331,99 @@ list_t *table_keys(table_t *table) {
     return list;
 }
 
+typedef struct {
+    char         *key;
+    void         *value;
+    unsigned int  hash;
+} hashtable_entry_t;
+
+struct hashtable_s {
+    hashtable_entry_t *entries;
+    int                capacity;
+    int                length;
+};
+
+static unsigned int hashtable_hash(const char *key) {
+    /* FNV-1a */
+    unsigned int hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++)
+        hash = (hash ^ *p) * 16777619u;
+    return hash;
+}
+
+unsigned long hash_bytes(unsigned long hash, const void *data, size_t size) {
+    for (const unsigned char *p = data; size--; p++)
+        hash = (hash ^ *p) * 1099511628211UL;
+    return hash;
+}
+
+static hashtable_entry_t *hashtable_entries(int capacity) {
+    hashtable_entry_t *entries = memory_allocate(sizeof(hashtable_entry_t) * capacity);
+    memset(entries, 0, sizeof(hashtable_entry_t) * capacity);
+    return entries;
+}
+
+hashtable_t *hashtable_create(void) {
+    hashtable_t *table = memory_allocate(sizeof(hashtable_t));
+    table->capacity    = 16;
+    table->length      = 0;
+    table->entries     = hashtable_entries(table->capacity);
+    return table;
+}
+
+/* linear probing, capacity is always a power of two */
+static hashtable_entry_t *hashtable_slot(hashtable_entry_t *entries, int capacity, const char *key, unsigned int hash) {
+    for (unsigned int i = hash & (capacity - 1); ; i = (i + 1) & (capacity - 1)) {
+        hashtable_entry_t *entry = &entries[i];
+        if (!entry->key)
+            return entry;
+        if (entry->hash == hash && !strcmp(entry->key, key))
+            return entry;
+    }
+    return NULL;
+}
+
+static void hashtable_grow(hashtable_t *table) {
+    int                capacity = table->capacity * 2;
+    hashtable_entry_t *entries  = hashtable_entries(capacity);
+
+    for (int i = 0; i < table->capacity; i++) {
+        hashtable_entry_t *entry = &table->entries[i];
+        if (entry->key)
+            *hashtable_slot(entries, capacity, entry->key, entry->hash) = *entry;
+    }
+    table->entries  = entries;
+    table->capacity = capacity;
+}
+
+void *hashtable_find(hashtable_t *table, const char *key) {
+    hashtable_entry_t *entry = hashtable_slot(table->entries, table->capacity, key, hashtable_hash(key));
+    return entry->key ? entry->value : NULL;
+}
+
+void hashtable_insert(hashtable_t *table, char *key, void *value) {
+    if ((table->length + 1) * 4 > table->capacity * 3)
+        hashtable_grow(table);
+
+    unsigned int       hash  = hashtable_hash(key);
+    hashtable_entry_t *entry = hashtable_slot(table->entries, table->capacity, key, hash);
+
+    if (!entry->key) {
+        entry->key  = key;
+        entry->hash = hash;
+        table->length++;
+    }
+    entry->value = value;
+}
+
+list_t *hashtable_keys(hashtable_t *table) {
+    list_t *list = list_create();
+    for (int i = 0; i < table->capacity; i++)
+        if (table->entries[i].key)
+            list_push(list, table->entries[i].key);
+    return list;
+}
+
 int strcasecmp(const char *s1, const char *s2) {
     const unsigned char *u1 = (const unsigned char *)s1;
     const unsigned char *u2 = (const unsigned char *)s2;
@@ -295,3 +450,111 @@ int strncasecmp(const char *s1, const char *s2, size_t n) {
 
     return 0;
 }
+
+typedef struct {
+    pthread_mutex_t lock;
+    int             begin;
+    int             end;
+} pool_queue_t;
+
+typedef struct {
+    pool_queue_t  *queues;
+    int            workers;
+    void         (*task)(int, void *);
+    void          *data;
+} pool_t;
+
+typedef struct {
+    pool_t *pool;
+    int     self;
+} pool_worker_t;
+
+static bool pool_take(pool_queue_t *queue, bool steal, int *index) {
+    pthread_mutex_lock(&queue->lock);
+    bool found = queue->begin < queue->end;
+    if (found)
+        *index = steal ? --queue->end : queue->begin++;
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+static int pool_remaining(pool_queue_t *queue) {
+    pthread_mutex_lock(&queue->lock);
+    int remaining = queue->end - queue->begin;
+    pthread_mutex_unlock(&queue->lock);
+    return remaining;
+}
+
+static bool pool_steal(pool_t *pool, int *index) {
+    for (;;) {
+        pool_queue_t *victim = NULL;
+        int           most   = 0;
+
+        /* the queue may be emptied again before the take, which rechecks */
+        for (int i = 0; i < pool->workers; i++) {
+            int remaining = pool_remaining(&pool->queues[i]);
+            if (remaining > most) {
+                most   = remaining;
+                victim = &pool->queues[i];
+            }
+        }
+
+        if (!victim)
+            return false;
+        if (pool_take(victim, true, index))
+            return true;
+    }
+}
+
+static void *pool_worker(void *data) {
+    pool_worker_t *worker = data;
+    pool_t        *pool   = worker->pool;
+    int            index;
+
+    while (pool_take(&pool->queues[worker->self], false, &index) || pool_steal(pool, &index))
+        pool->task(index, pool->data);
+
+    memory_release();
+    return NULL;
+}
+
+void pool_run(int workers, int count, void (*task)(int index, void *data), void *data) {
+    if (workers > count)
+        workers = count;
+
+    if (workers <= 1) {
+        for (int i = 0; i < count; i++)
+            task(i, data);
+        return;
+    }
+
+    pool_t pool = {
+        .queues  = malloc(sizeof(pool_queue_t) * workers),
+        .workers = workers,
+        .task    = task,
+        .data    = data
+    };
+
+    pthread_t     *threads  = malloc(sizeof(pthread_t)     * workers);
+    pool_worker_t *contexts = malloc(sizeof(pool_worker_t) * workers);
+
+    for (int i = 0; i < workers; i++) {
+        pthread_mutex_init(&pool.queues[i].lock, NULL);
+        pool.queues[i].begin = count * i       / workers;
+        pool.queues[i].end   = count * (i + 1) / workers;
+        contexts[i].pool     = &pool;
+        contexts[i].self     = i;
+    }
+
+    for (int i = 0; i < workers; i++)
+        pthread_create(&threads[i], NULL, &pool_worker, &contexts[i]);
+    for (int i = 0; i < workers; i++)
+        pthread_join(threads[i], NULL);
+
+    for (int i = 0; i < workers; i++)
+        pthread_mutex_destroy(&pool.queues[i].lock);
+
+    free(contexts);
+    free(threads);
+    free(pool.queues);
+}
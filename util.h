@@ -115,6 +115,13 @@ void *list_iterator_next(list_iterator_t *iter);
  */
 bool list_iterator_end(list_iterator_t *iter);
 
+/*
+ * Function: list_iterator_site
+ *  Returns where the element last returned by <list_iterator_next>
+ *  is stored, allowing it to be replaced in place.
+ */
+void **list_iterator_site(list_iterator_t *iter);
+
 /*
  * Function: list_tail
  *  Get the last element in a list
@@ -190,16 +197,134 @@ list_t *table_keys(table_t *table);
     .parent = NULL                  \
 })
 
+/*
+ * Type: hashtable_t
+ *  A key value associative table with O(1) lookup, keys are
+ *  strings which are not copied.
+ */
+typedef struct hashtable_s hashtable_t;
+
+/*
+ * Function: hashtable_create
+ *  Creates a hashtable_t object
+ */
+hashtable_t *hashtable_create(void);
+
+/*
+ * Function: hashtable_find
+ *  Searches for the value associated with the given key, returns
+ *  NULL if there is no such key in the table.
+ */
+void *hashtable_find(hashtable_t *table, const char *key);
+
+/*
+ * Function: hashtable_insert
+ *  Associates a value with the given key in the table, replacing
+ *  any value already associated with that key.
+ */
+void hashtable_insert(hashtable_t *table, char *key, void *value);
+
+/*
+ * Function: hashtable_keys
+ *  Generate a list of all the keys in the table, in no particular
+ *  order.
+ */
+list_t *hashtable_keys(hashtable_t *table);
+
+/*
+ * Constant: HASH_INITIAL
+ *  The hash of no bytes at all, see <hash_bytes>
+ */
+#define HASH_INITIAL 14695981039346656037UL
+
+/*
+ * Function: hash_bytes
+ *  Continue a hash over some more bytes.
+ *
+ * Parameters:
+ *  hash    - The hash of everything before, or <HASH_INITIAL>
+ *  data    - The bytes to hash
+ *  size    - Number of bytes
+ *
+ * Remarks:
+ *  64-bit FNV-1a, the result is the same on every run so it can be
+ *  used to name things outside of the compiler.
+ */
+unsigned long hash_bytes(unsigned long hash, const void *data, size_t size);
 
 #define MIN(A, B) (((A) < (B)) ? (A) : (B))
 #define MAX(A, B) (((A) > (B)) ? (A) : (B))
 
+/*
+ * Macro: COMPILE_LOCAL
+ *  Storage class of state which belongs to a single compilation.
+ *
+ * Remarks:
+ *  Translation units compiled concurrently each run on a thread of
+ *  their own, so the thread is the context of a compilation. Such
+ *  state has to be initialized again before every unit since a
+ *  thread goes on to compile more than one.
+ */
+#define COMPILE_LOCAL __thread
+
 /*
  * Function: memory_allocate
  * Allocate some memory
  */
 void *memory_allocate(size_t bytes);
 
+/*
+ * Function: memory_reset
+ *  Reuse all memory allocated by the calling thread, everything
+ *  previously returned by <memory_allocate> is invalidated.
+ */
+void memory_reset(void);
+
+/*
+ * Function: memory_release
+ *  Free the memory of the calling thread
+ */
+void memory_release(void);
+
+/*
+ * Function: memory_used
+ *  Bytes allocated by the calling thread since its last
+ *  <memory_reset>.
+ */
+size_t memory_used(void);
+
+/*
+ * Function: memory_blocks
+ *  Bytes the calling thread holds in pool blocks, which is what
+ *  <memory_used> costs once the blocks are accounted for.
+ */
+size_t memory_blocks(void);
+
+/*
+ * Function: time_monotonic
+ *  Nanoseconds on a clock which only ever moves forward, for timing
+ *  what the compiler spends its time on.
+ */
+unsigned long time_monotonic(void);
+
+/*
+ * Function: pool_run
+ *  Run tasks on a pool of threads.
+ *
+ * Parameters:
+ *  workers - Number of threads to run tasks on
+ *  count   - Number of tasks
+ *  task    - Called once with every index in [0, count)
+ *  data    - Passed to every call of task
+ *
+ * Remarks:
+ *  Every worker starts out with an even share of the tasks and runs
+ *  them front to back, a worker which runs out steals from the back
+ *  of whichever worker has the most left. Returns once every task has
+ *  completed. Workers release their memory before they exit.
+ */
+void pool_run(int workers, int count, void (*task)(int index, void *data), void *data);
+
 
 int strcasecmp(const char *s1, const char *s2);
 int strncasecmp(const char *s1, const char *s2, size_t n);